@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+
+/**
+ * Screenshot writers, see src/saveBMPtoSD.cpp and src/streamScreenshot.cpp
+ * If stats is given, it receives time and throughput of the capture.
+ */
+struct CaptureStats
+{
+    uint32_t msTotal;   // time from opening to closing the file
+    uint32_t bytes;     // file size
+    float    kBps;      // achieved throughput in kB/s
+};
+
+bool saveBmpToSD_16bit(LGFX &lcd, const char *filename, CaptureStats *stats=nullptr);
+bool saveBmpToSD_24bit(LGFX &lcd, const char *filename, CaptureStats *stats=nullptr);
+bool saveQoiToSD_16bit(LGFX &lcd, const char *filename, CaptureStats *stats=nullptr);
+bool streamScreenshot(LGFX &lcd, Stream &io, CaptureStats *stats=nullptr);  // src/streamScreenshot.cpp
+
+enum class ScreenshotFormat { BMP16, BMP24, QOI };
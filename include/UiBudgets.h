@@ -0,0 +1,40 @@
+#pragma once
+#include "UiBench.h"
+
+/**
+ * File         UiBudgets.h
+ *
+ * Purpose      Limits of the UI BENCH scenarios (see UiBench.h and main.cpp).
+ *              A change that makes a scenario slower, or lets it call more
+ *              drawing functions or send more bytes to the display than its
+ *              limit, fails the benchmark. Lower a limit with the change that
+ *              makes the scenario cheaper, raise it only with the change that
+ *              needs it.
+ *              The simulator limits are its results plus 10 %, rounded up.
+ *              Enforcement on the board is deferred: its limits are 0 until
+ *              UI BENCH has been run on a CYD, so only the simulator catches
+ *              regressions for now. A scenario whose limits are all 0 has no
+ *              budget, and UI BENCH reports DISABLED instead of PASS while no
+ *              scenario has one. To enable it, run UI BENCH on the board and
+ *              enter the results plus 10 %.
+ */
+#ifdef CW_SIM
+const UiBudget uiBudgets[] =
+{ //  scenario            us   calls  bytes written
+    { "keypad open",     37700,   103, 188300 },
+    { "type 1234567",    30200,    39, 150700 },
+    { "press OK",        83200,    79, 415400 },
+    { "match LED",        2100,     6,  10400 },
+    { "slider drag",     57600,   321, 288100 },
+};
+#else
+const UiBudget uiBudgets[] =
+{ //  scenario            us   calls  bytes written
+    { "keypad open",         0,     0,      0 },
+    { "type 1234567",        0,     0,      0 },
+    { "press OK",            0,     0,      0 },
+    { "match LED",           0,     0,      0 },
+    { "slider drag",         0,     0,      0 },
+};
+#endif
+constexpr int uiBudgetCount = sizeof(uiBudgets) / sizeof(uiBudgets[0]);
@@ -0,0 +1,51 @@
+#include "BootProfiler.h"
+#include "esp_timer.h"
+
+/**
+ * Record the end of a phase, named after what was done in it
+ */
+void BootProfiler::mark(const char *phase)
+{
+    if (_count < _maxPhases) _phases[_count++] = { phase, (uint32_t)esp_timer_get_time(), ESP.getFreeHeap() };
+}
+
+/**
+ * The generator output is up
+ */
+void BootProfiler::signal()
+{
+    if (_usSignal == 0) _usSignal = esp_timer_get_time();
+    mark("signal");
+}
+
+/**
+ * The UI is drawn and touches are handled. Call it from loop(), 
+ * the first call prints the breakdown.
+ */
+void BootProfiler::interactive()
+{
+    if (_usTouch != 0) return;
+    _usTouch = esp_timer_get_time();
+    mark("first loop");
+    print();
+}
+
+void BootProfiler::print()
+{
+    Serial.printf(R"(
+Boot Profile
+------------
+phase            done at ms   took ms   free heap  heap used
+)");
+    uint32_t usPrevious = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        const Phase &p = _phases[i];
+        Serial.printf("%-16s %10.1f %9.1f %11u", p.name, p.us / 1000.0, (p.us - usPrevious) / 1000.0, p.freeHeap);
+        i > 0 ? Serial.printf(" %10d\n", (int)(_phases[i - 1].freeHeap - p.freeHeap)) : Serial.printf("\n");
+        usPrevious = p.us;
+    }
+    Serial.printf(R"(time to signal   %10.1f ms
+time to touch    %10.1f ms
+)", _usSignal / 1000.0, _usTouch / 1000.0);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Class        BootProfiler
+ *
+ * Purpose      Timestamps the phases of the start from reset to the first
+ *              interactive frame and prints a breakdown. Times are taken with
+ *              esp_timer_get_time(), which starts shortly after reset, before
+ *              the application runs; the ROM and second stage bootloader are
+ *              not included. Two milestones are reported separately: the time
+ *              when the generator output is up (time to signal) and the time
+ *              when the UI accepts touches (time to touch).
+ *              The free heap is taken with every phase, so the heap each
+ *              phase allocated shows next to its time.
+ *
+ * Usage        BootProfiler boot;
+ *              setup: boot.mark("serial"); ... boot.signal(); ... boot.mark("panels");
+ *              loop:  boot.interactive();  // only the first call counts, prints the breakdown
+ */
+class BootProfiler
+{
+    public:
+        void mark(const char *phase);
+        void signal();
+        void interactive();
+        void print();
+        uint32_t getUsToSignal() { return _usSignal; }
+        uint32_t getUsToTouch()  { return _usTouch; }
+
+    private:
+        static const int _maxPhases = 16;
+        struct Phase { const char *name; uint32_t us; uint32_t freeHeap; };
+
+        Phase _phases[_maxPhases];
+        int _count = 0;
+        uint32_t _usSignal = 0;
+        uint32_t _usTouch = 0;
+};
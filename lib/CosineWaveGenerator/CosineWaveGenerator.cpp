@@ -1,65 +1,66 @@
 #include "CosineWaveGenerator.h"
-typedef struct { double freq; double fDelta; int step; } FandStep;
+
+// Holds the lock of the generator for a scope. Nested use in the same task is fine.
+struct GeneratorLock
+{
+    SemaphoreHandle_t sem;
+    GeneratorLock(SemaphoreHandle_t sem) : sem(sem) { if (sem) xSemaphoreTakeRecursive(sem, portMAX_DELAY); }
+    ~GeneratorLock() { if (sem) xSemaphoreGiveRecursive(sem); }
+};
+
+static portMUX_TYPE regLock = portMUX_INITIALIZER_UNLOCKED;  // register writes of update()
 
 void CosineWaveGenerator::enable(dac_channel_t channel)
 {
-    // Enable tone generator common to both channels
-    SET_PERI_REG_MASK(SENS_SAR_DAC_CTRL1_REG, SENS_SW_TONE_EN);
-    switch(channel) 
-    {
-        case DAC_CHANNEL_1:
-            SET_PERI_REG_MASK(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_CW_EN1_M);
-            SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_INV1, (int)_mode[0], SENS_DAC_INV1_S);
-            dac_output_enable(DAC_CHANNEL_1);
-            _enabled[(int)channel - 1] = true;
-        break;
-        case DAC_CHANNEL_2:
-            SET_PERI_REG_MASK(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_CW_EN2_M);
-            SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_INV2, (int)_mode[1], SENS_DAC_INV2_S);
-            dac_output_enable(DAC_CHANNEL_2);
-            _enabled[(int)channel - 1] = true;
-        break;
-        default :
-           printf("Wrong channel number %d\n", channel);
-        break;
-    }
+    GeneratorLock lock(_lock);
+    if (writeEnable(channel, true)) changed(CwUpdate::ENABLE, channel);
 }
 
 void CosineWaveGenerator::disable(dac_channel_t channel)
 {
-    // Enable tone generator common to both channels
+    GeneratorLock lock(_lock);
+    if (writeEnable(channel, false)) changed(CwUpdate::ENABLE, channel);
+}
+
+/**
+ * Switch the output of channel on or off, the tone generator common to both
+ * channels stays on. Returns false for a wrong channel.
+ */
+bool CosineWaveGenerator::writeEnable(dac_channel_t channel, bool on)
+{
     SET_PERI_REG_MASK(SENS_SAR_DAC_CTRL1_REG, SENS_SW_TONE_EN);
     switch(channel) 
     {
         case DAC_CHANNEL_1:
             SET_PERI_REG_MASK(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_CW_EN1_M);
             SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_INV1, (int)_mode[0], SENS_DAC_INV1_S);
-            dac_output_disable(DAC_CHANNEL_1);
-            _enabled[(int)channel - 1] = false;
         break;
         case DAC_CHANNEL_2:
             SET_PERI_REG_MASK(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_CW_EN2_M);
             SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL2_REG, SENS_DAC_INV2, (int)_mode[1], SENS_DAC_INV2_S);
-            dac_output_disable(DAC_CHANNEL_2);
-            _enabled[(int)channel - 1] = false;
         break;
         default :
            printf("Wrong channel number %d\n", channel);
-        break;
+           return false;
     }
+    on ? dac_output_enable(channel) : dac_output_disable(channel);
+    _enabled[(int)channel - 1] = on;
+    return true;
 }
 
 bool CosineWaveGenerator::isEnabled(dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
     return _enabled[(int)channel - 1];
 }
 
 void CosineWaveGenerator::toggle(dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
     isEnabled(channel) ? disable(channel) : enable(channel);
 }
 
-void CosineWaveGenerator::setScale(dac_channel_t channel, int scale)
+void CosineWaveGenerator::writeScale(dac_channel_t channel, int scale)
 {
     switch(channel) 
     {
@@ -77,7 +78,7 @@ void CosineWaveGenerator::setScale(dac_channel_t channel, int scale)
     } 
 }
 
-void CosineWaveGenerator::setOffset(dac_channel_t channel, int offset)
+void CosineWaveGenerator::writeOffset(dac_channel_t channel, int offset)
 {
     switch(channel) 
     {
@@ -95,7 +96,7 @@ void CosineWaveGenerator::setOffset(dac_channel_t channel, int offset)
     }
 }
 
-void CosineWaveGenerator::setMode(dac_channel_t channel, CWmode mode)
+void CosineWaveGenerator::writeMode(dac_channel_t channel, CWmode mode)
 {
     switch(channel) 
     {
@@ -113,141 +114,272 @@ void CosineWaveGenerator::setMode(dac_channel_t channel, CWmode mode)
     }
 }
 
-void CosineWaveGenerator::setFrequency(int clk_8m_div, int frequencyStep)
+void CosineWaveGenerator::setScale(dac_channel_t channel, int scale)
+{
+    GeneratorLock lock(_lock);
+    writeScale(channel, scale);
+    changed(CwUpdate::SCALE, channel);
+}
+
+void CosineWaveGenerator::setOffset(dac_channel_t channel, int offset)
+{
+    GeneratorLock lock(_lock);
+    writeOffset(channel, offset);
+    changed(CwUpdate::OFFSET, channel);
+}
+
+void CosineWaveGenerator::setMode(dac_channel_t channel, CWmode mode)
+{
+    GeneratorLock lock(_lock);
+    writeMode(channel, mode);
+    changed(CwUpdate::MODE, channel);
+}
+
+int CosineWaveGenerator::getScale(dac_channel_t channel)
+{
+    GeneratorLock lock(_lock);
+    return _scale[(int)channel - 1];
+}
+
+int CosineWaveGenerator::getOffset(dac_channel_t channel)
+{
+    GeneratorLock lock(_lock);
+    return _offset[(int)channel - 1];
+}
+
+CWmode CosineWaveGenerator::getMode(dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
+    return _mode[(int)channel - 1];
+}
+
+void CosineWaveGenerator::setFrequency(int clk_8m_div, int frequencyStep, dac_channel_t channel)
+{
+    GeneratorLock lock(_lock);
     REG_SET_FIELD(RTC_CNTL_CLK_CONF_REG, RTC_CNTL_CK8M_DIV_SEL, clk_8m_div);
     SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL1_REG, SENS_SW_FSTEP, frequencyStep, SENS_SW_FSTEP_S);
     _divi = clk_8m_div;
     _step = frequencyStep;
     _f_actual = _f0 * _step / (1 + _divi);
     _f_delta  = _f_actual - _f_target;    
+    changed(CwUpdate::STEP | CwUpdate::DIVI, channel);
+}
+
+/**
+ * Apply all changes of u in one go. The register writes, the output enable
+ * included, are done in a critical section, so the output never shows a
+ * partially applied update, and the listeners see it as one change.
+ */
+void CosineWaveGenerator::update(const CwUpdate &u)
+{
+    GeneratorLock lock(_lock);
+
+    if (u.channel != DAC_CHANNEL_1 && u.channel != DAC_CHANNEL_2)
+    {
+        printf("Wrong channel number %d\n", u.channel);
+        return;
+    }
+    uint8_t mask = u.mask;
+    if ((mask & CwUpdate::ENABLE) && u.enable == isEnabled(u.channel)) mask &= ~CwUpdate::ENABLE;
+
+    portENTER_CRITICAL(&regLock);
+    if (mask & CwUpdate::DIVI)
+    {
+        REG_SET_FIELD(RTC_CNTL_CLK_CONF_REG, RTC_CNTL_CK8M_DIV_SEL, u.divi);
+        _divi = u.divi;
+    }
+    if (mask & CwUpdate::STEP)
+    {
+        SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL1_REG, SENS_SW_FSTEP, u.step, SENS_SW_FSTEP_S);
+        _step = u.step;
+    }
+    if (mask & CwUpdate::SCALE)  writeScale(u.channel, u.scale);
+    if (mask & CwUpdate::OFFSET) writeOffset(u.channel, u.offset);
+    if (mask & CwUpdate::MODE)   writeMode(u.channel, u.mode);
+    if (mask & CwUpdate::ENABLE) writeEnable(u.channel, u.enable);
+    portEXIT_CRITICAL(&regLock);
+
+    if (mask & (CwUpdate::DIVI | CwUpdate::STEP))
+    {
+        _f_actual = _f0 * _step / (1 + _divi);
+        _f_target = u.target > 0.0 ? u.target : _f_actual;
+        _f_delta  = _f_actual - _f_target;
+    }
+    changed(mask, u.channel);
 }
 
-void CosineWaveGenerator::setClockDivisor(int clk_8m_div)
+void CosineWaveGenerator::setClockDivisor(int clk_8m_div, dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
     REG_SET_FIELD(RTC_CNTL_CLK_CONF_REG, RTC_CNTL_CK8M_DIV_SEL, clk_8m_div);
     _divi = clk_8m_div;
     _f_actual = _f0 * _step / (1 + _divi);
+    changed(CwUpdate::DIVI, channel);
 }
 
 int CosineWaveGenerator::getClockDivisor()
 {
+    GeneratorLock lock(_lock);
     return _divi;
 }
 
-void CosineWaveGenerator::setFrequencyStep(int frequencyStep)
+void CosineWaveGenerator::setFrequencyStep(int frequencyStep, dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
     SET_PERI_REG_BITS(SENS_SAR_DAC_CTRL1_REG, SENS_SW_FSTEP, frequencyStep, SENS_SW_FSTEP_S);
     _step = frequencyStep;
     _f_actual = _f0 * _step / (1 + _divi);
+    changed(CwUpdate::STEP, channel);
 }
 
 int CosineWaveGenerator::getFrequencyStep()
 {
+    GeneratorLock lock(_lock);
     return _step;
 }
 
 /**
  * f = f0 * step / (divi + 1)
  */
-void CosineWaveGenerator::setFrequencyWithDivisor(double f, int divi)
+void CosineWaveGenerator::setFrequencyWithDivisor(double f, int divi, dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
     if (divi < 0) divi = 0;
     if (divi > 7) divi = 7;
     _f_target = f;
     _divi = divi;
     _step = (int)(round(_f_target * (_divi + 1) / _f0));
-    setFrequency(_divi, _step);
+    setFrequency(_divi, _step, channel);
 }
 
-void CosineWaveGenerator::setFrequencyWithStep(double f, int step)
+void CosineWaveGenerator::setFrequencyWithStep(double f, int step, dac_channel_t channel)
 {
+    GeneratorLock lock(_lock);
     if (step < 1) step = 1;
     if (step > 0xffff) step = 0xffff;
     _f_target = f;
     _step = step;
     _divi = (int)round(_f0 * step / _f_target) - 1;
     if (_divi < 1) _divi = 1;
-    setFrequency(_divi, _step);
+    setFrequency(_divi, _step, channel);
 }
 
 /**
  * f = f0 * step / (divi + 1)
  * For a given target frequency f_target, we compute the value q = f_target / f0
- * Now we calculate for all possible divisors 1..7 the integer step value and take
+ * Now we calculate for all possible divisors 0..7 the integer step value and take
  * the divi/step pair with which we get the closest approximation for f_target.
  * To get a smooth wave form it is desirable to take a low divisor value and to 
  * tolerate a larger frequency deviation. The allowed frequency tolerance can be
  * set with the method setToleranceForBestMatch()
  */
-void CosineWaveGenerator::setFrequency(double ft)
+void CosineWaveGenerator::setFrequency(double ft, dac_channel_t channel)
 {
-    FandStep f_s[8];
-    
-    _f_target = ft;
+    GeneratorLock lock(_lock);
+    int divi, step;
 
-    double q = _f_target / _f0;
+    _f_target = ft;
+    bool withinTolerance = solveFrequency(ft, divi, step);
+    setFrequency(divi, step, channel);
 
-    for (int i = 0; i < 8; i++)  // get frequencies and step for all divisors
+    if (withinTolerance)
     {
-        f_s[i].step = int(round(q * (i + 1)));          // keep step
-        f_s[i].freq = (_f0 * f_s[i].step) / (i + 1);    // keep resulting frequency      
+        printf("Frequency within tolerance of %d °/oo is %.2f, delta %.2f, divisor = %d, step = %d\n", _f_tolerance, _f_actual, _f_delta, divi, step);
     }
+    else
+    {
+        printf("Frequency with given tolerance of %d °/oo cannot be set.\n", _f_tolerance);
+        printf("Best approx set instead: f_actual = %.2f, delta = %.2f, divisor = %d, step = %d\n", _f_actual, _f_delta, divi, step);
+    }
+} 
+
+/**
+ * Computes the divi/step pair for the target frequency ft without touching
+ * the registers. Returns the lowest divisor whose frequency lies within the
+ * tolerance and true, or the pair with the smallest deviation and false.
+ * Used by setFrequency(double) and to pre-solve frequencies ahead of time.
+ */
+bool CosineWaveGenerator::solveFrequency(double ft, int &divi, int &step)
+{
+    GeneratorLock lock(_lock);
+    return solveFrequency(ft, _f0, _f_tolerance, divi, step);
+}
+
+/**
+ * The same with f0 and tolerance given, e.g. a snapshot taken by a task that
+ * solves ahead of time while the UI may change them
+ */
+bool CosineWaveGenerator::solveFrequency(double ft, double f0, int tolerance, int &divi, int &step)
+{
+    double fdBest = ft;
+    divi = 0;
+    step = 1;
 
-    double fDelta = _f_target;
-    double fd    = _f_target;
-    int i_best   = 9;   // initialize to invalid value
-    int i_lowest = 9;
-    for (int i = 0; i < 8; i++)  // find frequency within tolerance and best matcha3
+    for (int i = 0; i < 8; i++)  // get frequency and step for all divisors
     {
-        fd = abs(_f_target - f_s[i].freq);
-        if (fd < fDelta)
+        int s = (int)round(ft / f0 * (i + 1));
+        if (s < 1) s = 1;
+        if (s > 0xffff) s = 0xffff;
+        double fd = fabs(ft - f0 * s / (i + 1));
+        if (fd < ft * tolerance / 1000.0)  // lowest divisor within tolerance
         {
-            i_best = i;
-            f_s[i_best].fDelta = fd;
-            fDelta = fd;
+            divi = i;
+            step = s;
+            return true;
         }
-        if (fd < _f_target * _f_tolerance / 1000.0) 
+        if (fd < fdBest)  // keep best match
         {
-            if (i_lowest == 9) i_lowest = i;
-        }   
+            fdBest = fd;
+            divi = i;
+            step = s;
+        }
     }
-
-    printf("Frequency with best match %.2f, divisor = %d, step = %d\n", f_s[i_best].freq, i_best, f_s[i_best].step);
-    if (i_lowest == 9)
-    {
-        printf("Frequency with given tolerance of %d °/oo cannot be set.\n", _f_tolerance);
-        setFrequency(i_best, f_s[i_best].step);
-        printf("Best approx set instead: f_actual = %.2f, delta = %.2f, divisor = %d, step = %d\n", _f_actual, f_s[i_best].fDelta, i_best, f_s[i_best].step);
-    }  
-    else
-    {
-        printf("Frequency within tolerance of %d °/oo is %.2f, delta %.2f\n", _f_tolerance, f_s[i_lowest].freq, f_s[i_lowest].fDelta);
-        setFrequency(i_lowest, f_s[i_lowest].step);
-    }  
-} 
+    return false;
+}
 
 double CosineWaveGenerator::getActualFrequency()
 {
+    GeneratorLock lock(_lock);
     return _f0 * _step / (1 + _divi); 
 }
 
+double CosineWaveGenerator::getTargetFrequency()
+{
+    GeneratorLock lock(_lock);
+    return _f_target;
+}
+
 void CosineWaveGenerator::setReferenceFrequency(double f0)
 {
+    GeneratorLock lock(_lock);
     _f0 = f0;
     _f_actual = _f0 * _step / (1 + _divi); 
     _f_delta = _f_actual - _f_target;
 }
 
+double CosineWaveGenerator::getReferenceFrequency()
+{
+    GeneratorLock lock(_lock);
+    return _f0;
+}
+
 void CosineWaveGenerator::setToleranceForBestMatch(int tolerance)
 {
+    GeneratorLock lock(_lock);
     _f_tolerance = tolerance;
     if (_f_tolerance < 1)   _f_tolerance = 1;
     if (_f_tolerance > 999) _f_tolerance = 999;
 }
 
+int CosineWaveGenerator::getToleranceForBestMatch()
+{
+    GeneratorLock lock(_lock);
+    return _f_tolerance;
+}
+
 void CosineWaveGenerator::printCwgData()
 {
+    GeneratorLock lock(_lock);
     printf("\nf0          = %9.2f\n", _f0);
     printf("step        = %9d\n", _step);
     printf("divi        = %9d\n", _divi);
@@ -255,4 +387,47 @@ void CosineWaveGenerator::printCwgData()
     printf("f_target    = %9.2f\n", _f_target);
     printf("f_actual    = %9.2f\n", _f_actual);
     printf("f_delta     = %9.2f\n", _f_delta);
-}
\ No newline at end of file
+}
+/**
+ * Register a function to be called after every change of the generator
+ * state, e.g. to log the changes. Returns false if all slots are taken.
+ */
+bool CosineWaveGenerator::addListener(CwListener listener, void *context)
+{
+    GeneratorLock lock(_lock);
+    for (Listener &l : _listeners)
+    {
+        if (l.fn == nullptr)
+        {
+            l = { listener, context };
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Unregister a listener. A call of it in another task finishes before this
+ * returns, so its context can be freed afterwards.
+ */
+void CosineWaveGenerator::removeListener(CwListener listener, void *context)
+{
+    GeneratorLock lock(_lock);
+    for (Listener &l : _listeners)
+    {
+        if (l.fn == listener && l.context == context) l = { nullptr, nullptr };
+    }
+}
+
+/**
+ * Call the listeners. The caller holds the lock, so no listener is added or
+ * removed while they run.
+ */
+void CosineWaveGenerator::changed(uint8_t mask, dac_channel_t channel)
+{
+    if (mask == 0 || (channel != DAC_CHANNEL_1 && channel != DAC_CHANNEL_2)) return;
+    for (Listener &l : _listeners)
+    {
+        if (l.fn) l.fn(l.context, *this, mask, channel);
+    }
+}
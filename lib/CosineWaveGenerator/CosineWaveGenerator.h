@@ -1,3 +1,4 @@
+#pragma once
 #include <Arduino.h>
  
 #include "soc/rtc_io_reg.h"
@@ -9,6 +10,38 @@
 
 enum class CWmode { CW_M_W, CW_W_M, CW_SINE, CW_NEG_SINE };
 
+// A set of changes applied together with CosineWaveGenerator::update().
+// Only the fields whose flag is set in mask are written.
+struct CwUpdate
+{
+    enum : uint8_t { STEP = 0x01, DIVI = 0x02, SCALE = 0x04, OFFSET = 0x08, MODE = 0x10, ENABLE = 0x20 };
+
+    uint8_t mask = 0;
+    dac_channel_t channel = DAC_CHANNEL_2;
+    int    step = 1;          // 1..65535
+    int    divi = 0;          // 0..7
+    int    scale = 0;         // 0..3
+    int    offset = 0;        // 0..255
+    CWmode mode = CWmode::CW_SINE;
+    bool   enable = true;
+    double target = 0.0;      // frequency divi and step were solved for, 0: the one they result in
+
+    void setStep(int v)     { step = v;   mask |= STEP; }
+    void setDivi(int v)     { divi = v;   mask |= DIVI; }
+    void setScale(int v)    { scale = v;  mask |= SCALE; }
+    void setOffset(int v)   { offset = v; mask |= OFFSET; }
+    void setMode(CWmode v)  { mode = v;   mask |= MODE; }
+    void setEnable(bool v)  { enable = v; mask |= ENABLE; }
+    void setFrequency(double ft, int d, int s) { target = ft; setDivi(d); setStep(s); }
+};
+
+class CosineWaveGenerator;
+
+// Called after a change of the generator state with the CwUpdate flags of the
+// changed fields. Runs in the task that made the change, with the generator
+// locked, and must not block.
+using CwListener = void (*)(void *context, CosineWaveGenerator &cwGen, uint8_t mask, dac_channel_t channel);
+
 class CosineWaveGenerator
 {
     public:
@@ -31,6 +64,7 @@ class CosineWaveGenerator
             setOffset(DAC_CHANNEL_1, _offset[0]);
             setOffset(DAC_CHANNEL_2, _offset[1]);
             setFrequency(_divi, _step);
+            _lock = xSemaphoreCreateRecursiveMutex();  // from here on, every public method takes it
         }
 
         void enable(dac_channel_t channel);
@@ -40,21 +74,41 @@ class CosineWaveGenerator
         void setScale(dac_channel_t channel, int scale);
         void setOffset(dac_channel_t channel, int offset);
         void setMode(dac_channel_t channel, CWmode mode);
-        void setFrequency(int clk_8m_div, int frequency_step);
+        int  getScale(dac_channel_t channel);
+        int  getOffset(dac_channel_t channel);
+        CWmode getMode(dac_channel_t channel);
+        void setFrequency(int clk_8m_div, int frequency_step, dac_channel_t channel=DAC_CHANNEL_2);
+        void update(const CwUpdate &u);
         void setFrequency(double f, double tolerance);
-        void setFrequency(double f);
-        void setFrequencyWithDivisor(double f, int clk_8m_div);
-        void setFrequencyWithStep(double f, int step);
+        void setFrequency(double f, dac_channel_t channel=DAC_CHANNEL_2);
+        void setFrequencyWithDivisor(double f, int clk_8m_div, dac_channel_t channel=DAC_CHANNEL_2);
+        void setFrequencyWithStep(double f, int step, dac_channel_t channel=DAC_CHANNEL_2);
+        bool solveFrequency(double f, int &clk_8m_div, int &frequency_step);
+        static bool solveFrequency(double f, double f0, int tolerance, int &clk_8m_div, int &frequency_step);
         double getActualFrequency();
+        double getTargetFrequency();
         void setReferenceFrequency(double f0);
-        void setClockDivisor(int clk_8m_div);
+        double getReferenceFrequency();
+        void setClockDivisor(int clk_8m_div, dac_channel_t channel=DAC_CHANNEL_2);
         int  getClockDivisor();
-        void setFrequencyStep(int frequencyStep);
+        void setFrequencyStep(int frequencyStep, dac_channel_t channel=DAC_CHANNEL_2);
         int  getFrequencyStep();
         void setToleranceForBestMatch(int tolerance);
+        int  getToleranceForBestMatch();
         void printCwgData();
+        bool addListener(CwListener listener, void *context);
+        void removeListener(CwListener listener, void *context);
 
     private:
+        static const int _maxListeners = 4;
+        struct Listener { CwListener fn; void *context; };
+
+        void writeScale(dac_channel_t channel, int scale);
+        void writeOffset(dac_channel_t channel, int offset);
+        void writeMode(dac_channel_t channel, CWmode mode);
+        bool writeEnable(dac_channel_t channel, bool on);
+        void changed(uint8_t mask, dac_channel_t channel);
+
         double _f0;                  // frequency generated with step = 1 and divi = 0;
         double _f_target;            // desired frequency
         double _f_actual;            // actual frequency generated
@@ -66,4 +120,6 @@ class CosineWaveGenerator
         int    _offset[2];           // 0..255
         bool   _enabled[2];          // CHN_1 or CHN_2 enabled=true, disabled=false
         CWmode _mode[2];   
+        Listener _listeners[_maxListeners] = {};
+        SemaphoreHandle_t _lock = nullptr;  // loop() and the timer task of the sequencer both write the generator
 };
\ No newline at end of file
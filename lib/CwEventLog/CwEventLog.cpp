@@ -0,0 +1,193 @@
+#include "CwEventLog.h"
+#include "esp_timer.h"
+#include "VspiBus.h"
+
+constexpr int CwEventLog::_ringSize;
+
+/**
+ * Open (or create) the log, append a header and start logging
+ */
+bool CwEventLog::begin(const char *path)
+{
+    end();
+    _ring  = (Record *)malloc(_ringSize * sizeof(Record));
+    _batch = (Record *)malloc(_ringSize * sizeof(Record));
+    _done  = xSemaphoreCreateBinary();
+
+    bool ok = false;
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _file = SD.open(path, FILE_APPEND);
+        if (_file && _ring && _batch && _done)
+        {
+            uint8_t header[16] = { 'H', 'C', 'W', 'L', 1 };
+            double f0 = _cwGen.getReferenceFrequency();
+            memcpy(&header[8], &f0, sizeof(f0));
+            ok = _file.write(header, sizeof(header)) == sizeof(header);
+            _file.flush();
+        }
+    }
+    if (! ok)
+    {
+        log_e("==> cannot log to %s", path);
+        end();
+        return false;
+    }
+
+    _head = _count = 0;
+    _seq = 0;
+    _lost = _lostTotal = _events = _written = _flushes = _maxWaiting = _usMaxFlush = 0;
+    _ok = true;
+    _stop = false;
+    xTaskCreate(writerTask, "cwEventLog", 4096, this, 1, &_task);
+    _cwGen.addListener(onChange, this);
+    log_i("==> logging to %s", path);
+    return true;
+}
+
+/**
+ * Stop logging, write the waiting records and close the file
+ */
+void CwEventLog::end()
+{
+    _cwGen.removeListener(onChange, this);  // waits for a change of the sequencer timer task in progress
+    if (_task)
+    {
+        _stop = true;
+        xTaskNotifyGive(_task);
+        xSemaphoreTake(_done, portMAX_DELAY);  // the task writes the rest and closes the file
+        _task = nullptr;
+    }
+    if (_file)
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _file.close();
+    }
+    if (_done) vSemaphoreDelete(_done);
+    _done = nullptr;
+    free(_ring);
+    free(_batch);
+    _ring = _batch = nullptr;
+}
+
+/**
+ * Listener of the generator. Runs in the task that changed the generator,
+ * only copies the new state into the ring.
+ */
+void CwEventLog::onChange(void *context, CosineWaveGenerator &cwGen, uint8_t mask, dac_channel_t channel)
+{
+    CwEventLog &log = *static_cast<CwEventLog *>(context);
+    Record r = {};
+    r.type    = 'E';
+    r.mask    = mask;
+    r.channel = channel;
+    r.ms      = millis();
+    r.step    = cwGen.getFrequencyStep();
+    r.divi    = cwGen.getClockDivisor();
+    r.scale   = cwGen.getScale(channel);
+    r.offset  = cwGen.getOffset(channel);
+    r.mode    = (uint8_t)cwGen.getMode(channel);
+    r.enable  = cwGen.isEnabled(channel);
+    log.push(r);
+}
+
+void CwEventLog::push(const Record &r)
+{
+    bool wake;
+    portENTER_CRITICAL(&_lock);
+    if (_count < _ringSize)
+    {
+        Record &slot = _ring[(_head + _count) % _ringSize];
+        slot = r;
+        slot.seq = _seq;
+        _count++;
+    }
+    else
+    {
+        _lost++;
+    }
+    _seq++;
+    _events++;
+    _maxWaiting = std::max(_maxWaiting, (uint32_t)_count);
+    wake = _count == _threshold;
+    portEXIT_CRITICAL(&_lock);
+    if (wake) xTaskNotifyGive(_task);
+}
+
+/**
+ * Move the waiting records to the file. Returns the number of records written.
+ */
+int CwEventLog::flush()
+{
+    int n = 0;
+    uint32_t lost;
+    portENTER_CRITICAL(&_lock);
+    lost = _lost;
+    _lost = 0;
+    if (lost > 0)  // report the loss in order, before the records that follow it
+    {
+        Record &l = _batch[n++];
+        l = {};
+        l.type = 'L';
+        l.ms = millis();
+        memcpy((uint8_t *)&l + 8, &lost, sizeof(lost));
+    }
+    while (_count > 0 && n < _ringSize)
+    {
+        _batch[n++] = _ring[_head];
+        _head = (_head + 1) % _ringSize;
+        _count--;
+    }
+    portEXIT_CRITICAL(&_lock);
+    if (n == 0) return 0;
+
+    int64_t usStart = esp_timer_get_time();
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        size_t len = n * sizeof(Record);
+        _ok &= _file.write((uint8_t *)_batch, len) == len;
+        _file.flush();  // update the directory entry, bounds the loss on power failure
+    }
+    _usMaxFlush = std::max(_usMaxFlush, (uint32_t)(esp_timer_get_time() - usStart));
+    _lostTotal += lost;
+    _written += n;
+    _flushes++;
+    return n;
+}
+
+/**
+ * Wait until threshold records are waiting or msFlush has passed, then write them
+ */
+void CwEventLog::writerTask(void *arg)
+{
+    CwEventLog &log = *static_cast<CwEventLog *>(arg);
+    while (! log._stop)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(log._msFlush));
+        log.flush();
+    }
+    log.flush();
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        log._file.close();
+    }
+    xSemaphoreGive(log._done);
+    vTaskDelete(nullptr);
+}
+
+void CwEventLog::printStats()
+{
+    Serial.printf(R"(
+Event Log
+---------
+logging     %6s
+events      %6u
+written     %6u records in %u flushes
+lost        %6u
+max waiting %6u records
+max flush   %6u us
+flush every %6u ms or %d records
+write ok    %6s
+)", isLogging() ? "yes" : "no", _events, _written, _flushes, _lostTotal, _maxWaiting, _usMaxFlush,
+    _msFlush, _threshold, _ok ? "yes" : "no");
+}
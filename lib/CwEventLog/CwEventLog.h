@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "CosineWaveGenerator.h"
+
+/**
+ * Class        CwEventLog
+ *
+ * Purpose      Append-only log of the state changes of the cosine wave generator
+ *              on the SD card, e.g. as audit trail of a test station. Every
+ *              change of frequency, mode, scale, offset or output enable is
+ *              stored as a record of 16 bytes with the new state of the channel.
+ *              The records are collected in a RAM ring by the generator's
+ *              listener, which never waits. A writer task appends them to the
+ *              file as soon as threshold records are waiting, at the latest
+ *              every msFlush, and flushes the file. At most the records of
+ *              the last msFlush are lost on power failure. If
+ *              the ring is full the new records are dropped and counted; the
+ *              count is stored as lost record.
+ *
+ * File         all records 16 bytes, numbers little endian
+ *              'H' "CWL" version(1) 0(3) f0(double)                     at every begin()
+ *              'E' seq(1) mask(1) channel(1) ms(4) step(2) divi(1) scale(1) offset(1) mode(1) enable(1) 0(1)
+ *              'L' 0(3) ms(4) count(4) 0(4)                            records lost
+ *              mask holds the CwUpdate flags of the changed fields, seq counts
+ *              the events modulo 256, ms is millis() at the change.
+ *              tools/cwlog2csv.py converts the log to CSV.
+ *
+ * Usage        CwEventLog eventLog(cwGen);
+ *              eventLog.begin("/LOGS/events.cwl");
+ *              ... the generator is changed anywhere ...
+ *              eventLog.end();
+ */
+class CwEventLog
+{
+    public:
+        CwEventLog(CosineWaveGenerator &cwGen, uint32_t msFlush=1000, int threshold=64) :
+            _cwGen(cwGen), _msFlush(msFlush), _threshold(std::min(threshold, _ringSize))
+        {}
+
+        bool begin(const char *path);
+        void end();
+        bool isLogging() { return _task != nullptr; }
+        void printStats();
+
+    private:
+        static constexpr int _ringSize = 256;  // records
+
+        struct Record
+        {
+            uint8_t  type;
+            uint8_t  seq;
+            uint8_t  mask;
+            uint8_t  channel;
+            uint32_t ms;
+            uint16_t step;
+            uint8_t  divi, scale, offset, mode, enable, reserved;
+        };
+        static_assert(sizeof(Record) == 16, "records are 16 bytes");
+
+        static void onChange(void *context, CosineWaveGenerator &cwGen, uint8_t mask, dac_channel_t channel);
+        static void writerTask(void *arg);
+        void push(const Record &r);
+        int  flush();
+
+        CosineWaveGenerator &_cwGen;
+        uint32_t _msFlush;
+        int _threshold;
+
+        File _file;
+        TaskHandle_t _task = nullptr;
+        SemaphoreHandle_t _done = nullptr;
+        volatile bool _stop = false;
+
+        portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+        Record *_ring = nullptr;     // written by the listener, read by the writer task
+        Record *_batch = nullptr;    // records taken out of the ring for writing
+        int _head = 0;               // next record to write to the file
+        int _count = 0;              // records waiting
+        uint8_t  _seq = 0;
+        uint32_t _lost = 0;          // records dropped since the last lost record
+        uint32_t _lostTotal = 0;
+
+        uint32_t _events = 0;
+        uint32_t _written = 0;
+        uint32_t _flushes = 0;
+        uint32_t _maxWaiting = 0;
+        uint32_t _usMaxFlush = 0;
+        bool _ok = true;
+};
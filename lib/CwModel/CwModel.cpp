@@ -0,0 +1,119 @@
+#include "CwModel.h"
+#include <math.h>
+
+/**
+ * Set the target frequency. Divider and step are solved for it, the
+ * frequency becomes the one they result in.
+ */
+void CwModel::setFrequency(double ft)
+{
+    int divider, step;
+    solve(ft, _f0, _tolerance, _optimal, divider, step);
+    assign(_divider, divider, DIVIDER);
+    assign(_step, step, STEP);
+    derive();
+}
+
+void CwModel::setF0(double f0)
+{
+    if (f0 <= 0.0 || f0 == _f0) return;
+    _f0 = f0;
+    _changes |= F0;
+    derive();
+}
+
+void CwModel::setMode(int mode)
+{
+    assign(_mode, mode < 0 ? 0 : mode > 3 ? 3 : mode, MODE);
+}
+
+void CwModel::setDivider(int divider)
+{
+    assign(_divider, divider < 0 ? 0 : divider > 7 ? 7 : divider, DIVIDER);
+    derive();
+}
+
+void CwModel::setStep(int step)
+{
+    assign(_step, step < 1 ? 1 : step > 65535 ? 65535 : step, STEP);
+    derive();
+}
+
+void CwModel::setTolerance(int tolerance)
+{
+    assign(_tolerance, tolerance < 1 ? 1 : tolerance > 999 ? 999 : tolerance, TOLERANCE);
+}
+
+void CwModel::setOptimalMatch(bool on)
+{
+    if (on == _optimal) return;
+    _optimal = on;
+    _changes |= MATCH;
+}
+
+/**
+ * The parameters changed since the last call
+ */
+uint8_t CwModel::takeChanges()
+{
+    uint8_t changes = _changes;
+    _changes = 0;
+    return changes;
+}
+
+/**
+ * Divider and step for the target frequency ft:
+ * optimal  the smallest divider whose frequency lies within the tolerance
+ *          (o/oo of ft), divider 0 if there is none
+ * best     the divider 1..7 with the smallest deviation, the lower one of equals
+ */
+void CwModel::solve(double ft, double f0, int tolerance, bool optimal, int &divider, int &step)
+{
+    int S[8];       // steps
+    double D[8];    // delta abs(f_target - f)
+    double q = ft / f0;
+
+    for (int d = 0; d < 8; d++)
+    {
+        S[d] = (int)round(q * (1 + d));
+        if (S[d] < 1) S[d] = 1;
+        if (S[d] > 65535) S[d] = 65535;
+        D[d] = fabs(ft - f0 * S[d] / (1 + d));
+    }
+
+    if (optimal)
+    {
+        double maxDelta = ft * tolerance / 1000;
+        divider = 0;
+        for (int d = 0; d < 8; d++)
+        {
+            if (D[d] <= maxDelta) { divider = d; break; }
+        }
+    }
+    else
+    {
+        double minDelta = D[7];
+        divider = 7;
+        for (int d = 6; d > 0; d--)
+        {
+            if (D[d] <= minDelta) { divider = d; minDelta = D[d]; }
+        }
+    }
+    step = S[divider];
+}
+
+void CwModel::assign(int &value, int v, uint8_t param)
+{
+    if (v == value) return;
+    value = v;
+    _changes |= param;
+}
+
+// f follows f0, divider and step
+void CwModel::derive()
+{
+    double f = _f0 * _step / (1 + _divider);
+    if (f == _f) return;
+    _f = f;
+    _changes |= FREQUENCY;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Class        CwModel
+ *
+ * Purpose      The settings of the generator panel as typed parameters with
+ *              explicit dependencies:
+ *              FREQUENCY      <- F0, DIVIDER, STEP   f = f0 * step / (1 + divider)
+ *              DIVIDER, STEP  <- target frequency    solved with TOLERANCE and MATCH
+ *              A setter changes its parameter, propagates the change to the
+ *              dependents and marks every parameter whose value actually
+ *              changed. takeChanges() returns the marks and clears them, so the
+ *              caller writes only the changed registers and redraws only the
+ *              changed fields. TOLERANCE and MATCH have no dependents, they
+ *              apply to the next target frequency.
+ *              The model uses no Arduino API and builds on the host.
+ *
+ * Usage        CwModel model;
+ *              model.setFrequency(1000.0);             // solves divider and step
+ *              uint8_t changes = model.takeChanges();  // e.g. FREQUENCY | STEP
+ *              if (changes & CwModel::STEP) ... model.getStep() ...
+ */
+class CwModel
+{
+    public:
+        enum : uint8_t { FREQUENCY = 0x01, F0 = 0x02, MODE = 0x04, DIVIDER = 0x08, STEP = 0x10,
+                         TOLERANCE = 0x20, MATCH = 0x40, ALL = 0x7f };
+
+        void setFrequency(double ft);
+        void setF0(double f0);
+        void setMode(int mode);
+        void setDivider(int divider);
+        void setStep(int step);
+        void setTolerance(int tolerance);
+        void setOptimalMatch(bool on);
+
+        double getFrequency()   { return _f; }
+        double getF0()          { return _f0; }
+        int    getMode()        { return _mode; }
+        int    getDivider()     { return _divider; }
+        int    getStep()        { return _step; }
+        int    getTolerance()   { return _tolerance; }
+        bool   isOptimalMatch() { return _optimal; }
+
+        uint8_t getChanges() { return _changes; }
+        uint8_t takeChanges();
+
+        static void solve(double ft, double f0, int tolerance, bool optimal, int &divider, int &step);
+
+    private:
+        void assign(int &value, int v, uint8_t param);
+        void derive();
+
+        // the values the panel fields show at start-up
+        double _f = 122.0703125;
+        double _f0 = 122.0703125;
+        int _mode = 2;          // 0..3, CWmode
+        int _divider = 0;       // 0..7
+        int _step = 1;          // 1..65535
+        int _tolerance = 10;    // o/oo, 1..999
+        bool _optimal = true;   // optimal or best match
+        uint8_t _changes = 0;
+};
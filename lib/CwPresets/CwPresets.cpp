@@ -0,0 +1,166 @@
+#include "CwPresets.h"
+#include <SD.h>
+#include "esp_timer.h"
+#include "VspiBus.h"
+
+/**
+ * Open the NVS namespace and read all slots into RAM
+ */
+bool CwPresets::begin()
+{
+    _ready = _prefs.begin("cwpresets", false);
+    if (! _ready)
+    {
+        log_e("==> cannot open NVS");
+        return false;
+    }
+    char k[4];
+    for (int i = 0; i < slots; i++)
+    {
+        key(i, k);
+        CwPreset p;
+        size_t len = _prefs.isKey(k) ? _prefs.getBytesLength(k) : 0;
+        _valid[i] = len >= 2 && len <= sizeof(p) && _prefs.getBytes(k, &p, len) == len && p.version >= 1;
+        if (_valid[i]) _stored[i] = p;  // fields missing in an older version keep their defaults
+    }
+    _pending = _stored[0];
+    return true;
+}
+
+/**
+ * Snapshot of the current generator settings and the application state app
+ */
+CwPreset CwPresets::capture(uint8_t app)
+{
+    CwPreset p;
+    p.mode      = (uint8_t)_cwGen.getMode(_channel);
+    p.scale     = _cwGen.getScale(_channel);
+    p.offset    = _cwGen.getOffset(_channel);
+    p.divi      = _cwGen.getClockDivisor();
+    p.enable    = _cwGen.isEnabled(_channel);
+    p.app       = app;
+    p.step      = _cwGen.getFrequencyStep();
+    p.tolerance = _cwGen.getToleranceForBestMatch();
+    p.f0        = _cwGen.getReferenceFrequency();
+    return p;
+}
+
+/**
+ * Store p in slot. The flash is only written if the content differs.
+ */
+bool CwPresets::save(int slot, const CwPreset &p)
+{
+    if (! _ready || slot < 0 || slot >= slots) return false;
+    if (_valid[slot] && memcmp(&_stored[slot], &p, sizeof(p)) == 0)
+    {
+        _unchanged++;
+        return true;
+    }
+    char k[4];
+    key(slot, k);
+    if (_prefs.putBytes(k, &p, sizeof(p)) != sizeof(p))
+    {
+        log_e("==> cannot save preset %d", slot);
+        return false;
+    }
+    _stored[slot] = p;
+    _valid[slot] = true;
+    _writes++;
+    if (_mirror) mirror(slot, p);
+    return true;
+}
+
+/**
+ * Copy the preset of slot to p. Returns false if the slot is empty.
+ */
+bool CwPresets::load(int slot, CwPreset &p)
+{
+    if (slot < 0 || slot >= slots || ! _valid[slot]) return false;
+    p = _stored[slot];
+    return true;
+}
+
+/**
+ * Set the generator to p. The registers are written with one update().
+ */
+void CwPresets::apply(const CwPreset &p)
+{
+    int64_t usStart = esp_timer_get_time();
+    CwUpdate u;
+    u.channel = _channel;
+    u.setStep(constrain(p.step, 1, 65535));
+    u.setDivi(p.divi & 7);
+    u.setScale(p.scale & 3);
+    u.setOffset(p.offset);
+    u.setMode((CWmode)(p.mode & 3));
+    u.setEnable(p.enable);
+    if (p.f0 >= 100.0 && p.f0 <= 150.0) _cwGen.setReferenceFrequency(p.f0);
+    _cwGen.setToleranceForBestMatch(p.tolerance);
+    _cwGen.update(u);
+
+    _usLastRecall = esp_timer_get_time() - usStart;
+    _usMaxRecall = std::max(_usMaxRecall, _usLastRecall);
+    _recalls++;
+}
+
+bool CwPresets::recall(int slot)
+{
+    CwPreset p;
+    if (! load(slot, p)) return false;
+    apply(p);
+    return true;
+}
+
+/**
+ * Save the current state to slot 0 once it did not change for msCoalesce.
+ * Call it from the main loop; it only looks at the generator every 500 ms.
+ */
+void CwPresets::loop(uint8_t app)
+{
+    uint32_t ms = millis();
+    if (! _ready || ms - _msChecked < _msCheck) return;
+    _msChecked = ms;
+
+    CwPreset p = capture(app);
+    if (memcmp(&p, &_pending, sizeof(p)) != 0)  // still changing
+    {
+        if (memcmp(&_pending, &_stored[0], sizeof(p)) != 0) _coalesced++;  // never written
+        _pending = p;
+        _msChanged = ms;
+    }
+    else if (ms - _msChanged >= _msCoalesce && memcmp(&p, &_stored[0], sizeof(p)) != 0)
+    {
+        save(0, p);
+    }
+}
+
+bool CwPresets::mirror(int slot, const CwPreset &p)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "/PRESETS/preset%d.bin", slot);
+    VspiTransaction bus(VspiDevice::SDCARD);
+    File file = SD.open(path, FILE_WRITE);
+    bool ok = file && file.write((const uint8_t *)&p, sizeof(p)) == sizeof(p);
+    file.close();
+    if (! ok) log_e("==> cannot mirror preset to %s", path);
+    return ok;
+}
+
+void CwPresets::printStats()
+{
+    int used = 0;
+    for (int i = 0; i < slots; i++) used += _valid[i];
+    uint32_t entries = _writes * _entriesPerWrite;
+    Serial.printf(R"(
+Presets
+-------
+slots used    %6d of %d
+flash writes  %6u (%u NVS entries, ~%u page erases)
+unchanged     %6u saves skipped
+coalesced     %6u changes
+free entries  %6u
+recalls       %6u
+recall        %6u us last, %u us max
+)", used, slots, _writes, entries, entries / 126, _unchanged, _coalesced,
+    _ready ? (unsigned)_prefs.freeEntries() : 0u, _recalls, _usLastRecall, _usMaxRecall);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include "CosineWaveGenerator.h"
+
+// Snapshot of the generator and the application state, stored as blob in NVS.
+// Fields are only ever appended; version tells how many are valid.
+struct CwPreset
+{
+    static const uint8_t currentVersion = 1;
+
+    uint8_t  version = currentVersion;
+    uint8_t  mode = 0;
+    uint8_t  scale = 0;
+    uint8_t  offset = 0;
+    uint8_t  divi = 0;
+    uint8_t  enable = 0;
+    uint8_t  app = 0;        // application state, e.g. options of the UI
+    uint8_t  reserved = 0;
+    uint16_t step = 1;
+    uint16_t tolerance = 10;
+    uint32_t reserved2 = 0;
+    double   f0 = 0.0;
+};
+static_assert(sizeof(CwPreset) == 24, "the preset blob layout is fixed");
+
+/**
+ * Class        CwPresets
+ *
+ * Purpose      Stores presets of the cosine wave generator in NVS (flash).
+ *              Slot 0 holds the last state and is restored at power-up,
+ *              slots 1..9 are user presets. All slots are read once at begin()
+ *              and kept in RAM, so a recall does not touch the flash: it
+ *              applies the preset with one CosineWaveGenerator::update().
+ *              A slot is only written if its content changes. The last state
+ *              is saved by loop() once the generator settings were unchanged
+ *              for msCoalesce, so a series of edits costs one flash write.
+ *              Optionally every saved preset is mirrored to the SD card as
+ *              /PRESETS/presetN.bin.
+ *              printStats() reports the recall time and the flash usage: a
+ *              preset takes 2 NVS entries of 32 bytes, a page of 126 entries
+ *              is erased when it is full.
+ *
+ * Usage        CwPresets presets(cwGen);
+ *              CwPreset p;
+ *              if (presets.begin() && presets.load(0, p)) presets.apply(p);
+ *              loop: presets.loop(uiOptions);
+ *              presets.save(3, presets.capture(uiOptions));
+ */
+class CwPresets
+{
+    public:
+        static const int slots = 10;
+
+        CwPresets(CosineWaveGenerator &cwGen, dac_channel_t channel=DAC_CHANNEL_2, uint32_t msCoalesce=5000) :
+            _cwGen(cwGen), _channel(channel), _msCoalesce(msCoalesce)
+        {}
+
+        bool begin();
+        CwPreset capture(uint8_t app=0);
+        bool save(int slot, const CwPreset &p);
+        bool load(int slot, CwPreset &p);
+        void apply(const CwPreset &p);
+        bool recall(int slot);
+        void loop(uint8_t app=0);
+        void setMirror(bool toSD) { _mirror = toSD; }
+        void printStats();
+
+    private:
+        static const uint32_t _msCheck = 500;     // interval of loop() to look for changes
+        static const int _entriesPerWrite = 2;    // header and data entry of a 24 byte blob
+
+        void key(int slot, char *buf) { snprintf(buf, 4, "p%d", slot); }
+        bool mirror(int slot, const CwPreset &p);
+
+        CosineWaveGenerator &_cwGen;
+        dac_channel_t _channel;
+        uint32_t _msCoalesce;
+        Preferences _prefs;
+        bool _ready = false;
+        bool _mirror = false;
+
+        CwPreset _stored[slots];     // content of the flash
+        bool _valid[slots] = {};
+        CwPreset _pending;           // last state seen by loop()
+        uint32_t _msChanged = 0;
+        uint32_t _msChecked = 0;
+
+        uint32_t _writes = 0;
+        uint32_t _unchanged = 0;     // saves skipped, content already stored
+        uint32_t _coalesced = 0;     // changes of the last state merged into a later write
+        uint32_t _recalls = 0;
+        uint32_t _usLastRecall = 0;
+        uint32_t _usMaxRecall = 0;
+};
@@ -0,0 +1,228 @@
+#include "CwProtocol.h"
+
+/**
+ * Offer one received character to the binary receiver.
+ * Returns false if the character is not part of a frame and belongs 
+ * to the text commands.
+ */
+bool CwProtocol::feed(char c)
+{
+    uint8_t b = (uint8_t)c;
+
+    if (! _inFrame)
+    {
+        if (b != 0) return false;
+        _inFrame = true;  // opening delimiter
+        _len = 0;
+        return true;
+    }
+
+    if (b == 0)
+    {
+        if (_len == 0 && ! _discard) return true;  // repeated delimiter, wait for the frame
+        if (! _discard) handleFrame();
+        _inFrame = false;  // the closing delimiter, back to text
+        _discard = false;
+        return true;
+    }
+
+    if (_discard) return true;
+    if (_len < _maxFrame) 
+    {
+        _frame[_len++] = b;
+    }
+    else  // oversized frame, drop the rest of it up to the closing delimiter
+    {
+        _errors++;
+        _discard = true;
+    }
+    return true;
+}
+
+/**
+ * Apply the timed batches that are due.
+ * Returns true if the generator was changed since the last call.
+ */
+bool CwProtocol::loop()
+{
+    while (_queued > 0 && (int32_t)(micros() - _queue[0].usTime) >= 0)
+    {
+        _cwGen.update(_queue[0].u);
+        _changed = true;
+        _queued--;
+        memmove(&_queue[0], &_queue[1], _queued * sizeof(TimedUpdate));
+    }
+
+    bool changed = _changed;
+    _changed = false;
+    return changed;
+}
+
+/**
+ * Microseconds until the next timed batch is due, 0 if one is due, -1 if none is queued
+ */
+int32_t CwProtocol::usUntilNext()
+{
+    if (_queued == 0) return -1;
+    int32_t us = _queue[0].usTime - micros();
+    return us > 0 ? us : 0;
+}
+
+void CwProtocol::printStats()
+{
+    Serial.printf(R"(
+Binary protocol
+---------------
+frames     %8u
+updates    %8u
+errors     %8u
+)", _frames, _updates, _errors);
+}
+
+void CwProtocol::handleFrame()
+{
+    uint8_t p[_maxFrame];
+    size_t n = cobsDecode(_frame, _len, p);
+    uint8_t seq = n > 1 ? p[1] : 0;
+
+    _frames++;
+    if (n < 4 || crc16(p, n - 2) != (p[n - 2] | p[n - 1] << 8))
+    {
+        _errors++;
+        if (n > 1 && (p[0] & FLAG_ACK)) reply(seq, ST_CRC);
+        return;
+    }
+
+    uint8_t flags = p[0];
+    size_t i = 2;
+    uint32_t usTime = 0;
+    if (flags & FLAG_TIME)
+    {
+        if (n < 8) { _errors++; reply(seq, ST_FORMAT); return; }
+        usTime = p[2] | p[3] << 8 | p[4] << 16 | (uint32_t)p[5] << 24;
+        i = 6;
+    }
+    if ((n - 2 - i) % 3 != 0)
+    {
+        _errors++;
+        if (flags & FLAG_ACK) reply(seq, ST_FORMAT);
+        return;
+    }
+
+    CwUpdate u;
+    u.channel = _channel;
+    for (; i < n - 2; i += 3)
+    {
+        int v = p[i + 1] | p[i + 2] << 8;
+        switch (p[i])
+        {
+            case TAG_STEP:   u.setStep(constrain(v, 1, 65535));   break;
+            case TAG_DIVI:   u.setDivi(constrain(v, 0, 7));       break;
+            case TAG_SCALE:  u.setScale(constrain(v, 0, 3));      break;
+            case TAG_OFFSET: u.setOffset(constrain(v, 0, 255));   break;
+            case TAG_MODE:   u.setMode((CWmode)(v & 3));          break;
+            case TAG_ENABLE: u.setEnable(v != 0);                 break;
+            default:
+                _errors++;
+                if (flags & FLAG_ACK) reply(seq, ST_FORMAT);
+                return;
+        }
+    }
+
+    uint8_t status = ST_OK;
+    if ((flags & FLAG_TIME) && (int32_t)(usTime - micros()) > 0)
+    {
+        if (_queued < _queueSize)  // keep the queue ordered by time
+        {
+            int k = _queued;
+            while (k > 0 && (int32_t)(_queue[k - 1].usTime - usTime) > 0)
+            {
+                _queue[k] = _queue[k - 1];
+                k--;
+            }
+            _queue[k] = { usTime, u };
+            _queued++;
+        }
+        else
+        {
+            status = ST_QUEUE_FULL;
+        }
+    }
+    else
+    {
+        _cwGen.update(u);
+        _changed = true;
+    }
+    if (status == ST_OK) _updates++;
+    if (flags & FLAG_ACK) reply(seq, status);
+}
+
+void CwProtocol::reply(uint8_t seq, uint8_t status)
+{
+    uint32_t t = micros();
+    uint8_t p[9] = { FLAG_REPLY, seq, status, (uint8_t)t, (uint8_t)(t >> 8), (uint8_t)(t >> 16), (uint8_t)(t >> 24) };
+    uint16_t crc = crc16(p, 7);
+    p[7] = crc & 0xff;
+    p[8] = crc >> 8;
+
+    uint8_t frame[12];
+    frame[0] = 0;
+    size_t n = cobsEncode(p, sizeof(p), &frame[1]);
+    frame[n + 1] = 0;
+    _io.write(frame, n + 2);
+}
+
+/**
+ * Consistent Overhead Byte Stuffing. dst must hold len + len/254 + 1 bytes.
+ */
+size_t CwProtocol::cobsEncode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    size_t code = 0, out = 1;
+    uint8_t n = 1;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (src[i] != 0)
+        {
+            dst[out++] = src[i];
+            n++;
+        }
+        if (src[i] == 0 || n == 0xff)
+        {
+            dst[code] = n;
+            code = out++;
+            n = 1;
+        }
+    }
+    dst[code] = n;
+    return out;
+}
+
+/**
+ * Returns the decoded length or 0 if src is not a valid COBS block.
+ */
+size_t CwProtocol::cobsDecode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    size_t in = 0, out = 0;
+
+    while (in < len)
+    {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1 > len) return 0;
+        for (uint8_t k = 1; k < code; k++) dst[out++] = src[in++];
+        if (code != 0xff && in < len) dst[out++] = 0;
+    }
+    return out;
+}
+
+uint16_t CwProtocol::crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xffff;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int k = 0; k < 8; k++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include "CosineWaveGenerator.h"
+
+/**
+ * Class        CwProtocol
+ *
+ * Purpose      Compact binary control protocol for the cosine wave generator.
+ *              A frame carries a batch of updates which is applied with one
+ *              call of CosineWaveGenerator::update(). Frames are COBS encoded
+ *              and enclosed in 0x00 delimiters, so they can share the serial
+ *              port with the text commands of CwScpi: the first 0x00 switches
+ *              the receiver to binary, the closing 0x00 back to text.
+ *
+ * Frame        0x00 COBS(payload) 0x00
+ *              payload  flags(1) seq(1) [time(4)] {tag(1) value(2)}* crc(2)
+ *              flags    bit 0: time present, the batch is applied when micros() reaches it
+ *                       bit 1: acknowledge requested
+ *              tags     1 step, 2 divider, 3 scale, 4 offset, 5 mode, 6 enable
+ *              values and time are little endian, the crc is CRC-16/CCITT-FALSE
+ *              over flags .. last record
+ *              An acknowledge frame has flags 0x80, the seq of the request,
+ *              a status byte (0 = ok) and micros() of the device (4 bytes).
+ *
+ * Usage        CwProtocol cwProto(cwGen, Serial);
+ *              void loop()
+ *              {
+ *                  while (Serial.available()) { char c = Serial.read(); if (! cwProto.feed(c)) scpi.feed(c); }
+ *                  cwProto.loop();  // applies timed batches
+ *              }
+ */
+class CwProtocol
+{
+    public:
+        enum Tag : uint8_t { TAG_STEP = 1, TAG_DIVI, TAG_SCALE, TAG_OFFSET, TAG_MODE, TAG_ENABLE };
+        enum Flags : uint8_t { FLAG_TIME = 0x01, FLAG_ACK = 0x02, FLAG_REPLY = 0x80 };
+        enum Status : uint8_t { ST_OK = 0, ST_CRC, ST_FORMAT, ST_QUEUE_FULL };
+
+        CwProtocol(CosineWaveGenerator &cwGen, Stream &io, dac_channel_t channel=DAC_CHANNEL_2) :
+            _cwGen(cwGen), _io(io), _channel(channel)
+        {}
+
+        bool feed(char c);
+        bool loop();
+        int32_t usUntilNext();
+        void printStats();
+
+        static size_t cobsEncode(const uint8_t *src, size_t len, uint8_t *dst);
+        static size_t cobsDecode(const uint8_t *src, size_t len, uint8_t *dst);
+        static uint16_t crc16(const uint8_t *data, size_t len);
+
+    private:
+        static const int _maxFrame = 128;   // encoded frame size limit
+        static const int _queueSize = 8;    // timed batches waiting for their time
+
+        struct TimedUpdate { uint32_t usTime; CwUpdate u; };
+
+        void handleFrame();
+        void reply(uint8_t seq, uint8_t status);
+
+        CosineWaveGenerator &_cwGen;
+        Stream &_io;
+        dac_channel_t _channel;
+
+        bool _inFrame = false;
+        bool _discard = false;          // in an oversized frame, drop it up to its closing 0x00
+        uint8_t _frame[_maxFrame];
+        int _len = 0;
+        bool _changed = false;
+
+        TimedUpdate _queue[_queueSize];
+        int _queued = 0;
+
+        uint32_t _frames = 0;
+        uint32_t _updates = 0;
+        uint32_t _errors = 0;
+};
@@ -0,0 +1,250 @@
+#include "CwScpi.h"
+
+const CwScpi::Command CwScpi::_commandTable[] =
+{
+    { "*IDN", "*IDN",      &CwScpi::cmdIdn,  false },
+    { "FREQ", "FREQUENCY", &CwScpi::cmdFreq, true  },
+    { "STEP", "STEP",      &CwScpi::cmdStep, true  },
+    { "DIV",  "DIVIDER",   &CwScpi::cmdDiv,  true  },
+    { "MODE", "MODE",      &CwScpi::cmdMode, true  },
+    { "SCAL", "SCALE",     &CwScpi::cmdScal, true  },
+    { "OFFS", "OFFSET",    &CwScpi::cmdOffs, true  },
+    { "OUTP", "OUTPUT",    &CwScpi::cmdOutp, true  },
+    { "REF",  "REFERENCE", &CwScpi::cmdRef,  true  },
+    { "TOL",  "TOLERANCE", &CwScpi::cmdTol,  true  },
+};
+
+/**
+ * Consume the characters received so far. Never waits for more input.
+ * Returns true if a command changed the generator.
+ */
+bool CwScpi::loop()
+{
+    bool changed = false;
+    while (_io.available() > 0)
+    {
+        changed |= feed((char)_io.read());
+    }
+    return changed;
+}
+
+/**
+ * Add one character to the line buffer and execute the line when it is complete.
+ * Returns true if a command changed the generator.
+ */
+bool CwScpi::feed(char c)
+{
+    if (c == '\n' || c == '\r')
+    {
+        bool changed = false;
+        if (_overflow)
+        {
+            _io.println("ERR line too long");
+        }
+        else if (_len > 0)
+        {
+            _line[_len] = '\0';
+            _changed = false;
+            execute(_line);
+            changed = _changed;
+        }
+        _len = 0;
+        _overflow = false;
+        return changed;
+    }
+
+    if (_len < (int)sizeof(_line) - 1)
+        _line[_len++] = c;
+    else
+        _overflow = true;
+    return false;
+}
+
+void CwScpi::execute(char *line)
+{
+    char *cmd = line;
+    while (cmd)
+    {
+        char *next = strchr(cmd, ';');
+        if (next) *next++ = '\0';
+        executeOne(cmd);
+        cmd = next;
+    }
+}
+
+void CwScpi::executeOne(char *cmd)
+{
+    while (*cmd == ' ') cmd++;
+    if (*cmd == '\0') return;
+
+    char *arg = cmd;
+    while (*arg && *arg != ' ' && *arg != '?') { *arg = toupper(*arg); arg++; }
+    bool query = *arg == '?';
+    if (*arg) *arg++ = '\0';
+    while (*arg == ' ') arg++;
+
+    for (const Command &c : _commandTable)
+    {
+        if (strcmp(cmd, c.shortName) == 0 || strcmp(cmd, c.longName) == 0)
+        {
+            _commands++;
+            if (! query && *arg == '\0')
+            {
+                _io.printf("ERR missing argument %s\n", cmd);
+                return;
+            }
+            (this->*c.handler)(arg, query);
+            if (! query) _changed |= c.changes;
+            return;
+        }
+    }
+    for (int i = 0; i < _userCount; i++)
+    {
+        if (strcmp(cmd, _userCommands[i].name) == 0)
+        {
+            _commands++;
+            _userCommands[i].handler(arg, query, _io);
+            if (! query) _changed |= _userCommands[i].changes;
+            return;
+        }
+    }
+    _io.printf("ERR unknown command %s\n", cmd);
+}
+
+/**
+ * Add an application command. The name is given in upper case without '?'.
+ * Set changes if the command (not the query) may change the generator, 
+ * so loop() and feed() report it.
+ */
+bool CwScpi::addCommand(const char *name, UserHandler handler, bool changes)
+{
+    if (_userCount >= _maxUserCommands) return false;
+    _userCommands[_userCount++] = { name, handler, changes };
+    return true;
+}
+
+/**
+ * The whole argument must be a number, trailing blanks are allowed.
+ * "5abc" is an error and not 5.
+ */
+static bool isNumberEnd(const char *arg, const char *end)
+{
+    if (end == arg) return false;
+    while (isspace((unsigned char)*end)) end++;
+    return *end == '\0';
+}
+
+bool CwScpi::argToInt(const char *arg, int min, int max, int &value)
+{
+    char *end;
+    long v = strtol(arg, &end, 10);
+    if (! isNumberEnd(arg, end) || v < min || v > max)
+    {
+        _io.printf("ERR %s out of range %d..%d\n", arg, min, max);
+        return false;
+    }
+    value = v;
+    return true;
+}
+
+bool CwScpi::argToDouble(const char *arg, double min, double max, double &value)
+{
+    char *end;
+    double v = strtod(arg, &end);
+    if (! isNumberEnd(arg, end) || ! (v >= min && v <= max))
+    {
+        _io.printf("ERR %s out of range %.10g..%.10g\n", arg, min, max);
+        return false;
+    }
+    value = v;
+    return true;
+}
+
+void CwScpi::cmdIdn(const char *arg, bool query)
+{
+    _io.println("dodeka.ch,CYD CosineWaveGenerator,0,1.0");
+}
+
+void CwScpi::cmdFreq(const char *arg, bool query)
+{
+    if (query)
+    {
+        _io.printf("%.10g\n", _cwGen.getActualFrequency());
+        return;
+    }
+    double f;
+    if (! argToDouble(arg, 15.0, 8000000.0, f)) return;
+    // setFrequency(double) reports the solution with printf, which is the
+    // same UART as the SCPI port, so solve quietly and apply it as a batch.
+    int divi, step;
+    _cwGen.solveFrequency(f, divi, step);
+    CwUpdate u;
+    u.channel = _channel;
+    u.setFrequency(f, divi, step);
+    _cwGen.update(u);
+}
+
+void CwScpi::cmdStep(const char *arg, bool query)
+{
+    int v;
+    if (query) _io.printf("%d\n", _cwGen.getFrequencyStep());
+    else if (argToInt(arg, 1, 65535, v)) _cwGen.setFrequencyStep(v, _channel);
+}
+
+void CwScpi::cmdDiv(const char *arg, bool query)
+{
+    int v;
+    if (query) _io.printf("%d\n", _cwGen.getClockDivisor());
+    else if (argToInt(arg, 0, 7, v)) _cwGen.setClockDivisor(v, _channel);
+}
+
+void CwScpi::cmdMode(const char *arg, bool query)
+{
+    int v;
+    if (query) _io.printf("%d\n", (int)_cwGen.getMode(_channel));
+    else if (argToInt(arg, 0, 3, v)) _cwGen.setMode(_channel, (CWmode)v);
+}
+
+void CwScpi::cmdScal(const char *arg, bool query)
+{
+    int v;
+    if (query) _io.printf("%d\n", _cwGen.getScale(_channel));
+    else if (argToInt(arg, 0, 3, v)) _cwGen.setScale(_channel, v);
+}
+
+void CwScpi::cmdOffs(const char *arg, bool query)
+{
+    int v;
+    if (query) _io.printf("%d\n", _cwGen.getOffset(_channel));
+    else if (argToInt(arg, 0, 255, v)) _cwGen.setOffset(_channel, v);
+}
+
+void CwScpi::cmdOutp(const char *arg, bool query)
+{
+    if (query)
+        _io.println(_cwGen.isEnabled(_channel) ? "1" : "0");
+    else if (strcasecmp(arg, "ON") == 0 || strcmp(arg, "1") == 0)
+        _cwGen.enable(_channel);
+    else if (strcasecmp(arg, "OFF") == 0 || strcmp(arg, "0") == 0)
+        _cwGen.disable(_channel);
+    else
+        _io.printf("ERR %s is not ON or OFF\n", arg);
+}
+
+void CwScpi::cmdRef(const char *arg, bool query)
+{
+    if (query)
+    {
+        _io.printf("%.10g\n", _cwGen.getReferenceFrequency());
+        return;
+    }
+    double f0;
+    if (argToDouble(arg, 100.0, 150.0, f0)) _cwGen.setReferenceFrequency(f0);
+}
+
+void CwScpi::cmdTol(const char *arg, bool query)
+{
+    int v;
+    if (query) _io.printf("%d\n", _cwGen.getToleranceForBestMatch());
+    else if (argToInt(arg, 1, 999, v)) _cwGen.setToleranceForBestMatch(v);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <Arduino.h>
+#include "CosineWaveGenerator.h"
+
+/**
+ * Class        CwScpi
+ *
+ * Purpose      SCPI-style command interface for the cosine wave generator.
+ *              Characters are collected without blocking until a line is
+ *              complete, then the line is executed. Several commands may be
+ *              given on one line separated by ';'. Queries end with '?' and
+ *              are answered with one line.
+ *
+ * Commands     *IDN?                 identification
+ *              FREQ <Hz> | FREQ?     frequency, solved with the tolerance of the generator
+ *              STEP <n>  | STEP?     frequency step 1..65535
+ *              DIV <n>   | DIV?      clock divider 0..7
+ *              MODE <n>  | MODE?     mode 0..3
+ *              SCAL <n>  | SCAL?     scale 0..3
+ *              OFFS <n>  | OFFS?     offset 0..255
+ *              OUTP ON|OFF | OUTP?   enable/disable the output
+ *              REF <Hz>  | REF?      reference frequency f0
+ *              TOL <n>   | TOL?      tolerance in o/oo
+ *              Long forms like FREQUENCY, DIVIDER or OUTPUT are accepted too.
+ *              Errors are answered with "ERR <reason>".
+ *              The application can add its own commands with addCommand().
+ *
+ * Usage        CwScpi scpi(cwGen, Serial);
+ *              void loop()
+ *              {
+ *                  if (scpi.loop()) syncUi();  // true when a command changed the generator
+ *              }
+ */
+class CwScpi
+{
+    public:
+        CwScpi(CosineWaveGenerator &cwGen, Stream &io, dac_channel_t channel=DAC_CHANNEL_2) :
+            _cwGen(cwGen), _io(io), _channel(channel)
+        {}
+
+        using UserHandler = void (*)(const char *arg, bool query, Stream &io);
+
+        bool loop();
+        bool feed(char c);
+        bool addCommand(const char *name, UserHandler handler, bool changes=false);
+        uint32_t getCommandCount() { return _commands; }
+
+    private:
+        using Handler = void (CwScpi::*)(const char *arg, bool query);
+        struct Command { const char *shortName; const char *longName; Handler handler; bool changes; };
+        struct UserCommand { const char *name; UserHandler handler; bool changes; };
+        static const Command _commandTable[];
+        static const int _maxUserCommands = 12;
+
+        void execute(char *line);
+        void executeOne(char *cmd);
+        bool argToInt(const char *arg, int min, int max, int &value);
+        bool argToDouble(const char *arg, double min, double max, double &value);
+
+        void cmdIdn(const char *arg, bool query);
+        void cmdFreq(const char *arg, bool query);
+        void cmdStep(const char *arg, bool query);
+        void cmdDiv(const char *arg, bool query);
+        void cmdMode(const char *arg, bool query);
+        void cmdScal(const char *arg, bool query);
+        void cmdOffs(const char *arg, bool query);
+        void cmdOutp(const char *arg, bool query);
+        void cmdRef(const char *arg, bool query);
+        void cmdTol(const char *arg, bool query);
+
+        CosineWaveGenerator &_cwGen;
+        Stream &_io;
+        dac_channel_t _channel;
+        UserCommand _userCommands[_maxUserCommands];
+        int _userCount = 0;
+        char _line[96];
+        int  _len = 0;
+        bool _overflow = false;
+        bool _changed = false;
+        uint32_t _commands = 0;
+};
@@ -0,0 +1,263 @@
+#include "CwSequencer.h"
+#include "VspiBus.h"
+
+static const char seqMagic[4] = {'C', 'W', 'S', '1'};
+
+/**
+ * Open the program file, prefetch both buffers and start playing.
+ * If repeat is true, the program restarts at its beginning when the end is reached.
+ */
+bool CwSequencer::begin(const char *path, bool repeat)
+{
+    stop();
+
+    bool opened, isProgram;
+    _isCsv  = String(path).endsWith(".csv") || String(path).endsWith(".CSV");
+    _repeat = repeat;
+    _f0 = _cwGen.getReferenceFrequency();
+    _tolerance = _cwGen.getToleranceForBestMatch();
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _file = SD.open(path, FILE_READ);
+        opened = bool(_file);
+        isProgram = opened && rewind();
+        if (opened && ! isProgram) _file.close();
+    }
+    if (! opened)
+    {
+        log_e("==> cannot open program %s", path);
+        return false;
+    }
+    if (! isProgram)
+    {
+        log_e("==> %s is not a sequencer program", path);
+        return false;
+    }
+
+    if (_timer == nullptr)
+    {
+        esp_timer_create_args_t args{};
+        args.callback = onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "cwSeq";
+        esp_timer_create(&args, &_timer);
+    }
+    if (_loader == nullptr)
+    {
+        _fileLock = xSemaphoreCreateMutex();
+        xTaskCreate(loaderTask, "cwSeqLoader", 4096, this, 2, &_loader);
+    }
+
+    _filled[0] = _filled[1] = false;
+    _eof = false;
+    _active = _pos = 0;
+    _stepsLoaded = _stepsApplied = _underruns = 0;
+    _usMaxLate = 0;
+    fill(0);
+    fill(1);
+    if (! _filled[0])
+    {
+        log_e("==> program %s is empty", path);
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _file.close();
+        return false;
+    }
+
+    _running = true;
+    _resync  = false;
+    _usDeadline = esp_timer_get_time();
+    esp_timer_start_once(_timer, 0);
+    log_i("==> playing %s", path);
+    return true;
+}
+
+void CwSequencer::stop()
+{
+    _running = false;
+    if (_timer) esp_timer_stop(_timer);
+    if (_fileLock) xSemaphoreTake(_fileLock, portMAX_DELAY);
+    if (_file)
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _file.close();
+    }
+    if (_fileLock) xSemaphoreGive(_fileLock);
+}
+
+bool CwSequencer::isRunning()
+{
+    return _running;
+}
+
+void CwSequencer::printStats()
+{
+    Serial.printf(R"(
+Sequencer
+---------
+running     %6s
+loaded      %6u steps
+applied     %6u steps
+underruns   %6u
+max late    %6lld us
+)", _running ? "yes" : "no", _stepsLoaded, _stepsApplied, _underruns, (long long)_usMaxLate);
+}
+
+void CwSequencer::onTimer(void *arg)
+{
+    static_cast<CwSequencer *>(arg)->tick();
+}
+
+/**
+ * Runs in the esp_timer task. Applies the step that is due, advances to the
+ * next one and rearms the timer for its deadline. A drained buffer is handed
+ * back to the loader task. update() takes the lock of the generator, which
+ * loop() also writes.
+ */
+void CwSequencer::tick()
+{
+    if (! _running) return;
+
+    int64_t usNow = esp_timer_get_time();
+    if (! _filled[_active])
+    {
+        if (_eof)  // program finished
+        {
+            _running = false;
+            log_i("==> program finished");
+            return;
+        }
+        _underruns++;  // loader fell behind, keep the current output and retry
+        _resync = true;
+        esp_timer_start_once(_timer, 1000);
+        return;
+    }
+
+    if (_resync)
+    {
+        _usDeadline = usNow;
+        _resync = false;
+    }
+    if (usNow - _usDeadline > _usMaxLate) _usMaxLate = usNow - _usDeadline;
+
+    const CwSeqStep &s = _buf[_active][_pos];
+    CwUpdate u;
+    u.channel = _channel;
+    u.setFrequency(s.freq, s.divi, s.step);
+    u.setMode((CWmode)s.mode);
+    u.setScale(s.scale);
+    u.setOffset(s.offset);
+    _cwGen.update(u);
+    _stepsApplied++;
+    _usDeadline += (int64_t)s.msDwell * 1000;
+
+    if (++_pos >= _count[_active])
+    {
+        _filled[_active] = false;
+        _active ^= 1;
+        _pos = 0;
+        xTaskNotifyGive(_loader);
+    }
+
+    int64_t usWait = _usDeadline - esp_timer_get_time();
+    esp_timer_start_once(_timer, usWait > 0 ? usWait : 0);
+}
+
+void CwSequencer::loaderTask(void *arg)
+{
+    CwSequencer *seq = static_cast<CwSequencer *>(arg);
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (int b = 0; b < 2; b++)
+        {
+            if (seq->_running && ! seq->_filled[b]) seq->fill(b);
+        }
+    }
+}
+
+/**
+ * Load and pre-solve the next steps of the program into buffer b.
+ */
+void CwSequencer::fill(int b)
+{
+    int n = 0;
+
+    xSemaphoreTake(_fileLock, portMAX_DELAY);
+    vspiAcquire(VspiDevice::SDCARD);
+    while (n < _bufSize && ! _eof && _file)
+    {
+        if (readStep(_buf[b][n]))
+        {
+            n++;
+        }
+        else if (! (_repeat && _stepsLoaded + n > 0 && rewind()))
+        {
+            _eof = true;
+        }
+    }
+    vspiRelease(VspiDevice::SDCARD);
+    xSemaphoreGive(_fileLock);
+
+    _stepsLoaded += n;
+    _count[b] = n;
+    _filled[b] = n > 0;
+}
+
+/**
+ * Read the next program entry and solve its divider/step pair.
+ * Returns false at the end of the file.
+ */
+bool CwSequencer::readStep(CwSeqStep &s)
+{
+    double freq;
+    int mode, scale, offset;
+    unsigned long msDwell;
+
+    if (_isCsv)
+    {
+        char line[80];
+        while (true)
+        {
+            if (! _file.available()) return false;
+            int len = _file.readBytesUntil('\n', line, sizeof(line) - 1);
+            line[len] = '\0';
+            if (len == 0 || line[0] == '#' || line[0] == '\r') continue;
+            if (sscanf(line, "%lf,%d,%d,%d,%lu", &freq, &mode, &scale, &offset, &msDwell) == 5) break;
+            log_w("skipped program line: %s", line);
+        }
+    }
+    else
+    {
+        CwSeqRecord r;
+        if (_file.read((uint8_t *)&r, sizeof(r)) != sizeof(r)) return false;
+        freq    = r.freq;
+        mode    = r.mode;
+        scale   = r.scale;
+        offset  = r.offset;
+        msDwell = r.msDwell;
+    }
+
+    int divi, step;
+    CosineWaveGenerator::solveFrequency(freq, _f0, _tolerance, divi, step);  // the UI may change f0 meanwhile
+    s.freq    = freq;
+    s.divi    = divi;
+    s.step    = step;
+    s.mode    = mode & 3;
+    s.scale   = scale & 3;
+    s.offset  = offset;
+    s.msDwell = msDwell;
+    return true;
+}
+
+/**
+ * Position the file at the first program entry.
+ */
+bool CwSequencer::rewind()
+{
+    _file.seek(0);
+    if (_isCsv) return true;
+
+    char magic[4];
+    return _file.read((uint8_t *)magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, seqMagic, sizeof(magic)) == 0;
+}
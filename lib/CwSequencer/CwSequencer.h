@@ -0,0 +1,99 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "esp_timer.h"
+#include "CosineWaveGenerator.h"
+
+/**
+ * Class        CwSequencer
+ *
+ * Purpose      Plays a program of (frequency, mode, scale, offset, dwell) steps
+ *              from the SD card on the cosine wave generator.
+ *              The program is streamed through two buffers: while the timer
+ *              plays one buffer, a loader task refills the other one. Each
+ *              entry is pre-solved to its divider/step pair when it is loaded,
+ *              with f0 and tolerance as they were at begin(), so the timer
+ *              callback only writes the registers. Dwell times are counted
+ *              from deadline to deadline and therefore do not drift.
+ *
+ * Formats      CSV    one step per line: freq,mode,scale,offset,dwell_ms
+ *                     empty lines and lines starting with # are skipped
+ *              binary magic "CWS1" followed by CwSeqRecord entries (12 bytes)
+ *              Files with the extension .csv are read as CSV, all others as binary.
+ *
+ * Usage        CwSequencer sequencer(cwGen);
+ *              initSDCard(sdcardSPI);
+ *              sequencer.begin("/PROGRAMS/sweep.csv");
+ */
+
+// Program entry as stored in a binary program file
+struct CwSeqRecord
+{
+    float    freq;      // target frequency in Hz
+    uint32_t msDwell;   // time to hold this step
+    uint8_t  mode;      // 0..3, see CWmode
+    uint8_t  scale;     // 0..3
+    uint8_t  offset;    // 0..255
+    uint8_t  reserved;
+};
+
+// Pre-solved program entry as held in the prefetch buffers
+struct CwSeqStep
+{
+    float    freq;      // target frequency that divi and step were solved for
+    uint16_t step;
+    uint8_t  divi;
+    uint8_t  mode;
+    uint8_t  scale;
+    uint8_t  offset;
+    uint32_t msDwell;   // in us it would overflow 32 bits after 71 minutes
+};
+
+class CwSequencer
+{
+    public:
+        CwSequencer(CosineWaveGenerator &cwGen, dac_channel_t channel=DAC_CHANNEL_2) :
+            _cwGen(cwGen), _channel(channel)
+        {}
+
+        bool begin(const char *path, bool repeat=false);
+        void stop();
+        bool isRunning();
+        void printStats();
+
+    private:
+        static const int _bufSize = 64;     // steps per prefetch buffer
+
+        static void onTimer(void *arg);
+        static void loaderTask(void *arg);
+        void tick();
+        void fill(int b);
+        bool readStep(CwSeqStep &s);
+        bool rewind();
+
+        CosineWaveGenerator &_cwGen;
+        dac_channel_t _channel;
+        File _file;
+        bool _isCsv = false;
+        bool _repeat = false;
+        double _f0 = 0.0;                   // snapshot for the pre-solve in the loader task
+        int _tolerance = 10;
+        esp_timer_handle_t _timer = nullptr;
+        TaskHandle_t _loader = nullptr;
+        SemaphoreHandle_t _fileLock = nullptr;
+
+        CwSeqStep _buf[2][_bufSize];
+        int _count[2] = {0, 0};
+        volatile bool _filled[2] = {false, false};
+        volatile bool _eof = false;
+        volatile bool _running = false;
+        int _active = 0;                    // buffer played by the timer
+        int _pos = 0;                       // next step in the active buffer
+        bool _resync = false;               // restart the deadlines after an underrun
+        int64_t _usDeadline = 0;            // time the next step is due
+
+        uint32_t _stepsLoaded  = 0;
+        uint32_t _stepsApplied = 0;
+        uint32_t _underruns    = 0;
+        int64_t  _usMaxLate    = 0;
+};
@@ -0,0 +1,137 @@
+#include "CwSleep.h"
+#include <sys/time.h>
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "UiComponents.h"
+
+// Kept in RTC slow memory, survives light and deep sleep but not a power cycle
+struct RtcState
+{
+    static const uint32_t valid = 0x43575350;  // "CWSP"
+
+    uint32_t magic;
+    CwPreset preset;
+    uint32_t lightSleeps;
+    uint32_t deepSleeps;
+    uint64_t usLight;          // time spent in light sleep
+    uint64_t usDeep;           // time spent in deep sleep
+    uint64_t usAwake;          // time awake, up to the last sleep
+    int64_t  usAsleepSince;    // RTC time when the deep sleep started
+    uint32_t usLastWake;       // wake-up to interactive
+    uint32_t usMaxWake;
+};
+RTC_DATA_ATTR static RtcState rtc;
+
+/**
+ * Microseconds of the RTC clock, continues through deep sleep
+ */
+int64_t CwSleep::rtcTimeUs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * Returns true with the snapshot in p if the board woke up from deep sleep
+ */
+bool CwSleep::warmStart(CwPreset &p)
+{
+    if (rtc.magic != RtcState::valid)  // cold boot, RTC memory holds garbage
+    {
+        rtc = RtcState();
+        rtc.magic = RtcState::valid;
+        return false;
+    }
+    if (rtc.usAsleepSince == 0) return false;  // reset without sleep
+    rtc.usDeep += rtcTimeUs() - rtc.usAsleepSince;
+    rtc.usAsleepSince = 0;
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_EXT0) return false;
+    p = rtc.preset;
+    _usWake = _usAwakeSince = 0;  // esp_timer restarted at the wake-up
+    _wakePending = true;
+    return true;
+}
+
+/**
+ * Save the settings and sleep until the screen is touched. Light sleep 
+ * returns after the wake-up with the settings re-applied, the caller redraws 
+ * the UI and calls interactive() on the next loop. Deep sleep does not return.
+ */
+bool CwSleep::sleep(SleepMode mode, uint8_t app)
+{
+    rtc.preset = _presets.capture(app);
+    rtc.usAwake += esp_timer_get_time() - _usAwakeSince;
+    _lcd.setBrightness(0);
+    _lcd.sleep();
+    esp_sleep_enable_ext0_wakeup(_wakePin, 0);  // PENIRQ is low while touched
+
+    if (mode == SleepMode::DEEP)
+    {
+        _presets.save(0, rtc.preset);  // in case the power goes while sleeping
+        rtc.deepSleeps++;
+        rtc.usAsleepSince = rtcTimeUs();
+        Serial.flush();
+        esp_deep_sleep_start();
+    }
+
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, _keepSignal ? ESP_PD_OPTION_ON : ESP_PD_OPTION_AUTO);
+    uart_set_wakeup_threshold(UART_NUM_0, 3);  // a few edges on RX, the first characters are lost
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+    Serial.flush();
+    int64_t usStart = rtcTimeUs();
+    bool ok = esp_light_sleep_start() == ESP_OK;
+    _usWake = _usAwakeSince = esp_timer_get_time();
+    _wakePending = true;
+    rtc.usLight += rtcTimeUs() - usStart;
+    rtc.lightSleeps++;
+
+    _presets.apply(rtc.preset);  // one register update
+    _lcd.wakeup();
+    _lcd.setBrightness(255);
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0)
+        UiPanel::waitForRelease();  // the waking touch is not a key press
+    return ok;
+}
+
+/**
+ * Call from loop(). The first call after a wake-up records the latency.
+ */
+void CwSleep::interactive()
+{
+    if (! _wakePending) return;
+    _wakePending = false;
+    uint32_t us = esp_timer_get_time() - _usWake;
+    rtc.usLastWake = us;
+    rtc.usMaxWake = std::max(rtc.usMaxWake, us);
+    log_i("==> interactive %u us after wake-up", us);
+}
+
+/**
+ * Currents of the board in mA, measured with a meter in each state
+ */
+void CwSleep::setCurrents(float mAAwake, float mALight, float mADeep)
+{
+    _mA[0] = mAAwake;
+    _mA[1] = mALight;
+    _mA[2] = mADeep;
+}
+
+void CwSleep::printStats()
+{
+    double sAwake = (rtc.usAwake + esp_timer_get_time() - _usAwakeSince) / 1e6;
+    double sLight = rtc.usLight / 1e6;
+    double sDeep  = rtc.usDeep / 1e6;
+    double sTotal = sAwake + sLight + sDeep;
+    double mAavg  = sTotal > 0 ? (sAwake * _mA[0] + sLight * _mA[1] + sDeep * _mA[2]) / sTotal : 0.0;
+    Serial.printf(R"(
+Sleep
+-----
+light sleeps  %8u  %10.1f s
+deep sleeps   %8u  %10.1f s
+awake                   %10.1f s (%.1f %%)
+wake-up       %8u us last, %u us max (to interactive)
+current       %8.2f mA average (awake %.1f, light %.2f, deep %.3f mA)
+)", rtc.lightSleeps, sLight, rtc.deepSleeps, sDeep, sAwake, sTotal > 0 ? 100.0 * sAwake / sTotal : 100.0,
+    rtc.usLastWake, rtc.usMaxWake, mAavg, _mA[0], _mA[1], _mA[2]);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_sleep.h"
+#include "lgfx_ESP32_2432S028.h"
+#include "CwPresets.h"
+
+enum class SleepMode { LIGHT, DEEP };
+
+/**
+ * Class        CwSleep
+ *
+ * Purpose      Puts the board to sleep until the touch screen is touched. The
+ *              generator settings are kept as preset in RTC slow memory, which
+ *              survives both sleep modes.
+ *              Light sleep keeps RAM and the display contents; sleep() returns
+ *              after the wake-up and re-applies the settings. With keepSignal
+ *              the 8 MHz RTC clock stays on and the output continues while
+ *              the board sleeps. Deep sleep powers down everything but the RTC;
+ *              the board restarts through setup(), which finds the snapshot
+ *              with warmStart() and skips the cold boot sequence.
+ *              Wake-up is triggered by the touch controller's IRQ line (TP_IRQ,
+ *              low while touched) through the RTC GPIO wake-up (ext0). Light
+ *              sleep also wakes up on input on the serial port (UART0); the
+ *              characters that wake the board are lost.
+ *
+ *              printStats() reports the number of sleeps, the time asleep per
+ *              mode, the latency from wake-up to the first interactive frame
+ *              and the average current estimated from the duty cycle. The
+ *              currents of the modes depend on the board and must be measured
+ *              once with a meter and passed to setCurrents().
+ *
+ * Usage        CwSleep sleeper(lcd, presets);
+ *              setup: CwPreset p; if (sleeper.warmStart(p)) ... apply p, paint once
+ *              loop:  sleeper.interactive();               // records the wake-up latency
+ *                     sleeper.sleep(SleepMode::LIGHT, app); // returns after wake-up
+ */
+class CwSleep
+{
+    public:
+        CwSleep(LGFX &lcd, CwPresets &presets, gpio_num_t wakePin=(gpio_num_t)TP_IRQ) :
+            _lcd(lcd), _presets(presets), _wakePin(wakePin)
+        {}
+
+        bool warmStart(CwPreset &p);
+        bool sleep(SleepMode mode, uint8_t app=0);
+        void interactive();
+        void setKeepSignal(bool on) { _keepSignal = on; }
+        void setCurrents(float mAAwake, float mALight, float mADeep);
+        void printStats();
+
+    private:
+        static int64_t rtcTimeUs();
+
+        LGFX &_lcd;
+        CwPresets &_presets;
+        gpio_num_t _wakePin;
+        bool _keepSignal = true;
+        int64_t _usWake = 0;           // esp_timer at the last wake-up
+        int64_t _usAwakeSince = 0;     // esp_timer at the start of the awake time
+        bool _wakePending = false;     // interactive() not yet called since the wake-up
+        float _mA[3] = { 0, 0, 0 };    // awake, light sleep, deep sleep
+};
@@ -0,0 +1,106 @@
+#include "QoiEncoder.h"
+
+static const uint8_t QOI_OP_INDEX = 0x00;
+static const uint8_t QOI_OP_DIFF  = 0x40;
+static const uint8_t QOI_OP_LUMA  = 0x80;
+static const uint8_t QOI_OP_RUN   = 0xc0;
+static const uint8_t QOI_OP_RGB   = 0xfe;
+
+/**
+ * Write the header and reset the encoder state
+ */
+int QoiEncoder::begin(uint32_t width, uint32_t height, uint8_t *out)
+{
+    _prev = {0, 0, 0};
+    memset(_index, 0, sizeof(_index));
+    _run = 0;
+
+    const uint8_t magic[4] = {'q', 'o', 'i', 'f'};
+    memcpy(out, magic, 4);
+    for (int i = 0; i < 4; i++)  // big endian
+    {
+        out[4 + i] = width  >> (24 - 8 * i);
+        out[8 + i] = height >> (24 - 8 * i);
+    }
+    out[12] = 3;  // channels RGB
+    out[13] = 0;  // sRGB
+    return headerSize;
+}
+
+/**
+ * Encode n pixels, returns the number of bytes written to out
+ * (at most maxEncodedSize(n)). A run that reaches the end of the chunk
+ * is kept pending and continued with the next chunk.
+ */
+int QoiEncoder::encode565(const uint16_t *px, int n, uint8_t *out)
+{
+    int len = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        uint16_t c = px[i];
+        uint8_t r5 = c >> 11, g6 = (c >> 5) & 0x3f, b5 = c & 0x1f;
+        Rgb p = { (uint8_t)(r5 << 3 | r5 >> 2), (uint8_t)(g6 << 2 | g6 >> 4), (uint8_t)(b5 << 3 | b5 >> 2) };
+
+        if (p.r == _prev.r && p.g == _prev.g && p.b == _prev.b)
+        {
+            if (++_run == 62) len += flushRun(&out[len]);
+            continue;
+        }
+        len += flushRun(&out[len]);
+
+        uint32_t rgba = (uint32_t)p.r << 24 | p.g << 16 | p.b << 8 | 0xff;
+        int h = (p.r * 3 + p.g * 5 + p.b * 7 + 255 * 11) % 64;
+        if (_index[h] == rgba)
+        {
+            out[len++] = QOI_OP_INDEX | h;
+        }
+        else
+        {
+            _index[h] = rgba;
+            int8_t vr = p.r - _prev.r;
+            int8_t vg = p.g - _prev.g;
+            int8_t vb = p.b - _prev.b;
+            int8_t vg_r = vr - vg;
+            int8_t vg_b = vb - vg;
+
+            if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+            {
+                out[len++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+            }
+            else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+            {
+                out[len++] = QOI_OP_LUMA | (vg + 32);
+                out[len++] = (vg_r + 8) << 4 | (vg_b + 8);
+            }
+            else
+            {
+                out[len++] = QOI_OP_RGB;
+                out[len++] = p.r;
+                out[len++] = p.g;
+                out[len++] = p.b;
+            }
+        }
+        _prev = p;
+    }
+    return len;
+}
+
+/**
+ * Write the pending run and the end marker
+ */
+int QoiEncoder::end(uint8_t *out)
+{
+    int len = flushRun(out);
+    const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    memcpy(&out[len], padding, sizeof(padding));
+    return len + sizeof(padding);
+}
+
+int QoiEncoder::flushRun(uint8_t *out)
+{
+    if (_run == 0) return 0;
+    out[0] = QOI_OP_RUN | (_run - 1);
+    _run = 0;
+    return 1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Class        QoiEncoder
+ *
+ * Purpose      Streaming encoder for the QOI image format (https://qoiformat.org).
+ *              Pixels are passed in as RGB565 in any number of chunks, e.g. row 
+ *              by row, and the encoded bytes are written to the supplied buffer.
+ *              The encoder keeps only the QOI state (previous pixel, pending run 
+ *              and the 64 entry color index), so its memory use does not depend 
+ *              on the image size. Flat UI areas shrink to one byte per 62 pixels.
+ *              Does not depend on Arduino and can be built on the host.
+ *
+ * Usage        QoiEncoder qoi;
+ *              n = qoi.begin(width, height, out);
+ *              for each row: n += qoi.encode565(row, width, out + n);   // out holds maxEncodedSize(width) more bytes
+ *              n += qoi.end(out + n);
+ */
+class QoiEncoder
+{
+    public:
+        static const int headerSize = 14;
+        static const int endSize    = 9;    // pending run and end marker
+
+        static int maxEncodedSize(int pixels) { return 4 * pixels + 1; }
+
+        int begin(uint32_t width, uint32_t height, uint8_t *out);
+        int encode565(const uint16_t *px, int n, uint8_t *out);
+        int end(uint8_t *out);
+
+    private:
+        struct Rgb { uint8_t r, g, b; };
+
+        int flushRun(uint8_t *out);
+
+        Rgb _prev;
+        uint32_t _index[64];   // RGBA as the decoder sees it, zero for unused entries
+        int _run = 0;
+};
@@ -0,0 +1,136 @@
+#include "SdWriter.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include "esp_timer.h"
+#include "VspiBus.h"
+
+SdWriter::~SdWriter()
+{
+    close();
+}
+
+/**
+ * Create or overwrite the file at path (relative to the card's root).
+ * If preallocate > 0 the clusters for that many bytes are allocated at once.
+ */
+bool SdWriter::open(const char *path, uint32_t preallocate)
+{
+    close();
+    _usStart = esp_timer_get_time();
+    _used = _size = _writes = _usMax = _usTotal = 0;
+
+    if (! _buffer) _buffer = (uint8_t *)malloc(_bufferSize);
+    if (! _buffer)
+    {
+        log_e("==> out of memory");
+        return false;
+    }
+
+    char fullPath[80];
+    snprintf(fullPath, sizeof(fullPath), "%s%s", _mountpoint, path);
+    VspiTransaction bus(VspiDevice::SDCARD);
+    _fd = ::open(fullPath, O_WRONLY | O_CREAT | O_TRUNC);
+    if (_fd < 0)
+    {
+        log_e("==> cannot open %s", fullPath);
+        return false;
+    }
+    _ok = true;
+    if (preallocate > 0)  // seeking beyond the end extends the cluster chain of the file
+    {
+        uint8_t last = 0;
+        _ok = lseek(_fd, preallocate - 1, SEEK_SET) >= 0 && ::write(_fd, &last, 1) == 1 && lseek(_fd, 0, SEEK_SET) == 0;
+        if (! _ok) log_e("==> cannot preallocate %u bytes", preallocate);
+    }
+    _usOpen = esp_timer_get_time() - _usStart;
+    return _ok;
+}
+
+/**
+ * Append len bytes. Returns false once a write to the card failed.
+ */
+bool SdWriter::write(const uint8_t *data, size_t len)
+{
+    if (_fd < 0) return false;
+    _size += len;
+    if (_used > 0)  // complete the buffer first
+    {
+        size_t n = std::min(_bufferSize - _used, len);
+        memcpy(&_buffer[_used], data, n);
+        _used += n;
+        data += n;
+        len  -= n;
+        if (_used < _bufferSize) return _ok;
+        writeOut(_buffer, _bufferSize);
+        _used = 0;
+    }
+    size_t whole = len - len % _bufferSize;
+    if (whole > 0) writeOut(data, whole);
+    memcpy(_buffer, data + whole, len - whole);
+    _used = len - whole;
+    return _ok;
+}
+
+/**
+ * Write the rest, cut the file to its size and close it
+ */
+bool SdWriter::close()
+{
+    if (_fd < 0) return _ok;
+    if (_used > 0) writeOut(_buffer, _used);
+    _used = 0;
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _ok &= ftruncate(_fd, _size) == 0;  // release the preallocated rest
+        _ok &= ::close(_fd) == 0;
+    }
+    _fd = -1;
+    _usTotal = esp_timer_get_time() - _usStart;
+    free(_buffer);
+    _buffer = nullptr;
+    if (! _ok) log_e("==> write failure");
+    return _ok;
+}
+
+bool SdWriter::writeOut(const uint8_t *data, size_t len)
+{
+    if (! _ok) return false;
+    int64_t usStart = esp_timer_get_time();
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _ok = ::write(_fd, data, len) == (ssize_t)len;
+    }
+    uint32_t us = esp_timer_get_time() - usStart;
+    if (_writes < _maxSamples) _samples[_writes] = us;
+    _usMax = std::max(_usMax, us);
+    _writes++;
+    return _ok;
+}
+
+SdWriter::Stats SdWriter::getStats()
+{
+    int n = std::min(_writes, (uint32_t)_maxSamples);
+    uint32_t sorted[_maxSamples];
+    memcpy(sorted, _samples, n * sizeof(uint32_t));
+    std::sort(sorted, sorted + n);
+    auto percentile = [&](int p) { return n > 0 ? sorted[(n - 1) * p / 100] : 0; };
+
+    uint32_t usTotal = _fd >= 0 ? esp_timer_get_time() - _usStart : _usTotal;
+    return { _writes, _size, _usOpen, usTotal, percentile(50), percentile(90), percentile(99), _usMax,
+             usTotal ? _size / (float)usTotal : 0.0f };
+}
+
+void SdWriter::printStats(const char *title)
+{
+    Stats s = getStats();
+    Serial.printf(R"(
+SdWriter %s
+--------
+buffer    %8u bytes
+written   %8u bytes in %u writes
+open      %8u us
+total     %8u us
+speed     %8.3f MB/s
+latency   p50 %u us, p90 %u us, p99 %u us, max %u us
+)", title, (unsigned)_bufferSize, s.bytes, s.writes, s.usOpen, s.usTotal, s.mBps, s.usP50, s.usP90, s.usP99, s.usMax);
+}
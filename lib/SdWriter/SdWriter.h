@@ -0,0 +1,78 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Class        SdWriter
+ *
+ * Purpose      Writes files on the SD card in whole, aligned buffers. Data of
+ *              any size is collected until a buffer of bufferSize bytes (a
+ *              multiple of the 512 byte sector, ideally the cluster size) is
+ *              full; only then the buffer is written. Large writes bypass the
+ *              buffer in whole buffer sizes. Every write therefore starts at
+ *              a buffer boundary of the file and the card never has to read,
+ *              modify and write back a partially written sector.
+ *              If the size of the file is known, open() preallocates it, so
+ *              the FAT is not extended while writing. close() writes the rest
+ *              and cuts the file to the size actually written.
+ *              The file is written through the POSIX interface of the mounted
+ *              card, which passes the buffers unchanged to the driver. Every
+ *              write is one transaction on the VSPI bus (see VspiBus.h).
+ *
+ *              The duration of every write is measured. printStats() reports
+ *              the throughput and the percentiles of the write latency.
+ *
+ * Usage        SdWriter writer;
+ *              writer.open("/SCREENSHOTS/screen.bmp", fileSize);
+ *              writer.write(row, rowSize);  // any size
+ *              writer.close();
+ *              writer.printStats("screen.bmp");
+ */
+class SdWriter
+{
+    public:
+        static const int sectorSize = 512;
+
+        SdWriter(size_t bufferSize=4096, const char *mountpoint="/sd") :
+            _bufferSize(bufferSize & ~(sectorSize - 1)), _mountpoint(mountpoint)
+        {}
+        ~SdWriter();
+
+        bool open(const char *path, uint32_t preallocate=0);
+        bool write(const uint8_t *data, size_t len);
+        bool close();
+        bool isOpen() { return _fd >= 0; }
+        bool ok() { return _ok; }
+        uint32_t size() { return _size; }
+
+        struct Stats
+        {
+            uint32_t writes;    // writes to the card
+            uint32_t bytes;     // bytes written
+            uint32_t usOpen;    // open and preallocation
+            uint32_t usTotal;   // open() to close()
+            uint32_t usP50, usP90, usP99, usMax;  // write latency percentiles
+            float    mBps;      // bytes / usTotal
+        };
+        Stats getStats();
+        void  printStats(const char *title);
+
+    private:
+        static const int _maxSamples = 256;   // latencies of the first writes kept for the percentiles
+
+        bool writeOut(const uint8_t *data, size_t len);
+
+        size_t _bufferSize;
+        const char *_mountpoint;
+        uint8_t *_buffer = nullptr;
+        size_t _used = 0;
+        int  _fd = -1;
+        bool _ok = false;
+        uint32_t _size = 0;
+
+        int64_t  _usStart = 0;
+        uint32_t _usOpen = 0;
+        uint32_t _usTotal = 0;
+        uint32_t _writes = 0;
+        uint32_t _usMax = 0;
+        uint32_t _samples[_maxSamples];
+};
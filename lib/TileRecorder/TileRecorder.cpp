@@ -0,0 +1,171 @@
+#include "TileRecorder.h"
+#include "QoiEncoder.h"
+#include "VspiBus.h"
+
+constexpr int TileRecorder::tileSize;
+static const int qoiTileSize = QoiEncoder::headerSize + QoiEncoder::maxEncodedSize(TileRecorder::tileSize * TileRecorder::tileSize) + QoiEncoder::endSize;
+
+/**
+ * Open the file for appending and write the header. The next capture stores all tiles.
+ */
+bool TileRecorder::begin(const char *path)
+{
+    end();
+    _cols = (_lcd.width()  + tileSize - 1) / tileSize;
+    _rows = (_lcd.height() + tileSize - 1) / tileSize;
+    _hashes = (uint32_t *)calloc(_cols * _rows, sizeof(uint32_t));
+    _strip  = (uint16_t *)malloc(_cols * tileSize * tileSize * sizeof(uint16_t));
+    _qoi    = (uint8_t *)malloc(4 + qoiTileSize);  // with col, row and len
+
+    vspiAcquire(VspiDevice::SDCARD);
+    _file = SD.open(path, FILE_APPEND);
+    if (_file && _hashes && _strip && _qoi)
+    {
+        uint16_t w = _lcd.width(), h = _lcd.height();
+        uint8_t header[9] = { 'C', 'W', 'T', 'L', (uint8_t)w, (uint8_t)(w >> 8), (uint8_t)h, (uint8_t)(h >> 8), tileSize };
+        _recording = _file.write(header, sizeof(header)) == sizeof(header);
+    }
+    vspiRelease(VspiDevice::SDCARD);
+
+    if (! _recording)
+    {
+        log_e("==> cannot record to %s", path);
+        end();
+        return false;
+    }
+    for (int i = 0; i < _cols * _rows; i++) _hashes[i] = 0;  // 0 marks unknown, hashTile() never returns it
+    _frames = _tiles = _bytes = _msCapture = 0;
+    log_i("==> recording to %s", path);
+    return true;
+}
+
+/**
+ * Capture the screen and append the changed tiles.
+ * The SD card gets the bus for each write only, the display reads and 
+ * the hashes need no VSPI, so the touch poll is served in between.
+ * Returns the number of tiles written or -1 on error.
+ */
+int TileRecorder::capture()
+{
+    if (! _recording) return -1;
+
+    uint32_t msStart = millis();
+    int width  = _lcd.width();
+    int height = _lcd.height();
+    int stride = _cols * tileSize;
+    int changed = 0;
+
+    uint8_t frameHeader[5] = { 'F', (uint8_t)msStart, (uint8_t)(msStart >> 8), (uint8_t)(msStart >> 16), (uint8_t)(msStart >> 24) };
+    bool ok;
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        ok = _file.write(frameHeader, sizeof(frameHeader)) == sizeof(frameHeader);
+    }
+
+    for (int row = 0; row < _rows && ok; row++)
+    {
+        int y = row * tileSize;
+        int h = std::min(tileSize, height - y);
+        _lcd.readRect(0, y, width, h, (lgfx::rgb565_t*)_strip);  // HSPI, not affected by the VSPI routing
+        if (width < stride)  // spread the rows to the tile stride
+        {
+            for (int r = h - 1; r >= 0; r--) memmove(&_strip[r * stride], &_strip[r * width], width * 2);
+        }
+        for (int col = 0; col < _cols && ok; col++)
+        {
+            int w = std::min(tileSize, width - col * tileSize);
+            uint32_t hash = hashTile(_strip, stride, col, w, h);
+            if (hash == _hashes[row * _cols + col]) continue;
+            _hashes[row * _cols + col] = hash;
+            {
+                VspiTransaction bus(VspiDevice::SDCARD);
+                ok = writeTile(col, row, _strip, stride, w, h);
+            }
+            changed++;
+        }
+    }
+
+    const uint8_t endOfFrame = 0xff;
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        ok = ok && _file.write(&endOfFrame, 1) == 1;
+        _file.flush();
+    }
+
+    if (! ok)
+    {
+        log_e("==> write failure, recording stopped");
+        end();
+        return -1;
+    }
+    _frames++;
+    _tiles += changed;
+    _bytes += sizeof(frameHeader) + 1;
+    _msCapture += millis() - msStart;
+    return changed;
+}
+
+void TileRecorder::end()
+{
+    if (_file)
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        _file.close();
+    }
+    _recording = false;
+    free(_hashes);
+    free(_strip);
+    free(_qoi);
+    _hashes = nullptr;
+    _strip  = nullptr;
+    _qoi    = nullptr;
+}
+
+void TileRecorder::printStats()
+{
+    Serial.printf(R"(
+Tile recorder
+-------------
+frames     %8u
+tiles      %8u  (%.1f per frame)
+bytes      %8u  (%.0f per frame)
+capture    %8u ms per frame
+)", _frames, _tiles, _frames ? _tiles / (float)_frames : 0.0f, _bytes, 
+    _frames ? _bytes / (float)_frames : 0.0f, _frames ? _msCapture / _frames : 0);
+}
+
+/**
+ * FNV-1a over the pixels of one tile. 0 is reserved for "unknown".
+ */
+uint32_t TileRecorder::hashTile(const uint16_t *strip, int stride, int col, int w, int h)
+{
+    uint32_t hash = 2166136261u;
+    for (int r = 0; r < h; r++)
+    {
+        const uint16_t *px = &strip[r * stride + col * tileSize];
+        for (int x = 0; x < w; x++)
+        {
+            hash = (hash ^ (px[x] & 0xff)) * 16777619u;
+            hash = (hash ^ (px[x] >> 8)) * 16777619u;
+        }
+    }
+    return hash ? hash : 1;
+}
+
+bool TileRecorder::writeTile(int col, int row, const uint16_t *strip, int stride, int w, int h)
+{
+    QoiEncoder qoi;
+    int len = 4 + qoi.begin(w, h, &_qoi[4]);
+    for (int r = 0; r < h; r++)
+    {
+        len += qoi.encode565(&strip[r * stride + col * tileSize], w, &_qoi[len]);
+    }
+    len += qoi.end(&_qoi[len]);
+
+    _qoi[0] = col;
+    _qoi[1] = row;
+    _qoi[2] = (len - 4) & 0xff;
+    _qoi[3] = (len - 4) >> 8;
+    _bytes += len;
+    return _file.write(_qoi, len) == (size_t)len;
+}
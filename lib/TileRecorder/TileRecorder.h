@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "lgfx_ESP32_2432S028.h"
+
+/**
+ * Class        TileRecorder
+ *
+ * Purpose      Records a sequence of screen captures to the SD card, storing
+ *              only the parts of the screen that changed. The screen is divided
+ *              into tiles of 16 x 16 pixels. Each capture hashes all tiles and
+ *              compares them with the hashes of the previous capture; only the
+ *              changed tiles are appended to the file as small QOI images.
+ *              The first capture stores all tiles.
+ *
+ * File         header  "CWTL" width(2) height(2) tileSize(1)
+ *              frame   'F' ms(4) { col(1) row(1) len(2) qoi(len) }* 0xff
+ *              all numbers little endian, ms is millis() at the capture.
+ *              Every begin() appends a new header, the file is never rewritten.
+ *              tools/tiles2png.py rebuilds the frames as PNG files.
+ *
+ * Usage        TileRecorder recorder(lcd);
+ *              recorder.begin("/SCREENSHOTS/session.cwt");
+ *              loop: if (waitRecord.isOver()) recorder.capture();
+ *              recorder.end();
+ */
+class TileRecorder
+{
+    public:
+        static constexpr int tileSize = 16;
+
+        TileRecorder(LGFX &lcd) : _lcd(lcd) {}
+
+        bool begin(const char *path);
+        int  capture();
+        void end();
+        bool isRecording() { return _recording; }
+        void printStats();
+
+    private:
+        static uint32_t hashTile(const uint16_t *strip, int stride, int col, int w, int h);
+        bool writeTile(int col, int row, const uint16_t *strip, int stride, int w, int h);
+
+        LGFX &_lcd;
+        File _file;
+        bool _recording = false;
+        int _cols = 0;
+        int _rows = 0;
+        uint32_t *_hashes = nullptr;    // hash of each tile in the previous capture
+        uint16_t *_strip  = nullptr;    // one row of tiles read from the display
+        uint8_t  *_qoi    = nullptr;    // encoded tile
+
+        uint32_t _frames = 0;
+        uint32_t _tiles  = 0;
+        uint32_t _bytes  = 0;
+        uint32_t _msCapture = 0;        // time of all captures
+};
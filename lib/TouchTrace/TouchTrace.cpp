@@ -0,0 +1,215 @@
+#include "TouchTrace.h"
+#include <SD.h>
+#include <algorithm>
+#include "esp_timer.h"
+#include "VspiBus.h"
+
+/**
+ * Record to the serial port, every event as a TOUCH command
+ */
+bool TouchTrace::record(Print &out)
+{
+    stop();
+    _out = &out;
+    _msRecord = millis();
+    _pressed = false;
+    _recorded = 0;
+    return true;
+}
+
+/**
+ * Record to a file on the SD card, one event per line
+ */
+bool TouchTrace::record(const char *path)
+{
+    stop();
+    if (! _writer.open(path)) return false;
+    _msRecord = millis();
+    _pressed = false;
+    _recorded = 0;
+    return true;
+}
+
+/**
+ * Called with every poll of the touch panel. Records each touched sample
+ * and the first untouched one after them.
+ */
+void TouchTrace::sample(bool touched, int x, int y)
+{
+    if (! isRecording() || (! touched && ! _pressed)) return;
+    _pressed = touched;
+    write({ millis() - _msRecord, (int16_t)(touched ? x : -1), (int16_t)(touched ? y : -1) });
+}
+
+void TouchTrace::write(const Event &e)
+{
+    char line[32];
+    int n = e.x < 0 ? snprintf(line, sizeof(line), "%u UP\n", e.ms)
+                    : snprintf(line, sizeof(line), "%u %d %d\n", e.ms, e.x, e.y);
+    if (_out)
+    {
+        _out->print("TOUCH ");
+        _out->print(line);
+    }
+    else
+    {
+        _writer.write((const uint8_t *)line, n);
+    }
+    _recorded++;
+}
+
+/**
+ * End the recording and the replay
+ */
+void TouchTrace::stop()
+{
+    if (_writer.isOpen()) _writer.close();
+    _out = nullptr;
+    _playing = false;
+}
+
+void TouchTrace::clear()
+{
+    _playing = false;
+    _count = 0;
+    _next = 0;
+}
+
+/**
+ * Append an event to the replay list: "<ms> <x> <y>" or "<ms> UP"
+ */
+bool TouchTrace::add(const char *line)
+{
+    unsigned ms;
+    int x, y;
+    char up[4];
+    if (_count >= maxEvents) return false;
+    if (sscanf(line, "%u %d %d", &ms, &x, &y) == 3)
+        _events[_count++] = { ms, (int16_t)x, (int16_t)y };
+    else if (sscanf(line, "%u %3s", &ms, up) == 2 && strcasecmp(up, "UP") == 0)
+        _events[_count++] = { ms, -1, -1 };
+    else
+        return false;
+    return true;
+}
+
+/**
+ * Replace the replay list with a recording on the SD card. Empty lines
+ * and lines starting with # are skipped.
+ */
+bool TouchTrace::load(const char *path)
+{
+    VspiTransaction bus(VspiDevice::SDCARD);
+    File file = SD.open(path, FILE_READ);
+    if (! file)
+    {
+        log_e("==> cannot open %s", path);
+        return false;
+    }
+    clear();
+    char line[40];
+    bool ok = true;
+    while (ok && file.available())
+    {
+        int len = file.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[len] = 0;
+        if (len > 0 && line[len - 1] == '\r') line[--len] = 0;
+        if (len == 0 || line[0] == '#') continue;
+        ok = add(line);
+    }
+    file.close();
+    if (! ok) log_e("==> %s: bad line or more than %d events", path, maxEvents);
+    return ok;
+}
+
+/**
+ * Start to replay the list, at the recorded times or as fast as possible
+ */
+bool TouchTrace::play(bool fast)
+{
+    if (_count == 0) return false;
+    _fast = fast;
+    _next = 0;
+    _playing = true;
+    _usPlay = esp_timer_get_time();
+    return true;
+}
+
+/**
+ * Pass the next event to the handler when it is due. Returns true once,
+ * when the replay has ended. One event per call: loop() and the UI flows
+ * run in between, as they do between two touch polls.
+ */
+bool TouchTrace::loop()
+{
+    if (! _playing) return false;
+    const Event &e = _events[_next];
+    int64_t usNow = esp_timer_get_time();
+    int64_t usDue = _fast ? usNow : _usPlay + e.ms * 1000LL;
+    if (usNow < usDue) return false;
+
+    _handler(e.x, e.y);  // -1, -1: lifted
+    int64_t usDone = esp_timer_get_time();
+    _usLate[_next] = usNow - usDue;
+    _usHandler[_next] = usDone - usNow;
+    if (++_next < _count) return false;
+    _playing = false;
+    _msReplay = (usDone - _usPlay) / 1000;
+    return true;
+}
+
+/**
+ * Microseconds until the next event is due, -1 if there is no replay
+ */
+int32_t TouchTrace::usUntilNext()
+{
+    if (! _playing) return -1;
+    if (_fast) return 0;
+    int64_t us = _usPlay + _events[_next].ms * 1000LL - esp_timer_get_time();
+    return us < 0 ? 0 : us;
+}
+
+/**
+ * Milliseconds of the event being replayed, counted like millis().
+ * millis() when there is no replay.
+ */
+uint32_t TouchTrace::msClock()
+{
+    if (! _playing) return millis();
+    return (uint32_t)(_usPlay / 1000) + _events[_next].ms;
+}
+
+/**
+ * Latency of every event of the last replay
+ */
+void TouchTrace::printReport()
+{
+    int touches = 0;
+    uint32_t usMaxLate = 0, usMaxHandler = 0;
+    uint64_t usHandler = 0;
+    Serial.printf(R"(
+Touch replay
+------------
+  #       ms     x    y   late us  handler us
+)");
+    for (int i = 0; i < _next; i++)
+    {
+        const Event &e = _events[i];
+        if (e.x < 0)
+            Serial.printf("%3d %8u      UP  %8u\n", i, e.ms, _usLate[i]);
+        else
+            Serial.printf("%3d %8u  %4d %4d  %8u  %10u\n", i, e.ms, e.x, e.y, _usLate[i], _usHandler[i]);
+        touches += e.x >= 0;
+        usMaxLate = std::max(usMaxLate, _usLate[i]);
+        usMaxHandler = std::max(usMaxHandler, _usHandler[i]);
+        usHandler += _usHandler[i];
+    }
+    Serial.printf(R"(events     %6d of %d, %d touches
+speed      %6s
+duration   %6u ms, recorded %u ms
+late       %6u us max
+handler    %6u us max, %u us avg
+recording  %6u events written
+)", _next, _count, touches, _fast ? "fast" : "real", _msReplay, _count > 0 ? _events[_count - 1].ms : 0,
+    usMaxLate, usMaxHandler, touches > 0 ? (uint32_t)(usHandler / touches) : 0, _recorded);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <Arduino.h>
+#include "SdWriter.h"
+
+/**
+ * Class        TouchTrace
+ *
+ * Purpose      Records the touches of the screen with their time and replays
+ *              them into the touch handler of loop(), so a UI session can be
+ *              repeated exactly, on the board and in the simulator.
+ *              A trace is a list of events, one per line of text:
+ *              <ms> <x> <y>    the screen was touched at x, y (one per touch poll)
+ *              <ms> UP         the finger was lifted
+ *              ms counts from the start of the recording. The recording goes
+ *              to a file on the SD card or to the serial port, there as TOUCH
+ *              commands that add the events to the replay list when they are
+ *              sent back.
+ *              The replay passes each event to the handler, a lift as -1, -1,
+ *              at its time (real speed) or right after the previous one
+ *              (fast) and measures its latency: how late it was passed on
+ *              and how long the handler took. msClock() is the time of the event being replayed, so
+ *              time dependent decisions of the UI (key repeat) come out the
+ *              same at both speeds.
+ *
+ * Usage        TouchTrace trace(handleTouch);
+ *              trace.record(Serial);               // or trace.record("/touch.trc")
+ *              in the touch poll: trace.sample(touched, x, y);
+ *              trace.stop();
+ *
+ *              trace.add("120 100 60");            // or trace.load("/touch.trc")
+ *              trace.play(fast);
+ *              loop: if (trace.loop()) trace.printReport();
+ */
+class TouchTrace
+{
+    public:
+        using Handler = void(*)(int x, int y);
+        static const int maxEvents = 256;
+
+        struct Event
+        {
+            uint32_t ms;    // since the start of the recording
+            int16_t x, y;   // x < 0: released
+        };
+
+        TouchTrace(Handler handler) : _handler(handler) {}
+
+        bool record(Print &out);
+        bool record(const char *path);
+        void sample(bool touched, int x, int y);
+        void stop();
+        bool isRecording() { return _out != nullptr || _writer.isOpen(); }
+
+        void clear();
+        bool add(const char *line);
+        bool load(const char *path);
+        bool play(bool fast);
+        bool isPlaying() { return _playing; }
+        bool loop();
+        int32_t usUntilNext();
+        uint32_t msClock();
+        void printReport();
+
+    private:
+        void write(const Event &e);
+
+        Handler _handler;
+        Event _events[maxEvents];
+        int _count = 0;
+
+        Print *_out = nullptr;      // recording to the serial port
+        SdWriter _writer { SdWriter::sectorSize };  // or to the SD card
+        uint32_t _msRecord = 0;     // start of the recording
+        bool _pressed = false;
+        uint32_t _recorded = 0;
+
+        bool _playing = false;
+        bool _fast = false;
+        int _next = 0;              // next event to replay
+        int64_t _usPlay = 0;        // start of the replay
+        uint32_t _msReplay = 0;     // duration of the last replay
+        uint32_t _usLate[maxEvents];     // due to passed on
+        uint32_t _usHandler[maxEvents];  // time in the handler
+};
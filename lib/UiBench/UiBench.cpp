@@ -0,0 +1,135 @@
+#include "UiBench.h"
+#include "SdWriter.h"
+
+/**
+ * Add a scenario. prepare() runs before it and is not measured, e.g. to
+ * draw what the scenario changes.
+ */
+bool UiBench::add(const char *name, Scenario run, Scenario prepare)
+{
+    if (_count >= maxScenarios)
+    {
+        log_e("==> no room for scenario %s", name);
+        return false;
+    }
+    _scenarios[_count++] = { name, run, prepare };
+    return true;
+}
+
+/**
+ * Run all scenarios in the order they were added and compare them with the
+ * budgets of the same name. Returns the number of failed scenarios,
+ * getChecked() how many had a budget.
+ */
+int UiBench::run(const UiBudget *budgets, int count)
+{
+    int failed = 0;
+    _checked = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        Entry &s = _scenarios[i];
+        Result &r = _results[i];
+        if (s.prepare) s.prepare();
+        _lcd.waitDMA();
+
+        BusCounters before = _lcd.getBusCounters();
+        uint32_t usStart = micros();
+        s.run();
+        _lcd.waitDMA();  // until the last pixel left
+        r.usWall = micros() - usStart;
+        BusCounters after = _lcd.getBusCounters();
+
+        r.name = s.name;
+        r.bus.transactions = after.transactions - before.transactions;
+        r.bus.windows      = after.windows - before.windows;
+        r.bus.pixels       = after.pixels - before.pixels;
+        r.bus.bytesWritten = after.bytesWritten - before.bytesWritten;
+        r.bus.bytesRead    = after.bytesRead - before.bytesRead;
+        r.budget = nullptr;
+        for (int b = 0; b < count; b++)
+        {
+            const UiBudget &budget = budgets[b];
+            bool limited = budget.usWall || budget.calls || budget.bytesWritten;
+            if (limited && strcmp(budget.scenario, s.name) == 0) r.budget = &budget;
+        }
+        if (r.budget) _checked++;
+        if (! check(r)) failed++;
+    }
+    _measured = _count;
+    return failed;
+}
+
+bool UiBench::check(Result &r)
+{
+    const UiBudget *b = r.budget;
+    r.passed = b == nullptr ||
+        ((b->usWall == 0 || r.usWall <= b->usWall) &&
+         (b->calls == 0 || r.bus.transactions <= b->calls) &&
+         (b->bytesWritten == 0 || r.bus.bytesWritten <= b->bytesWritten));
+    return r.passed;
+}
+
+/**
+ * Table of the last run. A scenario over its budget is marked FAIL and
+ * followed by the limits.
+ */
+void UiBench::printResults()
+{
+    Serial.printf(R"(
+UI benchmark
+------------
+scenario              ms   calls  windows   pixels  kB sent  kB read  budget
+)");
+    for (int i = 0; i < _measured; i++)
+    {
+        Result &r = _results[i];
+        Serial.printf("%-16s %7.2f %7u %8u %8u %8.1f %8.1f  %s\n", r.name, r.usWall / 1000.0,
+            r.bus.transactions, r.bus.windows, r.bus.pixels, r.bus.bytesWritten / 1024.0,
+            r.bus.bytesRead / 1024.0, r.budget == nullptr ? "-" : r.passed ? "ok" : "FAIL");
+        if (! r.passed)
+        {
+            Serial.printf("  limits          %7.2f %7u %17s %8.1f\n", r.budget->usWall / 1000.0,
+                r.budget->calls, "", r.budget->bytesWritten / 1024.0);
+        }
+    }
+}
+
+int UiBench::formatCsv(char *buf, size_t size, const Result &r)
+{
+    const UiBudget none = { "", 0, 0, 0 };
+    const UiBudget *b = r.budget ? r.budget : &none;
+    return snprintf(buf, size, "%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%s\n", r.name, r.usWall,
+        r.bus.transactions, r.bus.windows, r.bus.pixels, r.bus.bytesWritten, r.bus.bytesRead,
+        b->usWall, b->calls, b->bytesWritten, r.budget == nullptr ? "none" : r.passed ? "pass" : "fail");
+}
+
+static const char csvHeader[] =
+    "scenario,us,calls,windows,pixels,bytes_written,bytes_read,budget_us,budget_calls,budget_bytes,result\n";
+
+/**
+ * The last run as CSV, one line per scenario
+ */
+void UiBench::printCsv(Print &out)
+{
+    char line[160];
+    out.print(csvHeader);
+    for (int i = 0; i < _measured; i++)
+    {
+        formatCsv(line, sizeof(line), _results[i]);
+        out.print(line);
+    }
+}
+
+bool UiBench::saveCsv(const char *path)
+{
+    char line[160];
+    SdWriter writer(SdWriter::sectorSize);
+    if (! writer.open(path)) return false;
+    writer.write((const uint8_t *)csvHeader, strlen(csvHeader));
+    for (int i = 0; i < _measured; i++)
+    {
+        int n = formatCsv(line, sizeof(line), _results[i]);
+        writer.write((const uint8_t *)line, n);
+    }
+    return writer.close();
+}
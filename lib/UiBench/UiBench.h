@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+
+/**
+ * Class        UiBench
+ *
+ * Purpose      Runs UI scenarios one after the other and measures each of
+ *              them: the wall time and the traffic to the ILI9341, i.e. the
+ *              drawing calls, address windows, pixels and bytes of the
+ *              BusCounters of the board file. On the host the simulator
+ *              counts the same and models the SPI time.
+ *              Every result is compared with the budget of the scenario; a
+ *              scenario over one of its limits fails. A limit of 0 is not
+ *              checked, a budget with all limits 0 counts as none. The results can be printed as a table or as CSV and
+ *              saved on the SD card.
+ *
+ * Usage        UiBench bench(lcd);
+ *              bench.add("keypad open", openKeypad);
+ *              bench.add("slider drag", dragSlider, drawSlider);  // drawSlider() is not measured
+ *              int failed = bench.run(uiBudgets, uiBudgetCount);
+ *              if (bench.getChecked() == 0) ...;  // no budgets, nothing was compared
+ *              bench.printResults();
+ *              bench.printCsv(Serial);
+ *              bench.saveCsv("/uibench.csv");
+ */
+struct UiBudget
+{
+    const char *scenario;
+    uint32_t usWall;        // limits, 0 = not checked
+    uint32_t calls;
+    uint32_t bytesWritten;
+};
+
+class UiBench
+{
+    public:
+        using Scenario = void(*)();
+        static const int maxScenarios = 8;
+
+        struct Result
+        {
+            const char *name;
+            uint32_t usWall;
+            BusCounters bus;            // traffic of the scenario
+            const UiBudget *budget;     // nullptr if the scenario has none
+            bool passed;
+        };
+
+        UiBench(LGFX &lcd) : _lcd(lcd) {}
+
+        bool add(const char *name, Scenario run, Scenario prepare=nullptr);
+        int  run(const UiBudget *budgets=nullptr, int count=0);
+        void printResults();
+        void printCsv(Print &out);
+        bool saveCsv(const char *path);
+        int  getResults(const Result *&results) { results = _results; return _measured; }
+        int  getChecked() { return _checked; }
+
+    private:
+        struct Entry
+        {
+            const char *name;
+            Scenario run;
+            Scenario prepare;
+        };
+
+        bool check(Result &r);
+        int  formatCsv(char *buf, size_t size, const Result &r);
+
+        LGFX &_lcd;
+        Entry _scenarios[maxScenarios];
+        Result _results[maxScenarios];
+        int _count = 0;
+        int _measured = 0;   // scenarios of the last run()
+        int _checked = 0;    // of them with a budget
+};
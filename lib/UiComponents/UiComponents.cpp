@@ -1,4 +1,5 @@
 #include "UiComponents.h"
+#include "UiGlyphs.h"
 
 
 double fmap(double x, double in_min, double in_max, double out_min, double out_max)
@@ -11,26 +12,47 @@ double fmap(double x, double in_min, double in_max, double out_min, double out_m
 UiTheme blueTheme(TFT_BLACK, 0x07df,     0x03df, 0x01ca, &fonts::DejaVu12);
 UiTheme defaultTheme;
 
+uint32_t (*UiPanel::_msKeyClock)() = nullptr;
+bool UiPanel::_waitRelease = false;
+UiButton *UiPanel::_dragged = nullptr;
+UiPanel *UiPanel::_dragPanel = nullptr;
+UiHitGrid UiPanel::_hitGrid;
+UiRenderer UiPanel::renderer;
+UiPanel *UiPanel::_captures[UiPanel::_maxCaptures];
+constexpr int UiPanel::_bandRows;
+
 
 void UiButton::draw()
 {
-    _lcd.drawRoundRect(_x+2, _y+2, _w, _h, _r, _theme._shadowColor);
-    _lcd.drawRoundRect(_x+1, _y+1, _w, _h, _r, _theme._shadowColor);
-    _lcd.fillRoundRect(_x, _y, _w, _h, _r, _theme._borderColor);
-    _lcd.fillRoundRect(_x+2, _y+2, _w-4, _h-4, _r, _theme._bodyColor);
-    _lcd.setTextDatum(textdatum_t::middle_center);
-    _lcd.setTextColor(_theme._textColor, _theme._bodyColor);
-    _lcd.setFont(_theme._font);
-    _lcd.drawString(_value, _x+_w/2, _y+2+_h/2);
-    _lcd.setTextDatum(textdatum_t::middle_left);
-    _lcd.setTextColor(_theme._textColor, _parent->getPanelColor());
-    _lcd.drawString(_label, _x+_w+_d, _y+2+_h/2);
-    
+    _lcd.drawRoundRect(_x()+2, _y()+2, _w(), _h(), _r, _theme._shadowColor);
+    _lcd.drawRoundRect(_x()+1, _y()+1, _w(), _h(), _r, _theme._shadowColor);
+    _lcd.fillRoundRect(_x(), _y(), _w(), _h(), _r, _theme._borderColor);
+    _lcd.fillRoundRect(_x()+2, _y()+2, _w()-4, _h()-4, _r, _theme._bodyColor);
+    uiGlyphs.drawString(_lcd, _value.c_str(), _x()+_w()/2, _y()+2+_h()/2, textdatum_t::middle_center, 
+                        _theme._font, _theme._textColor, _theme._bodyColor);
+    uiGlyphs.drawString(_lcd, _label, _x()+_w()+_d, _y()+2+_h()/2, textdatum_t::middle_left, 
+                        _theme._font, _theme._textColor, _parent->getPanelColor());
 }
 
 bool UiButton::touched(int x, int y)
 {
-    return (x > _x && x < _x+_w && y > _y && y < _y+_h);
+    return (x > _x() && x < _x()+_w() && y > _y() && y < _y()+_h());
+}
+
+// Screen area in which touched() can be true
+void UiButton::getBounds(int &x, int &y, int &w, int &h)
+{
+    x = _x();
+    y = _y();
+    w = _w();
+    h = _h();
+}
+
+// Screen position that touches the button, e.g. to replay a key press
+void UiButton::getCenter(int &x, int &y)
+{
+    x = _x() + _w()/2;
+    y = _y() + _h()/2;
 }
 
 void UiButton::clearValue()
@@ -39,6 +61,12 @@ void UiButton::clearValue()
     draw();
 }
 
+// Set the value without drawing, e.g. to change several fields before one redraw
+void UiButton::setValue(String value)
+{
+    _value = value;
+}
+
 String UiButton::getValue() 
 {
     return _value;
@@ -67,7 +95,7 @@ String UiButton::getLabel()
 
 bool UiButton::rangeIsInteger() 
 { 
-    return _rangeIsInteger; 
+    return _def->integer; 
 }
 
 bool UiButton::hasSlider() 
@@ -90,10 +118,10 @@ void UiButton::updateValue(String value)
 void UiButton::updateValue(int value)
 {
     char buf[24];
-    if (_minInt!=0 || _maxInt!=0) // a range is set
+    if (_def->min != 0 || _def->max != 0) // a range is set
     {
-        if (value < _minInt) value = _minInt;  // limit the value to the range
-        if (value > _maxInt) value = _maxInt;
+        if (value < _def->min) value = (int)_def->min;  // limit the value to the range
+        if (value > _def->max) value = (int)_def->max;
     }
     snprintf(buf, sizeof(buf), "%d", value);
     _value = buf;
@@ -104,10 +132,10 @@ void UiButton::updateValue(int value)
 void UiButton::updateValue(double value)
 {
     char buf[24];
-    if (_minDouble!=0.0 || _maxDouble!=0.0) // a range is set
+    if (_def->min != 0.0 || _def->max != 0.0) // a range is set
     {
-        if (value < _minDouble) value = _minDouble; // limit the value to the range
-        if (value > _maxDouble) value = _maxDouble;
+        if (value < _def->min) value = _def->min; // limit the value to the range
+        if (value > _def->max) value = _def->max;
     }
     snprintf(buf, sizeof(buf), "%.10g", value);
     _value = buf;
@@ -115,35 +143,19 @@ void UiButton::updateValue(double value)
     draw();
 }
 
-void UiButton::setLabel(String label)
+void UiButton::setLabel(const char *label, bool redraw)
 {
     _label = label;
-    draw(); //_lcd.drawString(_label, _x+_w+_d, _y+2+_h/2);
+    if (redraw) draw(); //_lcd.drawString(_label, _x()+_w()+_d, _y()+2+_h()/2);
 }
 
 void UiButton::clearLabel()
 {
     _lcd.setTextColor(_lcd.getBaseColor());
-    _lcd.drawString(_label, _x+_w+_d, _y+2+_h/2);
+    _lcd.drawString(_label, _x()+_w()+_d, _y()+2+_h()/2);
     _lcd.setTextColor(_theme._textColor); 
 }
 
-void UiButton:: setRange(int min, int max)
-{
-    //log_i("Button setRange int %p", this);
-    _minInt = min;
-    _maxInt = max;
-    _rangeIsInteger = true;
-}
-
-void UiButton:: setRange(double min, double max)
-{
-    //log_i("Button setRange double %p", this);
-    _minDouble = min;
-    _maxDouble = max;
-    _rangeIsInteger = false;
-}
-
 void UiButton::addSlider(UiButton *btn)
 {
     _pSlider = btn;
@@ -153,24 +165,42 @@ void UiButton::addSlider(UiButton *btn)
 
 void UiLed::draw()
 {
-    _lcd.fillCircle(_x+2, _y+2, _radius, _theme._shadowColor);
-    _lcd.fillCircle(_x, _y, _radius, _theme._borderColor);
-    _isOn ? _lcd.fillCircle(_x, _y, _radius-2, _color) : _lcd.fillCircle(_x, _y, _radius-2, _theme._bodyColor);
-    _lcd.setTextDatum(textdatum_t::middle_left);
-    _lcd.setTextColor(_theme._textColor);
-    _lcd.setFont(_theme._font);
-    _lcd.drawString(_label, _x+_radius*2+_d, _y);
+    _lcd.fillCircle(_x()+2, _y()+2, _radius(), _theme._shadowColor);
+    _lcd.fillCircle(_x(), _y(), _radius(), _theme._borderColor);
+    _isOn ? _lcd.fillCircle(_x(), _y(), _radius()-2, _def->color) : _lcd.fillCircle(_x(), _y(), _radius()-2, _theme._bodyColor);
+    uiGlyphs.drawString(_lcd, _label, _x()+_radius()*2+_d, _y(), textdatum_t::middle_left, 
+                        _theme._font, _theme._textColor, _parent->getPanelColor());
 }
 
 bool UiLed::touched(int x, int y)
 {
-    return (x > _x-_radius && x < _x+_radius && y > _y-_radius && y < _y+_radius);
+    return (x > _x()-_radius() && x < _x()+_radius() && y > _y()-_radius() && y < _y()+_radius());
+}
+
+void UiLed::getCenter(int &x, int &y)
+{
+    x = _x();
+    y = _y();
+}
+
+void UiLed::getBounds(int &x, int &y, int &w, int &h)
+{
+    x = _x() - _radius();
+    y = _y() - _radius();
+    w = 2 * _radius();
+    h = 2 * _radius();
 }
 
-void UiLed::setLabel(String txt)
+void UiLed::setLabel(const char *txt, bool redraw)
 {
+    if (redraw)  // the label is drawn with background, erase what a shorter one does not cover
+    {
+        _lcd.setFont(_theme._font);
+        int w = _lcd.textWidth(txt), wOld = _lcd.textWidth(_label), h = _lcd.fontHeight();
+        if (wOld > w) _lcd.fillRect(_x()+_radius()*2+_d+w, _y()-h/2, wOld-w, h, _parent->getPanelColor());
+    }
     _label = txt;
-    draw();     
+    if (redraw) draw();     
 }
 
 bool UiLed::isOn()
@@ -178,11 +208,17 @@ bool UiLed::isOn()
     return _isOn;
 }
 
+// Set the state without drawing
+void UiLed::setOn(bool isOn)
+{
+    _isOn = isOn;
+}
+
 void UiLed::on()
 {
     if (! _isOn)
     {
-        _lcd.fillCircle(_x, _y, _radius-2, _color);
+        _lcd.fillCircle(_x(), _y(), _radius()-2, _def->color);
         _isOn = true;
     }
 }  
@@ -191,7 +227,7 @@ void UiLed::off()
 {
     if (_isOn)
     {
-        _lcd.fillCircle(_x, _y, _radius-2, _theme._bodyColor);
+        _lcd.fillCircle(_x(), _y(), _radius()-2, _theme._bodyColor);
         _isOn = false;
     }
 } 
@@ -200,12 +236,12 @@ void UiLed::toggle()
 {
     if (_isOn)
     {
-        _lcd.fillCircle(_x, _y, _radius-2, _theme._bodyColor);
+        _lcd.fillCircle(_x(), _y(), _radius()-2, _theme._bodyColor);
         _isOn = false;
     }
     else
     {
-        _lcd.fillCircle(_x, _y, _radius-2, _color);
+        _lcd.fillCircle(_x(), _y(), _radius()-2, _def->color);
         _isOn = true;
     }
 }
@@ -214,56 +250,123 @@ void UiLed::toggle()
 
 void UiHslider::draw()
 {
-    _lcd.drawRoundRect(_x+2, _y+2, _w, _h, _r, _theme._shadowColor);
-    _lcd.drawRoundRect(_x+1, _y+1, _w, _h, _r, _theme._shadowColor);
-    _lcd.fillRoundRect(_x, _y, _w, _h, _r, _theme._borderColor);
-    _lcd.fillRoundRect(_x+2, _y+2, _w-4, _h-4, _r, _theme._bodyColor);
-    _lcd.fillCircle(_position, _y+_h/2, _rb, _color);
-    _lcd.drawCircle(_position, _y+_h/2, _rb, _theme._borderColor);
-    _lcd.setTextDatum(textdatum_t::middle_left);
-    _lcd.setTextColor(_theme._textColor, _parent->getPanelColor());
-    _lcd.setFont(_theme._font);
-    _lcd.drawString(_label, _x+_w+_d, _y+2+_h/2);    
+    drawTrack();
+    _lcd.fillCircle(_position, _y()+_h()/2, _rb(), _def->color);
+    _lcd.drawCircle(_position, _y()+_h()/2, _rb(), _theme._borderColor);
+    uiGlyphs.drawString(_lcd, _label, _x()+_w()+_d, _y()+2+_h()/2, textdatum_t::middle_left, 
+                        _theme._font, _theme._textColor, _parent->getPanelColor());
 }
 
-void UiHslider::slideToPosition(int x)
+void UiHslider::drawTrack()
+{
+    _lcd.drawRoundRect(_x()+2, _y()+2, _w(), _h(), _r, _theme._shadowColor);
+    _lcd.drawRoundRect(_x()+1, _y()+1, _w(), _h(), _r, _theme._shadowColor);
+    _lcd.fillRoundRect(_x(), _y(), _w(), _h(), _r, _theme._borderColor);
+    _lcd.fillRoundRect(_x()+2, _y()+2, _w()-4, _h()-4, _r, _theme._bodyColor);
+}
+
+// the knob reaches beyond the track, a finger on it counts
+bool UiHslider::touched(int x, int y)
+{
+    int bx, by, bw, bh;
+    getBounds(bx, by, bw, bh);
+    return x > bx && x < bx+bw && y > by && y < by+bh;
+}
+
+void UiHslider::getBounds(int &x, int &y, int &w, int &h)
 {
-    _lcd.fillCircle(_position, _y+_h/2, _h, _parent->getPanelColor());
+    x = _x() - _rb();
+    y = _y() + _h()/2 - _rb();
+    w = _w() + 2*_rb();
+    h = 2*_rb();
+}
+
+/**
+ * Follow the finger, x < 0: it was lifted. The touch handler is called
+ * when the knob moved, and when the finger is lifted after it moved.
+ */
+bool UiHslider::drag(int x, int y)
+{
+    if (x < 0)
+    {
+        _dragging = false;
+        if (_moved) handleTouch();
+        return true;
+    }
+    if (! _dragging) _moved = false;
+    _dragging = true;
+    int from = _position;
+    slideToPosition(x);
+    if (_position == from) return true;
+    _moved = true;
+    handleTouch();
+    return true;
+}
+
+/**
+ * Redraw the columns of the knob at the old and the new position: the
+ * panel above and below the track, the track as flat rows, then the knob.
+ * Near the rounded ends the old knob is erased and the track drawn whole.
+ */
+void UiHslider::moveKnob(int x)
+{
+    int from = _position, cy = _y()+_h()/2, rb = _rb();
+    int x0 = std::min(from, x) - rb - 1, x1 = std::max(from, x) + rb + 2;
     _position = x;
-    if (rangeIsInteger())
+    if (x0 < _x()+_r+2 || x1 > _x()+_w()-_r)
     {
-        int v = map(_position-_x, 0, _w-2*_r, _minInt, _maxInt);
-        getValueField()->updateValue(v);
-        //log_i("Int x=%d, _w=%d, v=%d, min=%d, max=%d", x, _w, v, _minInt, _maxInt);
+        _lcd.fillCircle(from, cy, _h(), _parent->getPanelColor());
+        drawTrack();
     }
     else
     {
-        double v = fmap(_position-_x, 0.0, _w-2*_r, _minDouble, _maxDouble);
-        getValueField()->updateValue(v);
-        //log_i("Double x=%d, w=%d, v=%.10g, min=%.10g, max=%.10g", x, _w, v, _minDouble, _maxDouble);
+        int top = cy-rb-1, bottom = cy+rb+2;
+        _lcd.fillRect(x0, top, x1-x0, _y()-top, _parent->getPanelColor());
+        _lcd.fillRect(x0, _y(), x1-x0, _h(), _theme._borderColor);
+        _lcd.fillRect(x0, _y()+2, x1-x0, _h()-4, _theme._bodyColor);
+        _lcd.fillRect(x0, _y()+_h(), x1-x0, 2, _theme._shadowColor);
+        _lcd.fillRect(x0, _y()+_h()+2, x1-x0, bottom-_y()-_h()-2, _parent->getPanelColor());
     }
-    
-    draw(); 
+    _lcd.fillCircle(_position, cy, rb, _def->color);
+    _lcd.drawCircle(_position, cy, rb, _theme._borderColor);
 }
 
-void UiHslider::slideToValue(int v)
+/**
+ * Move the knob to x, within the track. The value field is only drawn 
+ * when its text changes.
+ */
+void UiHslider::slideToPosition(int x)
 {
-    _lcd.fillCircle(_position, _y+_h/2, _h, _parent->getPanelColor());
-    _position = map(v, _minInt, _maxInt, 0, _w-2*_r) + _x;
-    _pValueField->updateValue(v);
+    char buf[24];
+    x = constrain(x, _x(), _x()+_w()-2*_r);
+    if (rangeIsInteger())
+        snprintf(buf, sizeof(buf), "%d", (int)map(x-_x(), 0, _w()-2*_r, (int)_def->min, (int)_def->max));
+    else
+        snprintf(buf, sizeof(buf), "%.4g", fmap(x-_x(), 0.0, _w()-2*_r, _def->min, _def->max));
+    if (x != _position) moveKnob(x);
+    if (_value == buf) return;
+    _value = buf;
+    if (_pValueField) _pValueField->updateValue(_value);
+}
+
+void UiHslider::slideToValue(int v, bool redraw)
+{
+    int x = map(constrain(v, (int)_def->min, (int)_def->max), (int)_def->min, (int)_def->max, 0, _w()-2*_r) + _x();
     _value = String(v);
-    draw(); 
+    if (_pValueField) redraw ? _pValueField->updateValue(v) : _pValueField->setValue(_value);
+    if (redraw && x != _position) moveKnob(x);
+    else _position = x;
 }
 
-void UiHslider::slideToValue(double v)
+void UiHslider::slideToValue(double v, bool redraw)
 {
-    _lcd.fillCircle(_position, _y+_h/2, _h, _parent->getPanelColor());
-    _position = fmap(v, _minDouble, _maxDouble, 0, _w) + _x;
+    int x = fmap(constrain(v, _def->min, _def->max), _def->min, _def->max, 0, _w()-2*_r) + _x();
     char buf[24];
     snprintf(buf,sizeof(buf), "%.4g", v);
-    _pValueField->updateValue(buf);
     _value = buf;
-    draw(); 
+    if (_pValueField) redraw ? _pValueField->updateValue(_value) : _pValueField->setValue(_value);
+    if (redraw && x != _position) moveKnob(x);
+    else _position = x;
 }
 
 void UiHslider::addValueField(UiButton *btn)
@@ -283,25 +386,323 @@ UiButton *UiHslider::getValueField()
     return _pValueField; 
 }
 
-void UiHslider::setRange(int min, int max)
+// ---UiHslider ---
+
+
+// --- UiHitGrid ---
+int UiHitGrid::rank(const Entry &e)
 {
-    //log_i("Slider setRange int vf %p", _pValueField);
-    if (_pValueField) _pValueField->setRange(min, max);
-    UiButton::setRange(min, max);
+    return 2 * e.panel->_layer + (e.btn != nullptr);
 }
-void UiHslider::setRange(double min, double max)
+
+/**
+ * Add an entry to all cells its area overlaps, behind the entries of the
+ * same rank
+ */
+bool UiHitGrid::add(const Entry &e, int x, int y, int w, int h)
 {
-    //log_i("Slider setRange double vf %p", _pValueField);
-    if (_pValueField) _pValueField->setRange(min, max);
-    UiButton::setRange(min, max);
+    int c0 = std::max(x / cellSize, 0), c1 = std::min((x + w - 1) / cellSize, cols - 1);
+    int r0 = std::max(y / cellSize, 0), r1 = std::min((y + h - 1) / cellSize, rows - 1);
+    bool room = _count < maxEntries;
+    for (int r = r0; room && r <= r1; r++)
+    {
+        for (int c = c0; c <= c1; c++) room = room && _cellCount[r * cols + c] < maxPerCell;
+    }
+    if (! room)
+    {
+        log_e("==> hit grid full at %d, %d", x, y);
+        return false;
+    }
+    int index = _count;
+    _entries[_count++] = e;
+    for (int r = r0; r <= r1; r++)
+    {
+        for (int c = c0; c <= c1; c++)
+        {
+            uint8_t *cell = _cells[r * cols + c];
+            int n = _cellCount[r * cols + c]++;
+            int i = n;
+            while (i > 0 && rank(_entries[cell[i - 1]]) < rank(e)) 
+            {
+                cell[i] = cell[i - 1];
+                i--;
+            }
+            cell[i] = index;
+        }
+    }
+    return true;
 }
-// ---UiHslider ---
+
+/**
+ * The entries of the cell at x, y, top-most first. Returns their number.
+ */
+int UiHitGrid::at(int x, int y, const Entry *list[maxPerCell])
+{
+    if (x < 0 || y < 0 || x >= cols * cellSize || y >= rows * cellSize) return 0;
+    int cell = (y / cellSize) * cols + x / cellSize;
+    for (int i = 0; i < _cellCount[cell]; i++) list[i] = &_entries[_cells[cell][i]];
+    return _cellCount[cell];
+}
+/**
+ * Remove all entries of a panel. The remaining ones keep their order.
+ */
+void UiHitGrid::remove(const UiPanel *panel)
+{
+    uint8_t moved[maxEntries];  // new index of each entry
+    int n = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        moved[i] = _entries[i].panel == panel ? 0xff : n;
+        if (moved[i] != 0xff) _entries[n++] = _entries[i];
+    }
+    _count = n;
+    for (int c = 0; c < cols * rows; c++)
+    {
+        int k = 0;
+        for (int i = 0; i < _cellCount[c]; i++)
+        {
+            if (moved[_cells[c][i]] != 0xff) _cells[c][k++] = moved[_cells[c][i]];
+        }
+        _cellCount[c] = k;
+    }
+}
+// --- UiHitGrid ---
 
 
+// --- UiRenderer ---
+/**
+ * Queue a repaint of the panel. A panel in the queue starts over.
+ */
+void UiRenderer::add(UiPanel *panel)
+{
+    for (int i = 0; i < _count; i++)
+    {
+        if (_items[i].panel == panel) 
+        {
+            _items[i].next = 0;
+            return;
+        }
+    }
+    if (_count == maxPanels)
+    {
+        log_e("==> draw queue full");
+        flush();
+    }
+    if (_count == 0) _usFrameStart = micros();
+    _items[_count++] = { panel, 0 };
+}
+
+void UiRenderer::remove(UiPanel *panel)
+{
+    int n = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        if (_items[i].panel != panel) _items[n++] = _items[i];
+    }
+    _count = n;
+}
+
+/**
+ * Draw the next part of the first panel in the queue. Hidden panels are 
+ * skipped. Returns false when the queue became empty.
+ */
+bool UiRenderer::drawNext()
+{
+    Item &item = _items[0];
+    if (! item.panel->isHidden() && item.next < item.panel->parts()) item.panel->drawPart(item.next++);
+    if (item.panel->isHidden() || item.next >= item.panel->parts())
+    {
+        for (int i = 1; i < _count; i++) _items[i - 1] = _items[i];
+        _count--;
+    }
+    if (_count > 0) return true;
+    _stats.frames++;
+    _stats.usLastFrame = micros() - _usFrameStart;
+    _stats.usMaxFrame = std::max(_stats.usMaxFrame, _stats.usLastFrame);
+    _stats.usTotalFrame += _stats.usLastFrame;
+    return false;
+}
+
+/**
+ * Draw parts until usBudget is spent or input is waiting, at least one. 
+ * Returns true if there is more to draw.
+ */
+bool UiRenderer::run(uint32_t usBudget)
+{
+    if (_count == 0) return false;
+    uint32_t usStart = micros();
+    bool more;
+    do
+    {
+        more = drawNext();
+    } while (more && micros() - usStart < usBudget && ! (_preempt && _preempt()));
+    _stats.slices++;
+    _stats.usMaxSlice = std::max(_stats.usMaxSlice, micros() - usStart);
+    if (more && micros() - usStart < usBudget) _stats.preempted++;
+    return more;
+}
+
+/**
+ * Draw everything queued now
+ */
+void UiRenderer::flush()
+{
+    while (_count > 0 && drawNext()) {}
+}
+
+/**
+ * Called by the touch poll while a frame is drawn: touched, and the number
+ * of polls the scheduler skipped since the last one
+ */
+void UiRenderer::countInput(bool touched, uint32_t missed)
+{
+    _stats.touches += touched;
+    _stats.missed += missed;
+}
+
+void UiRenderer::printStats(uint32_t usBudget)
+{
+    const Stats &s = _stats;
+    Serial.printf(R"(
+UI renderer
+-----------
+frames     %6u, %s
+frame ms   %9.2f last, %.2f max, %.2f avg
+slices     %6u, %u preempted by input
+slice us   %6u budget, %u max
+touches    %6u handled during frames, %u polls missed
+)", s.frames, _count > 0 ? "drawing" : "idle", s.usLastFrame / 1000.0, s.usMaxFrame / 1000.0, 
+    s.frames > 0 ? s.usTotalFrame / 1000.0 / s.frames : 0.0, s.slices, s.preempted, usBudget, 
+    s.usMaxSlice, s.touches, s.missed);
+}
+// --- UiRenderer ---
+
+
+/**
+ * A deleted panel leaves the hit grid and gives up the touch capture
+ */
+UiPanel::~UiPanel()
+{
+    if (_dragPanel == this) { _dragged = nullptr; _dragPanel = nullptr; }
+    if (_indexed) _hitGrid.remove(this);
+    setCapture(false);
+    renderer.remove(this);
+}
+
+/**
+ * Pass a touch to the handler of the top-most shown widget under it. 
+ * A shown panel covers the layers below, also where it has no widget. 
+ * While a capturing panel is shown, touches outside of it are dropped.
+ * A widget that follows the finger gets all touches until it is lifted,
+ * without key repeat, also beside the widget. x < 0 tells that the finger 
+ * was lifted. Returns true if a widget was touched.
+ */
+bool UiPanel::touch(int x, int y)
+{
+    if (_dragged && (x < 0 || _dragPanel->_hidden))  // lifted, or the panel was left
+    {
+        UiButton *btn = _dragged;
+        _dragged = nullptr;
+        _dragPanel = nullptr;
+        btn->drag(-1, -1);
+        if (x >= 0) _waitRelease = true;
+    }
+    if (x < 0) _waitRelease = false;
+    if (x < 0 || _waitRelease) return false;
+    if (_dragged)
+    {
+        _dragged->drag(x, y);
+        return true;
+    }
+    for (UiPanel *p : _captures)
+    {
+        if (p && ! p->_hidden && ! p->contains(x, y)) return false;
+    }
+    const UiHitGrid::Entry *list[UiHitGrid::maxPerCell];
+    int n = _hitGrid.at(x, y, list);
+    for (int i = 0; i < n; i++)
+    {
+        const UiHitGrid::Entry &e = *list[i];
+        if (e.panel->_hidden) continue;
+        if (e.btn == nullptr)
+        {
+            if (e.panel->contains(x, y)) return false;  // on the background
+            continue;
+        }
+        if (! e.btn->touched(x, y)) continue;
+        if (e.btn->drag(x, y))
+        {
+            _dragged = e.btn;
+            _dragPanel = e.panel;
+            return true;
+        }
+        if (acceptKey(e.btn, e.panel->_msRepeat)) e.btn->handleTouch();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * A capturing panel takes all touches while it is shown, e.g. an overlay
+ * that must be closed before the panels below can be used again
+ */
+void UiPanel::setCapture(bool capture)
+{
+    int free = -1;
+    for (int i = 0; i < _maxCaptures; i++)
+    {
+        if (_captures[i] == this) 
+        {
+            if (! capture) _captures[i] = nullptr;
+            return;
+        }
+        if (_captures[i] == nullptr && free < 0) free = i;
+    }
+    if (! capture) return;
+    if (free < 0)
+    {
+        log_e("==> more than %d capturing panels", _maxCaptures);
+        return;
+    }
+    _captures[free] = this;
+}
+
+/**
+ * Add a widget with a touch handler to the hit grid, with the background
+ * of the panel the first time. Widgets without a handler are skipped.
+ */
+void UiPanel::addTouchable(UiButton *btn)
+{
+    int x, y, w, h;
+    if (! btn->isTouchable()) return;
+    if (! _indexed) _indexed = _hitGrid.add({ this, nullptr }, _x, _y, _w, _h);
+    btn->getBounds(x, y, w, h);
+    _hitGrid.add({ this, btn }, x, y, w, h);
+}
+
+/**
+ * Draw the panel at once. A queued repaint of it is dropped, the other 
+ * queued panels are drawn first, so they do not paint over it later.
+ */
 void UiPanel::show()
 {
-    _lcd.fillRect(_x,_y,_w,_h,_bgColor);
+    renderer.remove(this);
+    renderer.flush();
     _hidden = false;    
+    for (int i = 0; i < parts(); i++) drawPart(i);
+}
+
+// bands of the background on the screen
+int UiPanel::bands()
+{
+    int h = std::min(_y + _h, (int)_lcd.height()) - _y;
+    return h > 0 ? (h + _bandRows - 1) / _bandRows : 0;
+}
+
+void UiPanel::drawPart(int part)
+{
+    int y = _y + part * _bandRows;
+    _lcd.fillRect(_x, y, _w, std::min(_bandRows, _y + _h - y), _bgColor);
 }
 
 void UiPanel::hide(UiPanel *pCaller)
@@ -330,109 +731,124 @@ LGFX &UiPanel::getScreen()
     return _lcd; 
 }
 
-void UiPanel::panelText(int x, int y, String text, int textColor, GFXfont font)
+/**
+ * The touch is polled while the finger rests on the screen. A key counts 
+ * again after msRepeat, another key counts at once. Replaces the delay() 
+ * after each key, which blocked loop(). A replay of recorded touches sets 
+ * the clock with setKeyClock(), so the repeat does not depend on its speed.
+ */
+bool UiPanel::acceptKey(UiButton *btn, uint32_t msRepeat)
+{
+    static UiButton *lastKey = nullptr;
+    static uint32_t msLastKey = 0;
+    uint32_t ms = _msKeyClock ? _msKeyClock() : millis();
+    if (btn == lastKey && ms - msLastKey < msRepeat) return false;
+    lastKey = btn;
+    msLastKey = ms;
+    return true;
+}
+
+/**
+ * Text on the panel background, aligned by the text datum of the screen
+ */
+void UiPanel::panelText(int x, int y, const char *text, int textColor, const GFXfont &font)
 {
-    LGFX lcd = getScreen();
-    lcd.setFont(&font);
-    lcd.setTextColor(textColor);
-    lcd.drawString(text, _x+x, _y+y);
+    uiGlyphs.drawString(_lcd, text, _x+x, _y+y, _lcd.getTextDatum(), &font, textColor, _bgColor);
 }
 // --- UiPanel ---
 
 
-void UiKeypad::show()
+constexpr UiWidgetDef UiKeypad::_layout[];
+
+void UiKeypad::drawPart(int part)
+{
+    if (part < bands()) UiPanel::drawPart(part);
+    else                _keys[part - bands()].draw();
+}
+
+/**
+ * The keypad is an overlay: it lies above the panels and takes all touches
+ * while it is open
+ */
+UiKeypad::UiKeypad(LGFX &lcd, int x, int y, int bgColor, bool hidden) : 
+    UiPanel(lcd, x, y, _wp, _hp, bgColor, hidden)
 {
-    UiPanel::show();
-    _btnEntry->clearValue();
-    for (int i = 0; i < _btns.size(); i++) { _btns.at(i)->draw(); }
+    setLayer(1);
+    setCapture(true);
+    for (UiButton &key : _keys) { addTouchable(&key); }
+    if (! hidden) show();
 }
 
-void UiKeypad::handleKeys(int x, int y)
+// digits and decimal point
+void UiKeypad::typeKey(UiPanel *keypad, UiButton *key)
 {
-    int msKeyDelay = 300;
-    for (int i = 1; i < _btns.size(); i++)
+    UiButton &entry = static_cast<UiKeypad *>(keypad)->entry();
+    Serial.printf("Key pressed: %s\n", key->getValue().c_str());
+    if (key->getValue() == "." && entry.getValue().indexOf('.') > 0) return;
+    entry.updateValue(entry.getValue() + key->getValue());
+}
+
+void UiKeypad::backKey(UiPanel *keypad, UiButton *key)
+{
+    UiButton &entry = static_cast<UiKeypad *>(keypad)->entry();
+    Serial.printf("Key pressed: %s\n", key->getValue().c_str());
+    entry.updateValue(entry.getValue().substring(0, entry.getValue().length()-1));
+}
+
+void UiKeypad::clearKey(UiPanel *keypad, UiButton *key)
+{
+    Serial.printf("Key pressed: %s\n", key->getValue().c_str());
+    static_cast<UiKeypad *>(keypad)->entry().updateValue("");
+}
+
+void UiKeypad::signKey(UiPanel *keypad, UiButton *key)
+{
+    UiButton &entry = static_cast<UiKeypad *>(keypad)->entry();
+    Serial.printf("Key pressed: %s\n", key->getValue().c_str());
+    if (entry.getValue().length() == 0) return;
+    if (entry.getValue().indexOf('.') > 0) // it's a float
     {
-        if (_btns.at(i)->touched(x, y))
-        {
-            String keyValue = _btns.at(i)->getValue();
-            Serial.printf("Key pressed: %s\n", keyValue);
-            if (i > 0 && i < 12) // handle digits and decimal point
-            {
-                if (_btns.at(i)->getValue() == "." && _btnEntry->getValue().indexOf('.') > 0) return;
-                String newValue = _btnEntry->getValue() + _btns.at(i)->getValue();
-                _btnEntry->updateValue(newValue);
-                delay(msKeyDelay);
-                return;
-            }
+        double v = entry.getValue().toDouble();
+        if (v != 0) v = -v;
+        entry.updateValue(v);
+    }
+    else
+    {
+        int v = entry.getValue().toInt(); // it's an integer
+        entry.updateValue(-v);
+    }
+}
 
-            if (keyValue == "Clr") 
-                { 
-                    _btnEntry->updateValue(""); 
-                    return; 
-                }
-            if (keyValue == "C") 
-                { 
-                    _btnEntry->updateValue(_btnEntry->getValue().substring(0, _btnEntry->getValue().length()-1));
-                    delay(msKeyDelay); 
-                    return; 
-                }
-            if (keyValue =="+/-")
-                { 
-                    if (_btnEntry->getValue().length() > 0)
-                    {
-                        if (_btnEntry->getValue().indexOf('.') > 0) // it's a float
-                        {
-                            double v = _btnEntry->getValue().toDouble();
-                            if (v != 0) v = -v;
-                            _btnEntry->updateValue(v);
-                        }
-                        else
-                        {
-                            int v = _btnEntry->getValue().toInt(); // it's an integer
-                            v = -v;
-                            //log_i("int %d", v);
-                            _btnEntry->updateValue(v);
-                        }
-                        delay(msKeyDelay);
-                        return; 
-                    }  
-                }
-            if (keyValue == "X")
-            {
-                delay(msKeyDelay);
-                //log_e("==> done X");
-                hide();
-                UiPanel::redrawPanels(); // Called to restore underlying panels 
-                return;
-            }
-            if (keyValue == "OK")
-            {
-                delay(msKeyDelay);
-                String e = _btnEntry->getValue();
-                if (!_targetValueField->rangeIsInteger()) // The assigned value field contains floats
-                {
-                    double v = e.toDouble();
-                    _targetValueField->updateValue(v);
-                    _targetValueField->getValue(v);
-                    //log_e("==> done OK: targetValueField=%p, slider=%p", _targetValueField, this);
-                    if (_targetValueField->hasSlider()) reinterpret_cast<UiHslider *>(_targetValueField->getSlider())->slideToValue(v);
-                }
-                else
-                {
-                    int v = e.toInt();                    // The assigned value field contains integers
-                    _targetValueField->updateValue(v);
-                    _targetValueField->getValue(v);
-                    //log_e("==> done OK: targetValueField=%p, slider=%p", _targetValueField, this);
-                    if (_targetValueField->hasSlider()) reinterpret_cast<UiHslider *>(_targetValueField->getSlider())->slideToValue(v);
-                } 
-                       
-                hide();
-                _okCallback(_targetValueField);
-                UiPanel::redrawPanels(); // Called to restore underlying panels
-                return;                
-            }
-        }
-    }    
+void UiKeypad::cancelKey(UiPanel *keypad, UiButton *key)
+{
+    UiKeypad *kp = static_cast<UiKeypad *>(keypad);
+    Serial.printf("Key pressed: %s\n", key->getValue().c_str());
+    kp->_accepted = false;
+    kp->hide();  // the opener restores the underlying panels
+}
+
+void UiKeypad::okKey(UiPanel *keypad, UiButton *key)
+{
+    UiKeypad *kp = static_cast<UiKeypad *>(keypad);
+    UiButton *target = kp->_targetValueField;
+    Serial.printf("Key pressed: %s\n", key->getValue().c_str());
+    String e = kp->entry().getValue();
+    if (! target->rangeIsInteger()) // The assigned value field contains floats
+    {
+        double v = e.toDouble();
+        target->updateValue(v);
+        target->getValue(v);
+        if (target->hasSlider()) reinterpret_cast<UiHslider *>(target->getSlider())->slideToValue(v);
+    }
+    else
+    {
+        int v = e.toInt();                    // The assigned value field contains integers
+        target->updateValue(v);
+        target->getValue(v);
+        if (target->hasSlider()) reinterpret_cast<UiHslider *>(target->getSlider())->slideToValue(v);
+    } 
+    kp->_accepted = true;
+    kp->hide();  // the opener applies the value and restores the underlying panels
 }
 
 void UiKeypad::addValueField(UiButton *btn) 
@@ -440,8 +856,25 @@ void UiKeypad::addValueField(UiButton *btn)
     _targetValueField = btn;
 }
 
-void UiKeypad::addOkCallback(Callback cb)
+/**
+ * Show the keypad for the value field btn. Wait until isOpen() is false, 
+ * then isAccepted() tells whether the field was changed.
+ */
+void UiKeypad::open(UiButton *btn)
 {
-    _okCallback = cb;
+    addValueField(btn);
+    _accepted = false;
+    entry().clearValue();
+    show();
+}
+
+// The key labelled value ("0".."9", ".", "OK", ...), nullptr if there is none
+UiButton *UiKeypad::getKey(const char *value)
+{
+    for (int i = 1; i < _keyCount; i++)
+    {
+        if (_keys[i].getValue() == value) return &_keys[i];
+    }
+    return nullptr;
 }
 // --- UiKeypad ---
\ No newline at end of file
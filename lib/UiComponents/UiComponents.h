@@ -11,8 +11,10 @@
 //Forward declaration
 class UiKeypad;
 class UiButton;
+class UiPanel;
 
-using Callback = void(*)(UiButton *);
+// Called by UiPanel::touch() with the panel of the widget that was touched
+using UiTouchHandler = void (*)(UiPanel *panel, UiButton *btn);
 
 class UiTheme
 {
@@ -34,20 +36,127 @@ class UiTheme
 extern UiTheme defaultTheme;
 extern UiTheme blueTheme;
 
+// The part of a widget that does not change: position relative to the 
+// origin of its panel, texts, range, theme and touch handler. Declared as
+// constexpr table the layout stays in flash, the widget keeps a pointer to 
+// it and only its state in RAM. Members left out of the initializer are 0.
+struct UiWidgetDef
+{
+    int16_t x, y, w, h;         // UiLed: center and diameter
+    const char *value;          // initial value
+    const char *label;
+    double min, max;            // range of a value field, 0, 0: none
+    bool integer;               // the range and the value are integers
+    int color;                  // UiLed and UiHslider
+    const UiTheme *theme;       // nullptr: defaultTheme
+    UiTouchHandler onTouch;     // nullptr: not touchable
+};
+
+// Spatial index of the touchable widgets. The screen is divided into cells
+// of cellSize pixels and each cell lists the widgets and panels overlapping
+// it, top-most first: higher layers before lower ones and the widgets of a
+// panel before its background. A touch only tests the entries of its cell,
+// so the cost does not grow with the number of panels and widgets.
+// Fixed size arrays, usable before the constructors of other files ran.
+class UiHitGrid
+{
+    public:
+        static const int cellSize = 40;
+        static const int cols = 8;          // 320 x 320, both orientations
+        static const int rows = 8;
+        static const int maxEntries = 64;
+        static const int maxPerCell = 12;
+
+        struct Entry
+        {
+            UiPanel *panel;
+            UiButton *btn;      // nullptr: the background of the panel
+        };
+
+        bool add(const Entry &e, int x, int y, int w, int h);
+        void remove(const UiPanel *panel);
+        int  at(int x, int y, const Entry *list[maxPerCell]);
+        int  size() { return _count; }
+
+    private:
+        static int rank(const Entry &e);
+
+        Entry   _entries[maxEntries];
+        int     _count;
+        uint8_t _cells[cols * rows][maxPerCell];  // indexes into _entries
+        uint8_t _cellCount[cols * rows];
+};
+
+// Queue of panels to repaint, drawn a part at a time (see UiPanel::parts())
+// in slices of a time budget per pass of loop(), so a repaint of the panels
+// does not hold up the touch and serial input. A slice also ends when the
+// preempt function reports waiting input. A frame lasts from the first 
+// queued panel until the queue is empty.
+// Fixed size arrays, usable before the constructors of other files ran.
+class UiRenderer
+{
+    public:
+        static const int maxPanels = 8;
+
+        struct Stats
+        {
+            uint32_t frames;
+            uint32_t usLastFrame;     // first queued panel until the queue was empty
+            uint32_t usMaxFrame;
+            uint64_t usTotalFrame;
+            uint32_t slices;
+            uint32_t preempted;       // slices ended early for input
+            uint32_t usMaxSlice;
+            uint32_t touches;         // handled while a frame was drawn
+            uint32_t missed;          // touch polls missed while a frame was drawn
+        };
+
+        void add(UiPanel *panel);
+        void remove(UiPanel *panel);
+        bool run(uint32_t usBudget);
+        void flush();
+        bool isBusy() { return _count > 0; }
+        void setPreempt(bool (*preempt)()) { _preempt = preempt; }
+        void countInput(bool touched, uint32_t missed);
+        const Stats &getStats() { return _stats; }
+        void printStats(uint32_t usBudget);
+
+    private:
+        bool drawNext();
+
+        struct Item
+        {
+            UiPanel *panel;
+            int next;                 // part to draw
+        };
+
+        Item     _items[maxPanels];   // in the order of drawing
+        int      _count;
+        uint32_t _usFrameStart;
+        bool   (*_preempt)();
+        Stats    _stats;
+};
+
 // A panel is the rectangular container of other GUI components.
 // It can freely be placed on the lcd screen. The components are placed 
 // relative to the panels origin (left upper corner).
 // An optional keypad for entering numbers can be associated with the panel.
-// The user has to derive his custom panels from this class. For each
-// custom panel he must implement a keyhandler function, that processes 
-// the inputs on the touch screen. 
+// The user has to derive his custom panels from this class. The widgets 
+// that process inputs on the touch screen get a handler in their 
+// UiWidgetDef, UiPanel::touch() calls the one of the top-most widget under
+// the touch. Overlays like the keypad are on a higher layer. A widget that 
+// is dragged, like the slider, gets all touches until the finger is lifted.
+// A panel draws itself in parts, the bands of its background and then its
+// widgets, so a queued repaint can be spread over several passes of loop().
+// Derived panels add their widgets to parts() and drawPart().
 class UiPanel
 {   
     public:
-        static std::vector<UiPanel *> panels; // Holds all panels defined in main
-        static void redrawPanels() // Redraw all panels. Called when Keypad is closed
+        static std::vector<UiPanel *> panels; // The panels on the screen, set by UiScreens
+        static UiRenderer renderer;            // draws queued repaints in slices, see loop()
+        static void redrawPanels() // Queue a redraw of all panels. Called when Keypad is closed
         { 
-            for (int i = 0; i < panels.size(); i++) panels.at(i)->show(); 
+            for (size_t i = 0; i < panels.size(); i++) renderer.add(panels.at(i)); 
         }
 
         UiPanel(LGFX &lcd, bool hidden) : 
@@ -66,15 +175,42 @@ class UiPanel
             _lcd(lcd), _x(x), _y(y),  _w(w), _h(h), _hidden(hidden)
         {}
 
-        virtual void show(); 
+        virtual ~UiPanel();
+
+        void show();                       // draws all parts at once
+        virtual int  parts() { return bands(); }
+        virtual void drawPart(int part);   // the background bands, derived panels add their widgets
         void hide(UiPanel *pCaller=nullptr);
         bool isHidden();
+        void setHidden(bool hidden) { _hidden = hidden; }  // without drawing, e.g. covered by another panel
         void addKeypad(UiKeypad *pKeypad);
         int getPanelColor();
-        void panelText(int x, int y, String text, int textColor=TFT_BLACK,  GFXfont=fonts::DejaVu18);
+        void panelText(int x, int y, const char *text, int textColor=TFT_BLACK, const GFXfont &font=fonts::DejaVu18);
         LGFX &getScreen();
+        static void setKeyClock(uint32_t (*msClock)()) { _msKeyClock = msClock; }  // time of the key repeat, millis() if nullptr
+        static bool touch(int x, int y);
+        static void waitForRelease() { _waitRelease = true; }  // drop touches until the finger is lifted
+        static bool isDragging() { return _dragged != nullptr; }
+        void setLayer(int layer) { _layer = layer; }  // before addTouchable()
+        void setCapture(bool capture);
+        void setKeyRepeat(uint32_t ms) { _msRepeat = ms; }
+        void addTouchable(UiButton *btn);
+        bool contains(int x, int y) { return x >= _x && x < _x+_w && y >= _y && y < _y+_h; }
+        int getX() { return _x; }
+        int getY() { return _y; }
         
     protected:
+        static constexpr int _bandRows = 32;   // rows of the background per part
+        int bands();
+        static bool acceptKey(UiButton *btn, uint32_t msRepeat);
+        static uint32_t (*_msKeyClock)();
+        static bool _waitRelease;
+        static UiButton *_dragged;        // gets the touches until the finger is lifted
+        static UiPanel *_dragPanel;
+        static UiHitGrid _hitGrid;
+        static const int _maxCaptures = 4;
+        static UiPanel *_captures[_maxCaptures];
+
         LGFX &_lcd;
         int _x = 0;
         int _y = 0;
@@ -83,29 +219,33 @@ class UiPanel
         int _bgColor = TFT_BLACK;    
         bool _hidden = true;
         UiKeypad *_pKeypad = nullptr;
+        int _layer = 0;              // overlays are above 0
+        bool _indexed = false;       // the background is in the hit grid
+        uint32_t _msRepeat = 300;    // a touched key counts again after this time
+        friend class UiHitGrid;
 };
 
 
 // Button acts as pushbutton or input/output value field.
-// The components UiLed and UiSlider are derived classes from UiButton
+// The components UiLed and UiSlider are derived classes from UiButton.
+// The layout comes from a UiWidgetDef that must outlive the button.
 class UiButton
 {
     public:
-        UiButton(UiPanel *parent, int x, int y, int w, int h, UiTheme &theme, String value="", String label="") : 
-            _parent(parent), _x(x), _y(y), _w(w), _h(h), _theme(theme), _value(value), _label(label)
-        {}    
-
-        UiButton(UiPanel *parent, int x, int y, int w, int h, String value="", String label="") : 
-            _parent(parent), _x(x), _y(y), _w(w), _h(h), _value(value), _label(label)
-        {}
-
-        UiButton(UiPanel *parent, int x, int y, int w, int h) : 
-            _parent(parent), _x(x), _y(y), _w(w), _h(h)
+        UiButton(UiPanel *parent, const UiWidgetDef *def) : 
+            _def(def), _parent(parent), _lcd(parent->getScreen()), 
+            _theme(def->theme ? *def->theme : defaultTheme), _value(def->value), _label(def->label)
         {}
 
         virtual void draw();
         virtual bool touched(int x, int y);
+        virtual void getCenter(int &x, int &y);
+        virtual void getBounds(int &x, int &y, int &w, int &h);
+        bool isTouchable() { return _def->onTouch != nullptr; }
+        void handleTouch() { if (_def->onTouch) _def->onTouch(_parent, this); }
+        virtual bool drag(int x, int y) { return false; }  // true: the widget follows the finger
         void clearValue();
+        void setValue(String value);
         String getValue();
         void getValue(String &value);
         void getValue(int &value);
@@ -114,35 +254,30 @@ class UiButton
         void updateValue(int value);
         void updateValue(double value);
         void clearLabel();
-        void setLabel(String label);
+        void setLabel(const char *label, bool redraw=true);  // label must outlive the button
         String getLabel();
-        void setRange(int min, int max);
-        void setRange(double min, double max);
         bool rangeIsInteger();
         void addSlider(UiButton* pSlider);
         bool hasSlider();
         UiButton *getSlider();
 
     protected:  
-        int _x = 0;
-        int _y = 0;
-        int _w; 
-        int _h;
-        int _d = 8;
-        int _r = 4;
-        int    _minInt = 0;
-        int    _maxInt = 0;
-        int    _valInt = 0;
-        double _minDouble = 0.0;
-        double _maxDouble = 0.0;
-        double _valDouble = 0.0;
-        bool _rangeIsInteger = true; 
+        static const int _d = 8;   // distance to the label
+        static const int _r = 4;   // radius of the corners
+
+        // position on the screen
+        int _x() { return _parent->getX() + _def->x; }
+        int _y() { return _parent->getY() + _def->y; }
+        int _w() { return _def->w; }
+        int _h() { return _def->h; }
+
+        const UiWidgetDef *_def;
         UiPanel *_parent;
+        LGFX &_lcd;
+        const UiTheme &_theme;
         UiButton *_pSlider = nullptr;
-        LGFX &_lcd = _parent->getScreen();
-        UiTheme &_theme=defaultTheme;
-        String _value="";
-        String _label="";
+        String _value;
+        const char *_label;
 };  //--- UiButton ---
 
 
@@ -150,114 +285,115 @@ class UiButton
 class UiLed : public UiButton
 {
     public:
-        UiLed(UiPanel *parent, int x, int y, int radius, int color, UiTheme &theme, String label="", bool isOn=false) : 
-            UiButton(parent, x, y, 2*radius, 2*radius, theme, "", label), _radius(radius), _color(color), _isOn(isOn)
-        {}
-
-        UiLed(UiPanel *parent, int x, int y, int radius, int color, String label="", bool isOn=false) : 
-            UiButton(parent, x, y, 2*radius, 2*radius, "", label), _radius(radius), _color(color), _isOn(isOn)
+        UiLed(UiPanel *parent, const UiWidgetDef *def, bool isOn=false) : 
+            UiButton(parent, def), _isOn(isOn)
         {}
 
         void draw();
         bool touched(int x, int y);
-        void setLabel(String txt);
+        void getCenter(int &x, int &y);
+        void getBounds(int &x, int &y, int &w, int &h);
+        void setLabel(const char *txt, bool redraw=true);
         bool isOn();
+        void setOn(bool isOn);
         void on();
         void off();
         void toggle();
 
-        private:
-        int  _radius; // radius of slider button
+    private:
+        int _radius() { return _def->w / 2; }
+
         bool _isOn = false;
-        int  _color; // color of the slider button        
 };
 
 
-// A horizontal slider with optional linked value field
+// A horizontal slider with optional linked value field. The knob follows
+// the finger while it is dragged, the touch handler is called for every 
+// new position and once more when the finger is lifted. A moved knob only
+// redraws the columns it left and the ones it covers now.
 class UiHslider : public UiButton
 {
     public:
-        UiHslider(UiPanel *parent, int x, int y, int w, int h, int color, UiTheme &theme, String label="") : 
-            UiButton(parent, x, y, w, h, theme, "", label), _color(color)
-            {_value = (_position-_x) * 100 / _w; }
-
-        UiHslider(UiPanel *parent, int x, int y, int w, int h, int color, String label="") : 
-            UiButton(parent, x, y, w, h, "", label), _color(color)
-            {_value = (_position-_x) * 100 / _w; }
-
-        UiHslider(UiPanel *parent, int x, int y, int w, int h, String label="") : 
-            UiButton(parent, x, y, w, h, "", label)
-            {_value = (_position-_x) * 100 / _w; }
+        UiHslider(UiPanel *parent, const UiWidgetDef *def) : 
+            UiButton(parent, def), _position(_x() + _w()/2)
+            {_value = (_position-_x()) * 100 / _w(); }
 
         void draw();
+        bool touched(int x, int y);
+        void getBounds(int &x, int &y, int &w, int &h);
+        bool drag(int x, int y);
+        bool isDragging() { return _dragging; }
         void slideToPosition(int x);
-        void slideToValue(int v);
-        void slideToValue(double v);
+        void slideToValue(int v, bool redraw=true);
+        void slideToValue(double v, bool redraw=true);
         void addValueField(UiButton *btn);
         bool hasValueField();
         UiButton *getValueField();
-        void setRange(int min, int max);
-        void setRange(double min, double max);
         
     private:
-        int _color=TFT_LIGHTGREY;
-        int _d = 10; // distance to label
-        int _r = 4;  // radius of rounded rectangle
-        int _rb= 3*_h/4;  // radius of slider knob
-        int _position = _x+_w/2;
+        static const int _d = 10; // distance to label
+        int _rb() { return 3*_h()/4; }  // radius of slider knob
+        void drawTrack();
+        void moveKnob(int x);
+
+        int _position;
+        bool _dragging = false;
+        bool _moved = false;              // during the drag
         UiButton *_pValueField = nullptr; // ponter to linked value field
 };
 
+// Layout of the keys of the keypad: 40 x 25 pixel keys, 4 pixels apart
+constexpr UiWidgetDef uiKeyDef(int row, int col, const char *text, UiTouchHandler onTouch, int span=1)
+{
+    return { int16_t(4 + col*44), int16_t(4 + row*29), int16_t(span*44 - 4), 25, text, "", 0.0, 0.0, false, 0, nullptr, onTouch };
+}
+
 // Numeric keypad for entering numbers
 class UiKeypad : public UiPanel
 {
     public:
-        UiKeypad(LGFX &lcd, int x, int y, int bgColor, bool hidden) : 
-            UiPanel(lcd, x, y, _wp, _hp, bgColor, hidden)
-        { if (! hidden) show(); }
+        UiKeypad(LGFX &lcd, int x, int y, int bgColor, bool hidden);
 
-        void show();
-        void handleKeys(int x, int y);
+        int  parts() { return bands() + _keyCount; }
+        void drawPart(int part);
         void addValueField(UiButton *btn);
-        void addOkCallback(Callback cb);
+        void open(UiButton *btn);
+        UiButton *getKey(const char *value);
+        bool isOpen() { return ! _hidden; }
+        bool isAccepted() { return _accepted; }  // closed with OK, the value field holds the new value
 
     private:
-        int __x = _x + _gap; // origin x of the top left button (screen coords)
-        int __y = _y + _gap; // origin y of the top left button (screen coords)
+        static void typeKey(UiPanel *keypad, UiButton *key);
+        static void backKey(UiPanel *keypad, UiButton *key);
+        static void clearKey(UiPanel *keypad, UiButton *key);
+        static void signKey(UiPanel *keypad, UiButton *key);
+        static void cancelKey(UiPanel *keypad, UiButton *key);
+        static void okKey(UiPanel *keypad, UiButton *key);
 
         static const int _rows = 5;  // number of key rows
         static const int _cols = 4;  // number of key columns
-        static const int _wb   = 40; // width of the keys
-        static const int _hb   = 25; // height of the keys
-        static const int _gap  = 4;  // gap between keys 
-        static const int _wp   = _cols*(_wb+_gap) + _gap; // width of the underlying panel
-        static const int _hp   = _rows*(_hb+_gap) + _gap; // height of the underlying panel
-
-        UiButton *_targetValueField;
-        Callback _okCallback = nullptr;
-
-        UiButton *_btnEntry = new UiButton(this, __x, __y, (_wb + _gap)*_cols - _gap, _hb, "");
-        UiButton *_btn1     = new UiButton(this, __x,               __y+(_hb+_gap), _wb, _hb, "1");
-        UiButton *_btn2     = new UiButton(this, __x+1*(_wb + _gap), __y+(_hb+_gap), _wb, _hb, "2");
-        UiButton *_btn3     = new UiButton(this, __x+2*(_wb + _gap), __y+(_hb+_gap), _wb, _hb, "3");
-        UiButton *_btnC     = new UiButton(this, __x+3*(_wb + _gap), __y+(_hb+_gap), _wb, _hb, "C");
-
-        UiButton *_btn4   = new UiButton(this, __x,               __y+2*(_hb+_gap), _wb, _hb, "4");
-        UiButton *_btn5   = new UiButton(this, __x+1*(_wb + _gap), __y+2*(_hb+_gap), _wb, _hb, "5");
-        UiButton *_btn6   = new UiButton(this, __x+2*(_wb + _gap), __y+2*(_hb+_gap), _wb, _hb, "6"); 
-        UiButton *_btnClr = new UiButton(this, __x+3*(_wb + _gap), __y+2*(_hb+_gap), _wb, _hb, "Clr");
-
-        UiButton *_btn7      = new UiButton(this, __x,               __y+3*(_hb+_gap), _wb, _hb, "7");
-        UiButton *_btn8      = new UiButton(this, __x+1*(_wb + _gap), __y+3*(_hb+_gap), _wb, _hb, "8");
-        UiButton *_btn9      = new UiButton(this, __x+2*(_wb + _gap), __y+3*(_hb+_gap), _wb, _hb, "9");
-        UiButton *_btnCancel = new UiButton(this, __x+3*(_wb + _gap), __y+3*(_hb+_gap), _wb, _hb, "X");
-
-        UiButton *_btnSign = new UiButton(this, __x,               __y+4*(_hb+_gap), _wb, _hb, "+/-");
-        UiButton *_btn0    = new UiButton(this, __x+1*(_wb + _gap), __y+4*(_hb+_gap), _wb, _hb, "0");
-        UiButton *_btnDot  = new UiButton(this, __x+2*(_wb + _gap), __y+4*(_hb+_gap), _wb, _hb, ".");
-        UiButton *_btnOk   = new UiButton(this, __x+3*(_wb + _gap), __y+4*(_hb+_gap), _wb, _hb, "OK");
-
-        std::vector<UiButton *> _btns = {_btnEntry, _btn1, _btn2, _btn3, _btn4, _btn5, _btn6, 
-                                         _btn7, _btn8, _btn9, _btn0, _btnDot, _btnC, _btnClr, 
-                                         _btnCancel, _btnSign, _btnOk};
+        static const int _wp   = _cols*44 + 4; // width of the underlying panel
+        static const int _hp   = _rows*29 + 4; // height of the underlying panel
+        static const int _keyCount = 17;
+        static constexpr UiWidgetDef _layout[_keyCount] = 
+        {
+            uiKeyDef(0, 0, "",  nullptr, _cols),  // entry
+            uiKeyDef(1, 0, "1", typeKey),    uiKeyDef(1, 1, "2", typeKey), uiKeyDef(1, 2, "3", typeKey),  uiKeyDef(1, 3, "C",   backKey),
+            uiKeyDef(2, 0, "4", typeKey),    uiKeyDef(2, 1, "5", typeKey), uiKeyDef(2, 2, "6", typeKey),  uiKeyDef(2, 3, "Clr", clearKey),
+            uiKeyDef(3, 0, "7", typeKey),    uiKeyDef(3, 1, "8", typeKey), uiKeyDef(3, 2, "9", typeKey),  uiKeyDef(3, 3, "X",   cancelKey),
+            uiKeyDef(4, 0, "+/-", signKey),  uiKeyDef(4, 1, "0", typeKey), uiKeyDef(4, 2, ".", typeKey),  uiKeyDef(4, 3, "OK",  okKey),
+        };
+
+        UiButton *_targetValueField = nullptr;
+        bool _accepted = false;
+
+        UiButton _keys[_keyCount] = 
+        {
+            {this, &_layout[0]},  {this, &_layout[1]},  {this, &_layout[2]},  {this, &_layout[3]},
+            {this, &_layout[4]},  {this, &_layout[5]},  {this, &_layout[6]},  {this, &_layout[7]},
+            {this, &_layout[8]},  {this, &_layout[9]},  {this, &_layout[10]}, {this, &_layout[11]},
+            {this, &_layout[12]}, {this, &_layout[13]}, {this, &_layout[14]}, {this, &_layout[15]},
+            {this, &_layout[16]},
+        };
+        UiButton &entry() { return _keys[0]; }
 };
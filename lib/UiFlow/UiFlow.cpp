@@ -0,0 +1,78 @@
+#include "UiFlow.h"
+#include <algorithm>
+
+/**
+ * Start the flow at FLOW_BEGIN. A running flow is restarted.
+ */
+void UiFlowRunner::start(UiFlow *flow)
+{
+    flow->_line = 0;
+    flow->_timed = false;
+    flow->_running = true;
+    if (std::find(_flows.begin(), _flows.end(), flow) == _flows.end()) _flows.push_back(flow);
+    _started++;
+}
+
+void UiFlowRunner::stop(UiFlow *flow)
+{
+    flow->_running = false;  // removed by run()
+}
+
+/**
+ * Resume every running flow once. A flow waiting in FLOW_DELAY is skipped 
+ * until its time has come. Returns the number of flows still running.
+ */
+int UiFlowRunner::run()
+{
+    for (size_t i = 0; i < _flows.size(); i++)  // a flow may start others, they run in this pass
+    {
+        UiFlow *flow = _flows[i];
+        if (! flow->_running) continue;
+        if (flow->_timed && (int32_t)(millis() - flow->_msWake) < 0) continue;
+        uint32_t usStart = micros();
+        flow->run();
+        uint32_t us = micros() - usStart;
+        if (us > _usMaxResume) _usMaxResume = us;
+        _resumes++;
+        if (! flow->_running) _finished++;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < _flows.size(); i++)
+    {
+        if (_flows[i]->_running) _flows[n++] = _flows[i];
+    }
+    _flows.resize(n);
+    return n;
+}
+
+/**
+ * Milliseconds until the next FLOW_DELAY expires, -1 if no flow waits for 
+ * a time. Conditions only change when a job or serial input ran, and then 
+ * loop() is awake anyway.
+ */
+int32_t UiFlowRunner::msUntilNext()
+{
+    int32_t ms = -1;
+    for (UiFlow *flow : _flows)
+    {
+        if (! flow->_running || ! flow->_timed) continue;
+        int32_t d = flow->_msWake - millis();
+        if (d < 0) d = 0;
+        if (ms < 0 || d < ms) ms = d;
+    }
+    return ms;
+}
+
+void UiFlowRunner::printStats()
+{
+    Serial.printf(R"(
+UI flows
+--------
+running    %8u
+started    %8u
+finished   %8u
+resumes    %8u
+max resume %8u us
+)", (unsigned)_flows.size(), _started, _finished, _resumes, _usMaxResume);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+/**
+ * Class        UiFlow, UiFlowRunner
+ *
+ * Purpose      Sequential UI flows that do not block loop(). A flow is a 
+ *              stackless coroutine in the style of protothreads: its body 
+ *              run() is written top to bottom with FLOW_AWAIT(condition) and 
+ *              FLOW_DELAY(ms) and returns at every wait. The runner calls 
+ *              run() again each time loop() passes, and the body continues 
+ *              after the wait it returned from.
+ *              Local variables do not survive a wait, keep the state in 
+ *              members of the flow. A switch statement must not enclose 
+ *              a wait.
+ *              A condition is evaluated every time the runner runs, i.e. 
+ *              after every job of the scheduler and after serial input. 
+ *              msUntilNext() tells loop() how long it may sleep until the 
+ *              next FLOW_DELAY expires; waiting for a condition does not 
+ *              keep loop() awake.
+ *
+ * Usage        class EditFlow : public UiFlow
+ *              {
+ *                  void run() override
+ *                  {
+ *                      FLOW_BEGIN();
+ *                      keypad.open(field);
+ *                      FLOW_AWAIT(! keypad.isOpen());
+ *                      if (keypad.isAccepted()) apply(field);
+ *                      UiPanel::redrawPanels();
+ *                      FLOW_END();
+ *                  }
+ *              } editFlow;
+ *
+ *              UiFlowRunner flows;
+ *              flows.start(&editFlow);     // (re)starts at FLOW_BEGIN
+ *              loop: flows.run();
+ */
+class UiFlow
+{
+    public:
+        virtual ~UiFlow() {}
+        bool isRunning() { return _running; }
+
+    protected:
+        virtual void run() = 0;
+
+        uint16_t _line = 0;         // where run() continues, 0 = at the beginning
+        bool _running = false;
+        bool _timed = false;        // waiting in FLOW_DELAY until _msWake
+        uint32_t _msWake = 0;
+
+        friend class UiFlowRunner;
+};
+
+// entering a resume point falls through into its case label on purpose;
+// the GNU attribute says so in C++11 as well, where [[fallthrough]] is not
+#define FLOW_FALLTHROUGH    __attribute__((fallthrough))
+#define FLOW_BEGIN()        _timed = false; switch (_line) { case 0:
+#define FLOW_AWAIT(cond)    do { _line = __LINE__; FLOW_FALLTHROUGH; case __LINE__: if (! (cond)) return; } while (0)
+#define FLOW_DELAY(ms)      do { _msWake = millis() + (ms); _timed = true; _line = __LINE__; FLOW_FALLTHROUGH; case __LINE__: \
+                                 if ((int32_t)(millis() - _msWake) < 0) { _timed = true; return; } _timed = false; } while (0)
+#define FLOW_YIELD()        do { _line = __LINE__; return; case __LINE__: ; } while (0)
+#define FLOW_END()          } _line = 0; _running = false
+
+class UiFlowRunner
+{
+    public:
+        void start(UiFlow *flow);
+        void stop(UiFlow *flow);
+        int  run();
+        int32_t msUntilNext();
+        void printStats();
+
+        uint32_t getResumes() { return _resumes; }
+
+    private:
+        std::vector<UiFlow *> _flows;  // running flows
+        uint32_t _resumes = 0;
+        uint32_t _usMaxResume = 0;
+        uint32_t _started = 0;
+        uint32_t _finished = 0;
+};
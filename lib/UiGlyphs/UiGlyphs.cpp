@@ -0,0 +1,177 @@
+#include "UiGlyphs.h"
+
+UiGlyphs uiGlyphs;
+
+/**
+ * Draw s at x, y aligned by datum (textdatum_t, baseline excepted) in fg
+ * on bg, like LGFX::drawString() after setTextDatum(), setFont() and
+ * setTextColor(fg, bg). Missing glyphs are rasterised first.
+ */
+void UiGlyphs::drawString(LGFX &lcd, const char *s, int x, int y, uint8_t datum, const IFont *font,
+                          uint16_t fg, uint16_t bg)
+{
+    Font *f = _direct || ! fits(s) || (datum & 16) ? nullptr : findFont(lcd, font);
+    if (f == nullptr || ! rasterise(lcd, *f, s))
+    {
+        drawDirect(lcd, s, x, y, datum, font, fg, bg);
+        return;
+    }
+    uint32_t usStart = micros();
+    int w = 0, h = f->height;
+    for (const char *p = s; *p; p++) w += f->width[*p - firstChar];
+    if ((datum & 3) == 1) x -= w / 2;
+    else if ((datum & 3) == 2) x -= w;
+    if ((datum & 12) == 4) y -= h / 2;
+    else if ((datum & 12) == 8) y -= h;
+    if (w == 0) return;
+    if (w > maxWidth || x < 0 || y < 0 || x + w > lcd.width() || y + h > lcd.height())
+    {
+        drawDirect(lcd, s, x, y, 0, font, fg, bg);  // aligned already
+        return;
+    }
+
+    uint16_t row[maxWidth];
+    lcd.startWrite();
+    lcd.setAddrWindow(x, y, w, h);
+    for (int r = 0; r < h; r++)
+    {
+        uint16_t *px = row;
+        for (const char *p = s; *p; p++)
+        {
+            int g = *p - firstChar, gw = f->width[g];
+            const uint8_t *cell = _atlas + f->offset[g];
+            for (int c = 0, bit = r * gw; c < gw; c++, bit++)
+            {
+                *px++ = cell[bit >> 3] & (0x80 >> (bit & 7)) ? fg : bg;
+            }
+        }
+        lcd.writePixels(row, w, true);  // native RGB565, swapped for the panel
+    }
+    lcd.endWrite();
+    _stats.cached++;
+    _stats.usCached += micros() - usStart;
+    _stats.pixelsCached += w * h;
+}
+
+void UiGlyphs::drawDirect(LGFX &lcd, const char *s, int x, int y, uint8_t datum, const IFont *font,
+                          uint16_t fg, uint16_t bg)
+{
+    uint32_t usStart = micros();
+    lcd.setTextDatum(datum);
+    lcd.setTextColor(fg, bg);
+    lcd.setFont(font);
+    lcd.drawString(s, x, y);
+    _stats.direct++;
+    _stats.usDirect += micros() - usStart;
+    _stats.pixelsDirect += lcd.textWidth(s) * lcd.fontHeight();
+}
+
+/**
+ * Forget all glyphs, e.g. to measure the rasterisation again
+ */
+void UiGlyphs::clear()
+{
+    _fontCount = 0;
+    _used = 0;
+}
+
+// all glyphs of s are in the range of the atlas
+bool UiGlyphs::fits(const char *s)
+{
+    for (const char *p = s; *p; p++)
+    {
+        if (*p < firstChar || *p > lastChar) return false;
+    }
+    return true;
+}
+
+UiGlyphs::Font *UiGlyphs::findFont(LGFX &lcd, const IFont *font)
+{
+    for (int i = 0; i < _fontCount; i++)
+    {
+        if (_fonts[i].font == font) return &_fonts[i];
+    }
+    if (_fontCount == maxFonts) return nullptr;
+    Font &f = _fonts[_fontCount++];
+    lcd.setFont(font);
+    f.font = font;
+    f.height = lcd.fontHeight();
+    for (int g = 0; g < _glyphs; g++) f.offset[g] = _none;
+    return &f;
+}
+
+/**
+ * Draw the glyphs of s that are not in the atlas yet into a sprite, one
+ * at a time, and keep their set pixels. Returns false if one did not fit.
+ */
+bool UiGlyphs::rasterise(LGFX &lcd, Font &f, const char *s)
+{
+    LGFX_Sprite sprite(&lcd);
+    bool created = false;
+    char glyph[2] = { 0, 0 };
+    for (const char *p = s; *p; p++)
+    {
+        int g = *p - firstChar;
+        if (f.offset[g] != _none) continue;
+        if (! created)
+        {
+            sprite.setColorDepth(16);
+            sprite.setFont(f.font);
+            sprite.setTextDatum(textdatum_t::top_left);
+            sprite.setTextColor(TFT_WHITE, TFT_BLACK);
+            created = sprite.createSprite(sprite.textWidth("W") * 2, f.height) != nullptr;
+            if (! created) return false;
+        }
+        glyph[0] = *p;
+        int w = sprite.textWidth(glyph);
+        int bytes = (w * f.height + 7) / 8;
+        if (w > sprite.width() || _used + bytes > atlasBytes)
+        {
+            _stats.atlasFull++;
+            return false;
+        }
+        sprite.fillScreen(TFT_BLACK);
+        sprite.drawString(glyph, 0, 0);
+        uint8_t *cell = _atlas + _used;
+        memset(cell, 0, bytes);
+        for (int r = 0, bit = 0; r < f.height; r++)
+        {
+            for (int c = 0; c < w; c++, bit++)
+            {
+                if (sprite.readPixel(c, r) != TFT_BLACK) cell[bit >> 3] |= 0x80 >> (bit & 7);
+            }
+        }
+        f.width[g] = w;
+        f.offset[g] = _used;
+        _used += bytes;
+        _stats.rasterised++;
+    }
+    if (created) sprite.deleteSprite();
+    return true;
+}
+
+/**
+ * Strings and time per string from the atlas and from LGFX, and the memory
+ * of the atlas
+ */
+void UiGlyphs::printStats()
+{
+    const Stats &s = _stats;
+    int glyphs = 0;
+    for (int i = 0; i < _fontCount; i++)
+    {
+        for (int g = 0; g < _glyphs; g++) glyphs += _fonts[i].offset[g] != _none;
+    }
+    Serial.printf(R"(
+UI glyphs
+---------
+drawn by     strings   avg us   us/kpx
+atlas       %8u %8.1f %8.1f
+LGFX        %8u %8.1f %8.1f
+mode       %s
+atlas      %6d glyphs of %d fonts in %d of %d bytes, %u index bytes
+misses     %6u rasterised, %u did not fit
+)", s.cached, s.cached ? (double)s.usCached / s.cached : 0.0, s.pixelsCached ? s.usCached * 1000.0 / s.pixelsCached : 0.0,
+    s.direct, s.direct ? (double)s.usDirect / s.direct : 0.0, s.pixelsDirect ? s.usDirect * 1000.0 / s.pixelsDirect : 0.0,
+    _direct ? "direct" : "atlas", glyphs, _fontCount, _used, atlasBytes, (unsigned)sizeof(_fonts), s.rasterised, s.atlasFull);
+}
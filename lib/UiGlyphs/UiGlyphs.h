@@ -0,0 +1,82 @@
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+
+/**
+ * Class        UiGlyphs
+ *
+ * Purpose      Cache of the glyphs of the fonts the widgets draw with. A glyph
+ *              is rasterised once, the first time it is drawn, into a cell of
+ *              the font height and its advance width, 1 bit per pixel, and
+ *              kept in a fixed atlas. drawString() composes the text row by
+ *              row from the cells in the foreground and background colour and
+ *              sends it in one address window, where LovyanGFX sets a window
+ *              for every run of pixels of every glyph. The DejaVu GFXfonts
+ *              have 1 bit pixels, so the cells lose nothing, and since the
+ *              colours are applied while composing, one cell serves every
+ *              colour. The text is drawn with its background, the full cell
+ *              boxes, as drawString() does with two colours.
+ *              Text with a glyph outside ' '..'~', wider than maxWidth or
+ *              beyond the screen, and glyphs that no longer fit into the atlas
+ *              go to LGFX::drawString().
+ *
+ * Usage        uiGlyphs.drawString(lcd, "123.4", x, y, textdatum_t::middle_center,
+ *                                  &fonts::DejaVu18, TFT_WHITE, TFT_BLACK);
+ *              uiGlyphs.setDirect(true);   // all text with LGFX::drawString(), to compare
+ *              uiGlyphs.printStats();
+ */
+class UiGlyphs
+{
+    public:
+        static const int maxFonts = 3;
+        static const int atlasBytes = 6144;
+        static const int maxWidth = 320;     // pixels of a text line
+        static const char firstChar = ' ';
+        static const char lastChar = '~';
+
+        struct Stats
+        {
+            uint32_t cached;        // strings composed from the atlas
+            uint64_t usCached;
+            uint32_t pixelsCached;
+            uint32_t direct;        // strings drawn by LGFX
+            uint64_t usDirect;
+            uint32_t pixelsDirect;  // of the text boxes
+            uint32_t rasterised;    // glyphs added to the atlas
+            uint32_t atlasFull;     // glyphs that did not fit
+        };
+
+        void drawString(LGFX &lcd, const char *s, int x, int y, uint8_t datum, const IFont *font,
+                        uint16_t fg, uint16_t bg);
+        void setDirect(bool direct) { _direct = direct; }
+        bool isDirect() { return _direct; }
+        void clear();
+        const Stats &getStats() { return _stats; }
+        void printStats();
+
+    private:
+        static const int _glyphs = lastChar - firstChar + 1;
+        static const uint16_t _none = 0xffff;  // offset of a glyph that is not rasterised
+
+        struct Font
+        {
+            const IFont *font;
+            uint8_t height;
+            uint8_t width[_glyphs];
+            uint16_t offset[_glyphs];   // into _atlas
+        };
+
+        Font *findFont(LGFX &lcd, const IFont *font);
+        bool rasterise(LGFX &lcd, Font &f, const char *s);
+        bool fits(const char *s);
+        void drawDirect(LGFX &lcd, const char *s, int x, int y, uint8_t datum, const IFont *font,
+                        uint16_t fg, uint16_t bg);
+
+        Font     _fonts[maxFonts];
+        int      _fontCount;
+        uint8_t  _atlas[atlasBytes];    // cells of w x h bits, row by row
+        int      _used;                 // bytes of _atlas
+        bool     _direct;
+        Stats    _stats;
+};
+extern UiGlyphs uiGlyphs;
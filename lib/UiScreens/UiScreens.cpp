@@ -0,0 +1,123 @@
+#include "UiScreens.h"
+#include <algorithm>
+
+bool UiScreens::add(const char *name, Factory create, bool pooled)
+{
+    if (_count >= maxScreens)
+    {
+        log_e("==> no room for screen %s", name);
+        return false;
+    }
+    _screens[_count++] = { name, create, pooled, nullptr };
+    return true;
+}
+
+/**
+ * Switch to a screen: release or hide the panel of the current one, build
+ * the panel of the new one if it does not exist and paint it. The header
+ * is not painted again.
+ */
+bool UiScreens::show(const char *name)
+{
+    Screen *next = find(name);
+    if (next == nullptr)
+    {
+        log_e("==> no screen %s", name);
+        return false;
+    }
+    if (next == _current) return true;
+
+    Transition t{};
+    t.from  = current();
+    t.to    = next->name;
+    t.built = next->panel == nullptr;
+    t.freeBefore = t.freeMin = ESP.getFreeHeap();
+    uint32_t cyStart = ESP.getCycleCount();  // counts the construction in the simulator too
+    if (_current && _current->pooled)
+    {
+        _current->panel->setHidden(true);  // the new panel paints over it
+    }
+    else if (_current)
+    {
+        delete _current->panel;
+        _current->panel = nullptr;
+        t.freeMin = std::min(t.freeMin, ESP.getFreeHeap());
+    }
+    if (next->panel == nullptr)
+    {
+        next->panel = next->create();
+        t.freeMin = std::min(t.freeMin, ESP.getFreeHeap());
+        _builds++;
+    }
+    _current = next;
+    UiPanel::panels.clear();  // keeps its capacity, no allocation
+    if (_header) UiPanel::panels.push_back(_header);
+    UiPanel::panels.push_back(next->panel);
+    t.usBuild = (ESP.getCycleCount() - cyStart) / ESP.getCpuFreqMHz();
+    uint32_t usBuilt = micros();
+    UiPanel::waitForRelease();  // the finger that asked for the switch must not touch the new panel
+
+    next->panel->show();
+    t.usPaint = micros() - usBuilt;
+    t.freeAfter = ESP.getFreeHeap();
+    t.freeMin = std::min(t.freeMin, t.freeAfter);
+    _transitions[_switches++ % maxTransitions] = t;
+    log_i("screen %s -> %s in %u us", t.from, t.to, t.usBuild + t.usPaint);
+    return true;
+}
+
+/**
+ * Make the switch asked for with post()
+ */
+void UiScreens::loop()
+{
+    if (_posted == nullptr) return;
+    const char *name = _posted;
+    _posted = nullptr;
+    show(name);
+}
+
+/**
+ * The panel of a screen, nullptr if it is not built
+ */
+UiPanel *UiScreens::get(const char *name)
+{
+    Screen *s = find(name);
+    return s ? s->panel : nullptr;
+}
+
+UiScreens::Screen *UiScreens::find(const char *name)
+{
+    for (int i = 0; i < _count; i++)
+    {
+        if (strcasecmp(_screens[i].name, name) == 0) return &_screens[i];
+    }
+    return nullptr;
+}
+
+/**
+ * The last switches, latency and heap, and the state of every screen
+ */
+void UiScreens::printStats()
+{
+    Serial.printf(R"(
+UI screens
+----------
+from         to           built  build ms  paint ms  free before  min free  free after
+)");
+    int n = std::min<uint32_t>(_switches, maxTransitions);
+    for (int i = 0; i < n; i++)
+    {
+        const Transition &t = _transitions[(_switches - n + i) % maxTransitions];
+        Serial.printf("%-12s %-12s %5s %9.2f %9.2f %12u %9u %11u\n", t.from, t.to, t.built ? "yes" : "no",
+            t.usBuild / 1000.0, t.usPaint / 1000.0, t.freeBefore, t.freeMin, t.freeAfter);
+    }
+    Serial.printf("min free is sampled after the release, the build and the paint\n");
+    Serial.printf("switches   %6u, %u panels built\n", _switches, _builds);
+    for (int i = 0; i < _count; i++)
+    {
+        const Screen &s = _screens[i];
+        Serial.printf("%-12s %-8s %s\n", s.name, s.pooled ? "pooled" : "released",
+            &s == _current ? "shown" : s.panel ? "hidden" : "not built");
+    }
+}
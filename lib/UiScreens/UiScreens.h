@@ -0,0 +1,84 @@
+#pragma once
+#include <Arduino.h>
+#include "UiComponents.h"
+
+/**
+ * Class        UiScreens
+ *
+ * Purpose      The screens of the UI, each one a content panel below a
+ *              header panel that stays. A screen's panel is made by its
+ *              factory when the screen is shown the first time. When another
+ *              screen is shown the panel is deleted, which frees its widgets
+ *              and takes them out of the hit grid, or, for a pooled screen,
+ *              only marked hidden and kept for the next time. The old panel
+ *              is released before the new one is built, so the heap holds
+ *              one released screen at a time. The panels of all screens
+ *              cover the same area, only the new one is painted: a switch
+ *              costs one paint.
+ *              Every switch is recorded: the time to release and build, the
+ *              time to paint, the free heap before and after and the lowest
+ *              free heap of the samples after the release, the build and
+ *              the paint. The heap has no low-water mark that can be reset,
+ *              so a peak inside the construction is not seen. The build time
+ *              is counted in CPU cycles, which also count in the simulator,
+ *              where the clock of micros() only runs for the display.
+ *              A touch handler must not delete the panel it belongs to, it
+ *              asks for the switch with post() and loop() makes it.
+ *
+ * Usage        screens.setHeader(panelTitle);
+ *              screens.add("generator", createGenerator, true);  // pooled
+ *              screens.add("presets", createPresets);            // released when left
+ *              screens.show("generator");
+ *              in a touch handler: screens.post("presets");
+ *              loop: screens.loop();
+ *              screens.printStats();
+ */
+class UiScreens
+{
+    public:
+        using Factory = UiPanel *(*)();  // returns the panel hidden
+        static const int maxScreens = 6;
+        static const int maxTransitions = 8;
+
+        struct Transition
+        {
+            const char *from;       // "-": no screen yet
+            const char *to;
+            bool built;             // the panel of the screen was constructed
+            uint32_t usBuild;       // release of the old panel and construction, from the cycle count
+            uint32_t usPaint;
+            uint32_t freeBefore;    // heap bytes
+            uint32_t freeMin;       // sampled
+            uint32_t freeAfter;
+        };
+
+        void setHeader(UiPanel *header) { _header = header; }
+        bool add(const char *name, Factory create, bool pooled=false);
+        bool show(const char *name);
+        void post(const char *name) { _posted = name; }
+        void loop();
+        UiPanel *get(const char *name);
+        bool isShown(const char *name) { return _current && _current == find(name); }
+        const char *current() { return _current ? _current->name : "-"; }
+        void printStats();
+
+    private:
+        struct Screen
+        {
+            const char *name;
+            Factory create;
+            bool pooled;
+            UiPanel *panel;         // nullptr: not built
+        };
+
+        Screen *find(const char *name);
+
+        UiPanel *_header = nullptr;
+        Screen _screens[maxScreens];
+        int _count = 0;
+        Screen *_current = nullptr;
+        const char *_posted = nullptr;
+        Transition _transitions[maxTransitions];  // the last ones
+        uint32_t _switches = 0;
+        uint32_t _builds = 0;
+};
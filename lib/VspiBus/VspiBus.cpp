@@ -0,0 +1,103 @@
+#include "VspiBus.h"
+#include "esp_timer.h"
+#include "soc/gpio_sig_map.h"
+
+static SemaphoreHandle_t busMutex = nullptr;
+static portMUX_TYPE busMux = portMUX_INITIALIZER_UNLOCKED;
+
+// The fields below are only touched by the task that owns the bus
+static int       depth = 0;                 // nesting level of the owner
+static VspiDevice routed = VspiDevice::TOUCH;
+static int64_t   usAcquired = 0;
+static VspiStats stats[2];
+
+static void route(VspiDevice device)
+{
+    pinMatrixInAttach(device == VspiDevice::SDCARD ? TF_MISO : TP_MISO, VSPIQ_IN_IDX, false);
+    routed = device;
+}
+
+/**
+ * The mutex is created on first use, that may happen in any task
+ */
+static SemaphoreHandle_t getMutex()
+{
+    if (busMutex) return busMutex;
+    SemaphoreHandle_t m = xSemaphoreCreateRecursiveMutex();
+    portENTER_CRITICAL(&busMux);
+    if (! busMutex)
+    {
+        busMutex = m;
+        m = nullptr;
+    }
+    portEXIT_CRITICAL(&busMux);
+    if (m) vSemaphoreDelete(m);  // another task was faster
+    return busMutex;
+}
+
+/**
+ * Take the bus for device, waiting at most ticksToWait.
+ * Returns false if the bus is owned by another task.
+ */
+bool vspiAcquire(VspiDevice device, TickType_t ticksToWait)
+{
+    VspiStats &s = stats[(int)device];
+    int64_t usStart = esp_timer_get_time();
+    if (xSemaphoreTakeRecursive(getMutex(), ticksToWait) != pdTRUE)
+    {
+        portENTER_CRITICAL(&busMux);  // the owner does not touch this counter
+        s.skipped++;
+        portEXIT_CRITICAL(&busMux);
+        return false;
+    }
+
+    int64_t usNow = esp_timer_get_time();
+    if (depth++ == 0)
+    {
+        uint32_t usWait = usNow - usStart;
+        s.transactions++;
+        s.usWait += usWait;
+        s.usMaxWait = std::max(s.usMaxWait, usWait);
+        usAcquired = usNow;
+    }
+    if (routed != device) route(device);
+    return true;
+}
+
+/**
+ * End the transaction started with vspiAcquire(device). When the outermost
+ * transaction ends, MISO is routed back to the touch controller.
+ */
+void vspiRelease(VspiDevice device)
+{
+    if (--depth == 0)
+    {
+        stats[(int)device].usBusy += esp_timer_get_time() - usAcquired;
+        if (routed != VspiDevice::TOUCH) route(VspiDevice::TOUCH);
+    }
+    xSemaphoreGiveRecursive(busMutex);
+}
+
+const VspiStats &vspiGetStats(VspiDevice device)
+{
+    return stats[(int)device];
+}
+
+void vspiPrintStats()
+{
+    const VspiStats &t = stats[(int)VspiDevice::TOUCH];
+    const VspiStats &c = stats[(int)VspiDevice::SDCARD];
+    double msUp = esp_timer_get_time() / 1000.0;
+    Serial.printf(R"(
+VSPI Bus             touch     sdcard
+--------
+transactions    %10u %10u
+skipped         %10u %10u
+busy            %10.1f %10.1f ms
+utilisation     %10.2f %10.2f %%
+wait            %10.1f %10.1f ms
+max wait        %10u %10u us
+)", t.transactions, c.transactions, t.skipped, c.skipped,
+    t.usBusy / 1000.0, c.usBusy / 1000.0, t.usBusy / 10.0 / msUp, c.usBusy / 10.0 / msUp,
+    t.usWait / 1000.0, c.usWait / 1000.0, t.usMaxWait, c.usMaxWait);
+}
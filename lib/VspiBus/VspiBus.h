@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * File         VspiBus.h
+ *
+ * Purpose      The touch controller (TP_SCLK, TP_MISO, TP_MOSI) and the SD card
+ *              (TF_SCLK, TF_MISO, TF_MOSI) both use the VSPI peripheral, but on
+ *              different pins. The clock and data outputs can be routed to both
+ *              pin sets at once, the MISO input however only from one pin.
+ *              Whoever initializes last wins: after SD.begin() the touch
+ *              controller reads the MISO line of the SD card and vice versa.
+ *
+ *              The bus is arbitrated in transactions. A transaction takes the
+ *              bus, routes MISO to its device and hands the bus back to the
+ *              touch controller when it ends. Tasks waiting for the bus are
+ *              served in order of priority, then first come first served.
+ *              Long SD card jobs should use one transaction per block, so the
+ *              touch controller gets the bus in between. The touch poll of the
+ *              main loop does not wait: while the SD card owns the bus the
+ *              poll is skipped.
+ *              The display has HSPI to itself and needs no arbitration.
+ *
+ *              Per device the number of transactions, skipped attempts, the
+ *              time the bus was owned and the time spent waiting for it are
+ *              counted.
+ *
+ * Usage        {
+ *                  VspiTransaction bus(VspiDevice::SDCARD);  // waits for the bus
+ *                  file.write(buf, len);
+ *              }
+ *              VspiTransaction bus(VspiDevice::TOUCH, 0);    // does not wait
+ *              if (bus && lcd.getTouch(&x, &y)) ...
+ */
+enum class VspiDevice { TOUCH, SDCARD };
+
+struct VspiStats
+{
+    uint32_t transactions;  // transactions that got the bus
+    uint32_t skipped;       // attempts that gave up because the bus was busy
+    uint64_t usBusy;        // time the device owned the bus
+    uint64_t usWait;        // time spent waiting for the bus
+    uint32_t usMaxWait;     // longest wait
+};
+
+bool vspiAcquire(VspiDevice device, TickType_t ticksToWait=portMAX_DELAY);
+void vspiRelease(VspiDevice device);
+const VspiStats &vspiGetStats(VspiDevice device);
+void vspiPrintStats();
+
+/**
+ * Owns the bus from construction to destruction if the bus could be
+ * acquired within ticksToWait. Transactions of the same task may be nested.
+ */
+class VspiTransaction
+{
+    public:
+        VspiTransaction(VspiDevice device, TickType_t ticksToWait=portMAX_DELAY) :
+            _device(device), _owned(vspiAcquire(device, ticksToWait))
+        {}
+        ~VspiTransaction() { if (_owned) vspiRelease(_device); }
+        explicit operator bool() const { return _owned; }
+
+        VspiTransaction(const VspiTransaction &) = delete;
+        VspiTransaction &operator=(const VspiTransaction &) = delete;
+
+    private:
+        VspiDevice _device;
+        bool _owned;
+};
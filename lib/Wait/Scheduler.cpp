@@ -0,0 +1,230 @@
+#include "Scheduler.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "esp_timer.h"
+
+static TaskHandle_t loopTask = nullptr;
+
+static void taskSleep(int64_t usMax)
+{
+    loopTask = xTaskGetCurrentTaskHandle();
+    TickType_t ticks = usMax / (1000 * portTICK_PERIOD_MS);  // a sleep shorter than a tick returns at once
+    if (ticks > 0) ulTaskNotifyTake(pdTRUE, ticks);
+}
+#endif
+
+Scheduler::Scheduler(Clock clock, Sleep sleep) : _clock(clock), _sleep(sleep)
+{
+#ifdef ARDUINO
+    if (! _clock) _clock = esp_timer_get_time;
+    if (! _sleep) _sleep = taskSleep;
+#endif
+}
+
+/**
+ * Run job every usPeriod microseconds, the first time at usFirst (default: 
+ * one period from now). Returns the id of the job or -1 if all slots are used.
+ */
+int Scheduler::every(uint32_t usPeriod, Job job, void *arg, const char *name, int64_t usFirst)
+{
+    if (usPeriod == 0) return -1;
+    return add(usPeriod, usFirst >= 0 ? usFirst : _clock() + usPeriod, job, arg, name);
+}
+
+/**
+ * Run job once, usDelay microseconds from now
+ */
+int Scheduler::after(uint32_t usDelay, Job job, void *arg, const char *name)
+{
+    return add(0, _clock() + usDelay, job, arg, name);
+}
+
+int Scheduler::add(uint32_t usPeriod, int64_t usDeadline, Job job, void *arg, const char *name)
+{
+    for (int id = 0; id < maxJobs; id++)
+    {
+        if (_used[id]) continue;
+        _used[id] = true;
+        _jobs[id] = { job, arg, usDeadline, usPeriod, -1, ++_serial, { name, 0, 0, 0, 0, 0, 0 } };
+        push(id);
+        return id;
+    }
+    return -1;
+}
+
+void Scheduler::cancel(int id)
+{
+    if (id < 0 || id >= maxJobs || ! _used[id]) return;
+    if (_jobs[id].heapPos >= 0) remove(id);
+    _used[id] = false;
+}
+
+bool Scheduler::isScheduled(int id)
+{
+    return id >= 0 && id < maxJobs && _used[id];
+}
+
+/**
+ * Run the jobs that were due when run() was called, earliest deadline first.
+ * Returns the number of jobs run. Jobs that become due meanwhile, also those
+ * a job schedules for now, wait for the next call, so a job that runs longer
+ * than its period cannot keep run() from returning.
+ */
+int Scheduler::run()
+{
+    int count = 0;
+    const int64_t usCall = _clock();
+    int64_t usNow = usCall;  // start of the next job
+    while (_size > 0 && _jobs[_heap[0]].usDeadline <= usCall)
+    {
+        int id = _heap[0];
+        Entry &e = _jobs[id];
+        remove(id);
+
+        Stats &s = e.stats;
+        uint32_t usLate = usNow - e.usDeadline;
+        s.usTotalLate += usLate;
+        if (usLate > s.usMaxLate) s.usMaxLate = usLate;
+        if (e.usPeriod > 0)  // reschedule before running, the job may cancel itself
+        {
+            e.usDeadline += e.usPeriod;
+            if (e.usDeadline <= usNow)
+            {
+                int64_t missed = (usNow - e.usDeadline) / e.usPeriod + 1;
+                s.skipped += missed;
+                e.usDeadline += missed * e.usPeriod;
+            }
+            push(id);
+        }
+        else
+        {
+            _used[id] = false;
+        }
+
+        // the job may cancel itself or free its slot for a new job, e is not its own after the call
+        Job job = e.job;
+        void *arg = e.arg;
+        uint32_t serial = e.serial;
+        job(arg);
+        int64_t usEnd = _clock();
+        if (_used[id] && _jobs[id].serial == serial)
+        {
+            uint32_t usRun = usEnd - usNow;
+            s.runs++;
+            s.usTotalRun += usRun;
+            if (usRun > s.usMaxRun) s.usMaxRun = usRun;
+        }
+        usNow = usEnd;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Microseconds until the next deadline, 0 if a job is due, -1 if there is none
+ */
+int64_t Scheduler::usUntilNext()
+{
+    if (_size == 0) return -1;
+    int64_t us = _jobs[_heap[0]].usDeadline - _clock();
+    return us > 0 ? us : 0;
+}
+
+/**
+ * Sleep until the next deadline, at most usMax microseconds
+ */
+void Scheduler::idle(int64_t usMax)
+{
+    int64_t us = usUntilNext();
+    if (us < 0 || us > usMax) us = usMax;
+    if (us <= 0 || ! _sleep) return;
+    int64_t usStart = _clock();
+    _sleep(us);
+    _usIdle += _clock() - usStart;
+    _idles++;
+}
+
+/**
+ * End the sleep of idle() early. May be called from another task.
+ */
+void Scheduler::wake()
+{
+#ifdef ARDUINO
+    if (loopTask) xTaskNotifyGive(loopTask);
+#endif
+}
+
+bool Scheduler::getStats(int id, Stats &s)
+{
+    if (id < 0 || id >= maxJobs) return false;
+    s = _jobs[id].stats;
+    return _used[id];
+}
+
+void Scheduler::printStats()
+{
+    printf("\nScheduler\n---------\n");
+    printf("job            runs  skipped  avg run us  max run us  avg late us  max late us\n");
+    for (int id = 0; id < maxJobs; id++)
+    {
+        if (! _used[id]) continue;
+        const Stats &s = _jobs[id].stats;
+        printf("%-12s %6u %8u %11u %11u %12u %12u\n", s.name, s.runs, s.skipped,
+            s.runs ? (uint32_t)(s.usTotalRun / s.runs) : 0, s.usMaxRun,
+            s.runs ? (uint32_t)(s.usTotalLate / s.runs) : 0, s.usMaxLate);
+    }
+    printf("idle %u times, %.1f ms\n", _idles, _usIdle / 1000.0);
+}
+
+// --- binary heap of job ids ordered by deadline ---
+
+void Scheduler::push(int id)
+{
+    _heap[_size] = id;
+    _jobs[id].heapPos = _size;
+    siftUp(_size++);
+}
+
+void Scheduler::remove(int id)
+{
+    int i = _jobs[id].heapPos;
+    _jobs[id].heapPos = -1;
+    if (--_size == i) return;
+    _heap[i] = _heap[_size];
+    _jobs[_heap[i]].heapPos = i;
+    siftUp(i);
+    siftDown(_jobs[_heap[i]].heapPos);
+}
+
+void Scheduler::swap(int a, int b)
+{
+    int t = _heap[a];
+    _heap[a] = _heap[b];
+    _heap[b] = t;
+    _jobs[_heap[a]].heapPos = a;
+    _jobs[_heap[b]].heapPos = b;
+}
+
+void Scheduler::siftUp(int i)
+{
+    while (i > 0 && before(i, (i - 1) / 2))
+    {
+        swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void Scheduler::siftDown(int i)
+{
+    while (true)
+    {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < _size && before(l, m)) m = l;
+        if (r < _size && before(r, m)) m = r;
+        if (m == i) return;
+        swap(i, m);
+        i = m;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Class        Scheduler
+ *
+ * Purpose      Cooperative scheduler for periodic and one-shot jobs in loop().
+ *              Deadlines are 64 bit microseconds of esp_timer and are kept in
+ *              a heap, so run() only looks at the jobs that are due. Periodic
+ *              jobs are rescheduled from their deadline, not from the time they
+ *              ran, and do not drift; if a job falls behind by whole periods,
+ *              the missed runs are skipped and counted.
+ *              idle() sleeps until the next deadline. wake() ends the sleep
+ *              early, e.g. from a serial receive callback.
+ *              For every job the number of runs, the run time and the lateness
+ *              (start - deadline) are measured.
+ *              Clock and sleep function can be replaced, e.g. by a fake clock
+ *              to run the scheduler on the host.
+ *
+ * Usage        Scheduler scheduler;
+ *              scheduler.every(100000, pollTouch, nullptr, "touch");  // every 100 ms
+ *              scheduler.after(2000000, fallback, nullptr, "baud");   // once in 2 s
+ *              void loop()
+ *              {
+ *                  scheduler.run();
+ *                  scheduler.idle();
+ *              }
+ */
+class Scheduler
+{
+    public:
+        using Job   = void (*)(void *arg);
+        using Clock = int64_t (*)();             // microseconds
+        using Sleep = void (*)(int64_t usMax);   // sleeps at most usMax, may return earlier
+
+        static const int maxJobs = 16;
+
+        Scheduler(Clock clock=nullptr, Sleep sleep=nullptr);
+
+        int  every(uint32_t usPeriod, Job job, void *arg=nullptr, const char *name="", int64_t usFirst=-1);
+        int  after(uint32_t usDelay, Job job, void *arg=nullptr, const char *name="");
+        void cancel(int id);
+        bool isScheduled(int id);
+        int  run();
+        int64_t usUntilNext();
+        void idle(int64_t usMax=1000000);
+        void wake();
+        void printStats();
+
+        struct Stats
+        {
+            const char *name;
+            uint32_t runs;
+            uint32_t skipped;     // periods missed because the job was late
+            uint32_t usMaxRun;
+            uint64_t usTotalRun;
+            uint32_t usMaxLate;
+            uint64_t usTotalLate;
+        };
+        bool getStats(int id, Stats &s);
+
+    private:
+        struct Entry
+        {
+            Job      job;
+            void    *arg;
+            int64_t  usDeadline;
+            uint32_t usPeriod;    // 0 for one-shot jobs
+            int      heapPos;     // -1 if not scheduled
+            uint32_t serial;      // tells a job from a later one in the same slot
+            Stats    stats;
+        };
+
+        int  add(uint32_t usPeriod, int64_t usDeadline, Job job, void *arg, const char *name);
+        void push(int id);
+        void remove(int id);
+        void swap(int a, int b);
+        void siftUp(int i);
+        void siftDown(int i);
+        bool before(int a, int b) { return _jobs[_heap[a]].usDeadline < _jobs[_heap[b]].usDeadline; }
+
+        Clock _clock;
+        Sleep _sleep;
+        Entry _jobs[maxJobs];
+        bool  _used[maxJobs] = {};
+        int   _heap[maxJobs];     // ids, earliest deadline first
+        int   _size = 0;
+        uint32_t _serial = 0;
+        uint32_t _idles = 0;
+        uint64_t _usIdle = 0;
+};
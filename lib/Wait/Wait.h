@@ -8,6 +8,10 @@
  * Purpose      Implements a class to wait without delay.
  *              Returns the result true as soon as the msWait milliseconds
  *              specified in the constructor have elapsed.
+ *              The next period starts where the previous one ended, so a
+ *              periodic job does not drift. If a whole period was missed,
+ *              the next one starts now instead of firing repeatedly.
+ *              For several periodic jobs see Scheduler.h.
  * 
  * Usage        void doSomething() { Serial.println("Hello world"); }
  *              Wait waitForSomething(5000);
@@ -22,7 +26,13 @@ class Wait
     public:
         Wait(uint32_t msWait) : _msWait(msWait){};
         void begin() { _msPrevious = millis(); }
-        bool isOver() { return (millis() - _msPrevious >= _msWait) ? (_msPrevious = millis(), true) : false; }
+        bool isOver() 
+        { 
+            if (millis() - _msPrevious < _msWait) return false;
+            _msPrevious += _msWait;
+            if (millis() - _msPrevious >= _msWait) _msPrevious = millis();  // fell behind, resynchronize
+            return true;
+        }
         void msWaitSet(uint32_t msWait) {_msWait = msWait;}
 
     private:
@@ -39,7 +49,10 @@ class Wait
  * Remarks      This is a simple class-less version of Wait defined above,
  *              but a reference to a static variable &msPrevious is needed.  
  */
-bool waitIsOver(uint32_t &msPrevious, uint32_t msWait) 
+inline bool waitIsOver(uint32_t &msPrevious, uint32_t msWait) 
 {
-  return (millis() - msPrevious >= msWait) ? (msPrevious = millis(), true) : false;
-}
\ No newline at end of file
+  if (millis() - msPrevious < msWait) return false;
+  msPrevious += msWait;
+  if (millis() - msPrevious >= msWait) msPrevious = millis();  // fell behind, resynchronize
+  return true;
+}
@@ -11,9 +11,66 @@
 #pragma once
 #include <LovyanGFX.hpp>
 
+// Traffic to the ILI9341 since the start, for the UI benchmark (UiBench).
+// Take the difference of two readings.
+struct BusCounters
+{
+  uint32_t transactions = 0;  // about one per drawing call, unless it is inside startWrite()/endWrite()
+  uint32_t windows = 0;       // address windows set (RAMWR commands)
+  uint32_t pixels = 0;        // pixels written
+  uint32_t bytesWritten = 0;  // commands, parameters and pixel data
+  uint32_t bytesRead = 0;
+};
+
+// The SPI bus of the display, counting what passes through it
+class Bus_SPI_Counting : public lgfx::Bus_SPI {
+public:
+  BusCounters counters;
+
+  void beginTransaction(void) override {
+    counters.transactions++;
+    lgfx::Bus_SPI::beginTransaction();
+  }
+  bool writeCommand(uint32_t data, uint_fast8_t bit_length) override {
+    if ((data & 0xff) == 0x2c) counters.windows++;  // RAMWR follows CASET and RASET
+    counters.bytesWritten += bit_length >> 3;
+    return lgfx::Bus_SPI::writeCommand(data, bit_length);
+  }
+  void writeData(uint32_t data, uint_fast8_t bit_length) override {
+    counters.bytesWritten += bit_length >> 3;
+    lgfx::Bus_SPI::writeData(data, bit_length);
+  }
+  void writeDataRepeat(uint32_t data, uint_fast8_t bit_length, uint32_t count) override {
+    counters.pixels += count;
+    counters.bytesWritten += (bit_length >> 3) * count;
+    lgfx::Bus_SPI::writeDataRepeat(data, bit_length, count);
+  }
+  void writePixels(lgfx::pixelcopy_t* pc, uint32_t length) override {
+    counters.pixels += length;
+    counters.bytesWritten += (pc->dst_bits >> 3) * length;
+    lgfx::Bus_SPI::writePixels(pc, length);
+  }
+  void writeBytes(const uint8_t* data, uint32_t length, bool dc, bool use_dma) override {
+    counters.bytesWritten += length;
+    lgfx::Bus_SPI::writeBytes(data, length, dc, use_dma);
+  }
+  uint32_t readData(uint_fast8_t bit_length) override {
+    counters.bytesRead += bit_length >> 3;
+    return lgfx::Bus_SPI::readData(bit_length);
+  }
+  bool readBytes(uint8_t* dst, uint32_t length, bool use_dma) override {
+    counters.bytesRead += length;
+    return lgfx::Bus_SPI::readBytes(dst, length, use_dma);
+  }
+  void readPixels(void* dst, lgfx::pixelcopy_t* pc, uint32_t length) override {
+    counters.bytesRead += (pc->src_bits >> 3) * length;
+    lgfx::Bus_SPI::readPixels(dst, pc, length);
+  }
+};
+
 class LGFX : public lgfx::LGFX_Device {
   lgfx::Panel_ILI9341 _panel_instance;
-  lgfx::Bus_SPI       _bus_instance;
+  Bus_SPI_Counting    _bus_instance;
   lgfx::Light_PWM     _light_instance;
   lgfx::Touch_XPT2046 _touch_instance;
 public:
@@ -89,4 +146,6 @@ public:
     
     setPanel(&_panel_instance);  // set the panel to be used.
   }
+
+  BusCounters getBusCounters() { return _bus_instance.counters; }
 };         
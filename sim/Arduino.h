@@ -0,0 +1,233 @@
+#pragma once
+
+/**
+ * File         Arduino.h (simulator)
+ *
+ * Purpose      The part of the Arduino ESP32 core the firmware uses, for the
+ *              host simulator (env:native). Time is virtual: it advances when
+ *              the firmware sleeps or waits and by the modelled SPI transfer
+ *              time of the display (see SimDisplay.cpp), so a run is
+ *              reproducible. Each clock read on the main thread costs 1 us,
+ *              which ends busy waits on millis().
+ *              Serial writes to stdout and reads what the script feeds it.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+using std::min;
+using std::max;
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0x01
+#define OUTPUT  0x03
+#define INPUT_PULLUP 0x05
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+// pins of the board, defined by the board file on the target
+#define TF_CS   5
+#define TF_MISO 19
+#define TF_MOSI 23
+#define TF_SCLK 18
+#define TP_IRQ  36
+#define TP_MISO 39
+#define SPEAK   26
+
+#ifndef CORE_DEBUG_LEVEL
+#define CORE_DEBUG_LEVEL 3
+#endif
+void simLog(char level, const char *file, int line, const char *func, const char *format, ...) __attribute__((format(printf, 5, 6)));
+#define log_e(format, ...) (CORE_DEBUG_LEVEL >= 1 ? simLog('E', __FILE__, __LINE__, __func__, format, ##__VA_ARGS__) : (void)0)
+#define log_w(format, ...) (CORE_DEBUG_LEVEL >= 2 ? simLog('W', __FILE__, __LINE__, __func__, format, ##__VA_ARGS__) : (void)0)
+#define log_i(format, ...) (CORE_DEBUG_LEVEL >= 3 ? simLog('I', __FILE__, __LINE__, __func__, format, ##__VA_ARGS__) : (void)0)
+#define log_d(format, ...) (CORE_DEBUG_LEVEL >= 4 ? simLog('D', __FILE__, __LINE__, __func__, format, ##__VA_ARGS__) : (void)0)
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+void pinMatrixInAttach(uint8_t pin, uint8_t signal, bool inverted);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+long random(long max);
+long random(long min, long max);
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String
+{
+    public:
+        String(const char *s = "") : _s(s ? s : "") {}
+        String(const std::string &s) : _s(s) {}
+        String(char c) : _s(1, c) {}
+        String(int v)            : _s(std::to_string(v)) {}
+        String(unsigned v)       : _s(std::to_string(v)) {}
+        String(long v)           : _s(std::to_string(v)) {}
+        String(unsigned long v)  : _s(std::to_string(v)) {}
+        String(double v, unsigned decimals = 2) { char b[48]; snprintf(b, sizeof(b), "%.*f", decimals, v); _s = b; }
+        String(float v, unsigned decimals = 2) : String((double)v, decimals) {}
+
+        const char *c_str() const { return _s.c_str(); }
+        unsigned length() const { return _s.size(); }
+        bool reserve(unsigned n) { _s.reserve(n); return true; }
+        char charAt(unsigned i) const { return i < _s.size() ? _s[i] : 0; }
+        char operator[](unsigned i) const { return charAt(i); }
+
+        long   toInt() const    { return atol(_s.c_str()); }
+        double toDouble() const { return atof(_s.c_str()); }
+        float  toFloat() const  { return atof(_s.c_str()); }
+
+        int indexOf(char c, unsigned from = 0) const { size_t p = _s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+        int indexOf(const String &s, unsigned from = 0) const { size_t p = _s.find(s._s, from); return p == std::string::npos ? -1 : (int)p; }
+        int lastIndexOf(char c) const { size_t p = _s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+        String substring(unsigned from) const { return from < _s.size() ? _s.substr(from) : ""; }
+        String substring(unsigned from, unsigned to) const
+        {
+            if (from > to) std::swap(from, to);
+            return from < _s.size() ? _s.substr(from, to - from) : "";
+        }
+        bool startsWith(const String &p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+        bool endsWith(const String &p) const { return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0; }
+        bool equals(const String &s) const { return _s == s._s; }
+        bool equalsIgnoreCase(const String &s) const { return strcasecmp(_s.c_str(), s._s.c_str()) == 0; }
+        void toUpperCase() { for (char &c : _s) c = toupper(c); }
+        void toLowerCase() { for (char &c : _s) c = tolower(c); }
+        void trim()
+        {
+            size_t a = _s.find_first_not_of(" \t\r\n");
+            size_t b = _s.find_last_not_of(" \t\r\n");
+            _s = a == std::string::npos ? "" : _s.substr(a, b - a + 1);
+        }
+
+        String &operator+=(const String &s) { _s += s._s; return *this; }
+        String &operator+=(const char *s) { _s += s; return *this; }
+        String &operator+=(char c) { _s += c; return *this; }
+        friend String operator+(const String &a, const String &b) { return a._s + b._s; }
+        friend String operator+(const String &a, const char *b) { return a._s + b; }
+        friend String operator+(const char *a, const String &b) { return a + b._s; }
+        bool operator==(const String &s) const { return _s == s._s; }
+        bool operator==(const char *s) const { return _s == s; }
+        bool operator!=(const String &s) const { return _s != s._s; }
+        bool operator!=(const char *s) const { return _s != s; }
+        bool operator<(const String &s) const { return _s < s._s; }
+
+    private:
+        std::string _s;
+};
+
+class Print
+{
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size)
+        {
+            for (size_t i = 0; i < size; i++) write(buffer[i]);
+            return size;
+        }
+        size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+        virtual void flush() {}
+
+        size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s) { return write(s); }
+        size_t print(const String &s) { return write(s.c_str()); }
+        size_t print(char c) { return write((uint8_t)c); }
+        size_t print(int v) { return printf("%d", v); }
+        size_t print(unsigned v) { return printf("%u", v); }
+        size_t print(long v) { return printf("%ld", v); }
+        size_t print(unsigned long v) { return printf("%lu", v); }
+        size_t print(double v, int decimals = 2) { return printf("%.*f", decimals, v); }
+        size_t println() { return write("\r\n"); }
+        template <typename T> size_t println(const T &v) { return print(v) + println(); }
+        size_t println(double v, int decimals) { return print(v, decimals) + println(); }
+};
+
+class Stream : public Print
+{
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        size_t readBytes(uint8_t *buffer, size_t length);
+        size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+        String readStringUntil(char terminator);
+        void setTimeout(unsigned long ms) { _msTimeout = ms; }
+
+    protected:
+        unsigned long _msTimeout = 1000;
+};
+
+class HardwareSerial : public Stream
+{
+    public:
+        void begin(unsigned long baud) { _baud = baud; }
+        void end() {}
+        void updateBaudRate(unsigned long baud) { _baud = baud; }
+        uint32_t baudRate() { return _baud; }
+        size_t setRxBufferSize(size_t n) { return n; }
+        size_t setTxBufferSize(size_t n) { return n; }
+        void onReceive(std::function<void(void)> cb, bool onlyOnTimeout = false) { _onReceive = cb; }
+        operator bool() const { return true; }
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buffer, size_t size) override;
+        using Print::write;
+        int available() override;
+        int read() override;
+        int peek() override;
+        void flush() override;
+        int availableForWrite() { return 4096; }
+
+        void simFeed(const char *data, size_t len);  // input from the script
+
+    private:
+        unsigned long _baud = 115200;
+        std::string _rx;
+        std::function<void(void)> _onReceive;
+};
+extern HardwareSerial Serial;
+
+size_t simHeapUsed();  // bytes allocated with new and not deleted, see SimCore.cpp
+
+class EspClass
+{
+    public:
+        uint32_t getHeapSize()    { return 327680; }
+        uint32_t getFreeHeap()    { return getHeapSize() - std::min<size_t>(simHeapUsed(), getHeapSize()); }
+        uint32_t getMinFreeHeap() { return getFreeHeap(); }
+        uint32_t getMaxAllocHeap(){ return 110000; }
+        uint32_t getCycleCount();  // of the host CPU time, the sim clock does not count computing
+        uint32_t getCpuFreqMHz()  { return 240; }
+        void restart();
+};
+extern EspClass ESP;
+
+// setup() and loop() of the firmware, called by sim_main.cpp
+void setup();
+void loop();
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+// File system of the simulator. No card is inserted, see SD.h: every open 
+// fails and File objects stay invalid.
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+namespace fs
+{
+    class File : public Stream
+    {
+        public:
+            size_t write(uint8_t) override { return 0; }
+            size_t write(const uint8_t *, size_t) override { return 0; }
+            using Print::write;
+            int available() override { return 0; }
+            int read() override { return -1; }
+            int peek() override { return -1; }
+            size_t read(uint8_t *, size_t) { return 0; }
+            void flush() override {}
+            bool seek(uint32_t, SeekMode = SeekSet) { return false; }
+            size_t position() const { return 0; }
+            size_t size() const { return 0; }
+            void close() {}
+            operator bool() const { return false; }
+            const char *name() const { return ""; }
+            const char *path() const { return ""; }
+            bool isDirectory() { return false; }
+            File openNextFile(const char * = FILE_READ) { return File(); }
+            size_t readBytesUntil(char, char *, size_t) { return 0; }
+    };
+
+    class FS
+    {
+        public:
+            File open(const char *, const char * = FILE_READ, bool = false) { return File(); }
+            File open(const String &path, const char *mode = FILE_READ, bool create = false) { return open(path.c_str(), mode, create); }
+            bool exists(const char *) { return false; }
+            bool mkdir(const char *) { return false; }
+            bool remove(const char *) { return false; }
+            bool rename(const char *, const char *) { return false; }
+            bool rmdir(const char *) { return false; }
+    };
+}
+using fs::File;
@@ -0,0 +1,235 @@
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+/**
+ * File         LovyanGFX.hpp (simulator)
+ *
+ * Purpose      The part of LovyanGFX the firmware uses, drawing into an RGB565
+ *              framebuffer in memory. Every primitive is counted with the
+ *              pixels it touches and the bytes it would send to the ILI9341:
+ *              11 bytes to set the address window (CASET, RASET, RAMWR) per
+ *              run of pixels, 2 bytes per pixel written, 3 per pixel read.
+ *              The virtual clock advances by the transfer time at the SPI
+ *              clocks of the board (40 MHz write, 16 MHz read).
+ *              Text is drawn with a built-in 3x5 pixel font scaled to the
+ *              size of the DejaVu font, so the layout and the cost are close,
+ *              the glyphs are not.
+ *              Pixels written with setAddrWindow() and writePixels() between
+ *              startWrite() and endWrite() count as one call. LGFX_Sprite
+ *              draws into memory only, it is not counted and takes no time.
+ */
+
+namespace lgfx { inline namespace v1 {
+
+struct rgb565_t  { uint16_t raw; };
+struct swap565_t { uint16_t raw; };
+struct rgb888_t  { uint8_t b, g, r; };
+struct bgr888_t  { uint8_t r, g, b; };
+
+#pragma pack(push, 1)
+struct bitmap_header_t
+{
+    uint16_t bfType;
+    uint32_t bfSize;
+    uint16_t bfReserved1;
+    uint16_t bfReserved2;
+    uint32_t bfOffBits;
+    uint32_t biSize;
+    int32_t  biWidth;
+    int32_t  biHeight;
+    uint16_t biPlanes;
+    uint16_t biBitCount;
+    uint32_t biCompression;
+    uint32_t biSizeImage;
+    int32_t  biXPelsPerMeter;
+    int32_t  biYPelsPerMeter;
+    uint32_t biClrUsed;
+    uint32_t biClrImportant;
+};
+#pragma pack(pop)
+
+struct IFont {};
+struct GFXfont : IFont
+{
+    uint8_t size;       // pixel size of the DejaVu font it stands for
+    constexpr GFXfont(uint8_t size = 18) : size(size) {}
+};
+namespace fonts
+{
+    extern const GFXfont Font0, DejaVu9, DejaVu12, DejaVu18, DejaVu24;
+}
+
+enum textdatum_t : uint8_t
+{
+    top_left = 0, top_center = 1, top_right = 2,
+    middle_left = 4, middle_center = 5, middle_right = 6,
+    bottom_left = 8, bottom_center = 9, bottom_right = 10,
+    baseline_left = 16, baseline_center = 17, baseline_right = 18
+};
+namespace textdatum
+{
+    enum : uint8_t { TL_DATUM = 0, TC_DATUM = 1, TR_DATUM = 2, ML_DATUM = 4, MC_DATUM = 5, MR_DATUM = 6, BL_DATUM = 8, BC_DATUM = 9, BR_DATUM = 10 };
+}
+
+/**
+ * Counters of the simulated display
+ */
+struct DrawStats
+{
+    struct Primitive { uint32_t calls; uint64_t pixels; uint64_t bytes; };
+    std::map<std::string, Primitive> primitives;
+    uint32_t calls = 0;
+    uint64_t pixelsWritten = 0;
+    uint64_t pixelsRead = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t bytesRead = 0;
+    uint32_t windows = 0;      // address windows set
+    uint64_t usSpi = 0;        // modelled transfer time
+
+    void print(const char *title = "Display");
+};
+
+class LGFXBase
+{
+    public:
+        LGFXBase(int width = 240, int height = 320);
+
+        int32_t width() const  { return _width; }
+        int32_t height() const { return _height; }
+        void setRotation(int r);
+        int  getRotation() const { return _rotation; }
+        int  getColorDepth() const { return 16; }
+        void setColorDepth(int) {}
+        uint32_t getBaseColor() const { return _baseColor; }
+        void setBaseColor(uint32_t c) { _baseColor = c; }
+        void setSwapBytes(bool) {}
+        bool getSwapBytes() { return false; }
+        uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3); }
+
+        void startWrite() { _writeDepth++; }
+        void endWrite();
+        void setAddrWindow(int x, int y, int w, int h);
+        void writePixels(const uint16_t *data, int32_t len, bool swap = true);
+        void waitDMA() {}
+
+        void clear() { fillScreen(_baseColor); }
+        void fillScreen(uint32_t color);
+        void drawPixel(int x, int y, uint32_t color);
+        void drawFastHLine(int x, int y, int w, uint32_t color);
+        void drawFastVLine(int x, int y, int h, uint32_t color);
+        void fillRect(int x, int y, int w, int h, uint32_t color);
+        void drawRect(int x, int y, int w, int h, uint32_t color);
+        void fillRoundRect(int x, int y, int w, int h, int r, uint32_t color);
+        void drawRoundRect(int x, int y, int w, int h, int r, uint32_t color);
+        void fillCircle(int x, int y, int r, uint32_t color);
+        void drawCircle(int x, int y, int r, uint32_t color);
+        void drawLine(int x0, int y0, int x1, int y1, uint32_t color);
+
+        void setFont(const IFont *font) { _font = static_cast<const GFXfont *>(font); }
+        void setTextSize(float size) { _textSize = size; }
+        float getTextSizeX() const { return _textSize; }
+        float getTextSizeY() const { return _textSize; }
+        void setTextDatum(uint8_t datum) { _datum = datum; }
+        void setTextDatum(textdatum_t datum) { _datum = datum; }
+        textdatum_t getTextDatum() const { return (textdatum_t)_datum; }
+        void setTextColor(uint32_t fg) { _textColor = fg; _textBg = fg; }
+        void setTextColor(uint32_t fg, uint32_t bg) { _textColor = fg; _textBg = bg; }
+        int32_t textWidth(const char *s);
+        int32_t textWidth(const String &s) { return textWidth(s.c_str()); }
+        int32_t fontHeight();
+        size_t drawString(const char *s, int x, int y);
+        size_t drawString(const String &s, int x, int y) { return drawString(s.c_str(), x, y); }
+
+        void readRect(int x, int y, int w, int h, uint16_t *data);
+        void readRect(int x, int y, int w, int h, rgb565_t *data) { readRect(x, y, w, h, (uint16_t *)data); }
+        void readRect(int x, int y, int w, int h, swap565_t *data);
+        void readRect(int x, int y, int w, int h, rgb888_t *data);
+        void readRect(int x, int y, int w, int h, bgr888_t *data);
+        void pushImage(int x, int y, int w, int h, const uint16_t *data);
+
+        // simulator
+        const uint16_t *simFramebuffer() const { return _fb.data(); }
+        uint16_t simPixel(int x, int y) const { return _fb[y * _width + x]; }
+        bool simWriteBmp(const char *path) const;
+        DrawStats &simStats() { return _stats; }
+        void simResetStats();
+
+    protected:
+        void count(const char *primitive, uint64_t pixels, uint32_t windows);
+        void plot(int x, int y, uint16_t color);
+        void span(int x, int y, int w, uint16_t color);   // no accounting
+        int  glyphScale();
+        int  glyphAdvance();
+
+        int _width, _height;
+        int _rotation = 0;
+        std::vector<uint16_t> _fb;
+        uint32_t _baseColor = 0;
+        const GFXfont *_font = &fonts::Font0;
+        float _textSize = 1.0f;
+        uint8_t _datum = top_left;
+        uint32_t _textColor = 0xffff;
+        uint32_t _textBg = 0xffff;
+        DrawStats _stats;
+        DrawStats _total;  // before the last simResetStats(), without primitives
+        bool _offscreen = false;    // a sprite
+        int _writeDepth = 0;        // startWrite() nesting
+        int _winX = 0, _winY = 0, _winW = 0, _winH = 0, _winPos = 0;
+        uint64_t _writePixels = 0;  // of the address windows since startWrite()
+        uint32_t _writeWindows = 0;
+};
+
+class LGFX_Sprite : public LGFXBase
+{
+    public:
+        LGFX_Sprite(LGFXBase *parent = nullptr) : LGFXBase(0, 0) { _offscreen = true; }
+        void *createSprite(int w, int h);
+        void deleteSprite();
+        uint16_t readPixel(int x, int y) const { return x >= 0 && x < _width && y >= 0 && y < _height ? _fb[y * _width + x] : 0; }
+};
+
+class LGFX_Device : public LGFXBase
+{
+    public:
+        bool begin() { return init(); }
+        bool init() { fillScreen(0); simResetStats(); return true; }
+        bool getTouch(int *x, int *y);
+        bool getTouch(uint16_t *x, uint16_t *y);
+        void setBrightness(uint8_t b) { _brightness = b; }
+        uint8_t getBrightness() { return _brightness; }
+        bool isEPD() { return false; }
+        void calibrateTouch(uint16_t *data, uint32_t fg, uint32_t bg, int size);
+        void sleep() { _asleep = true; }
+        void wakeup() { _asleep = false; }
+        void powerSaveOn() {}
+        void powerSaveOff() {}
+
+    private:
+        uint8_t _brightness = 0;
+        bool _asleep = false;
+};
+
+}}  // namespace lgfx::v1
+
+using namespace lgfx::v1;
+
+#define TFT_BLACK       0x0000
+#define TFT_NAVY        0x000F
+#define TFT_DARKGREEN   0x03E0
+#define TFT_MAROON      0x7800
+#define TFT_PURPLE      0x780F
+#define TFT_OLIVE       0x7BE0
+#define TFT_LIGHTGREY   0xD69A
+#define TFT_DARKGREY    0x7BEF
+#define TFT_BLUE        0x001F
+#define TFT_GREEN       0x07E0
+#define TFT_CYAN        0x07FF
+#define TFT_RED         0xF800
+#define TFT_MAGENTA     0xF81F
+#define TFT_YELLOW      0xFFE0
+#define TFT_WHITE       0xFFFF
+#define TFT_ORANGE      0xFDA0
+#define TFT_GOLD        0xFEA0
+#define TFT_SKYBLUE     0x867D
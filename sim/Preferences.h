@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+// NVS of the simulator, in memory. Every run starts with empty flash.
+
+class Preferences
+{
+    public:
+        bool begin(const char *name, bool readOnly = false);
+        void end() { _ns = nullptr; }
+        bool clear();
+        bool remove(const char *key);
+        bool isKey(const char *key);
+        size_t freeEntries();
+
+        size_t putBytes(const char *key, const void *value, size_t len);
+        size_t getBytes(const char *key, void *buf, size_t maxLen);
+        size_t getBytesLength(const char *key);
+        size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+        uint32_t getUInt(const char *key, uint32_t defaultValue = 0)
+        {
+            uint32_t v = defaultValue;
+            return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : defaultValue;
+        }
+
+    private:
+        using Namespace = std::map<std::string, std::vector<uint8_t>>;
+        Namespace *_ns = nullptr;
+        bool _readOnly = false;
+};
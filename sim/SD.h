@@ -0,0 +1,25 @@
+#pragma once
+#include "FS.h"
+#include "SPI.h"
+
+// SD card of the simulator: the slot is empty, begin() fails
+
+typedef enum { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+namespace fs
+{
+    class SDFS : public FS
+    {
+        public:
+            bool begin(uint8_t ssPin = 5, SPIClass &spi = SPI, uint32_t frequency = 4000000, const char *mountpoint = "/sd",
+                       uint8_t maxFiles = 5, bool formatIfEmpty = false) { return false; }
+            void end() {}
+            sdcard_type_t cardType() { return CARD_NONE; }
+            uint64_t cardSize() { return 0; }
+            size_t numSectors() { return 0; }
+            size_t sectorSize() { return 0; }
+            uint64_t totalBytes() { return 0; }
+            uint64_t usedBytes() { return 0; }
+    };
+}
+extern fs::SDFS SD;
@@ -0,0 +1,15 @@
+#pragma once
+#include <Arduino.h>
+
+#define HSPI 2
+#define VSPI 3
+
+class SPIClass
+{
+    public:
+        SPIClass(uint8_t bus = VSPI) {}
+        void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+        void end() {}
+        void setFrequency(uint32_t) {}
+};
+extern SPIClass SPI;
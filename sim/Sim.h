@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+/**
+ * File         Sim.h
+ *
+ * Purpose      State of the simulated board shared by the shims and the
+ *              script runner of sim_main.cpp: the virtual clock, the touch
+ *              panel and the signal generated by the SENS registers.
+ */
+namespace sim
+{
+    int64_t now();                      // virtual time in us
+    void advance(int64_t us);           // let time pass, fires the due esp_timers
+    void idle(int64_t usMax);           // main thread sleeps, ends at the script horizon or a notification
+    bool isMainThread();
+    extern int64_t usHorizon;           // the script step ends here, idle() does not sleep past it
+
+    std::string takeSerialOutput();     // what the firmware wrote to Serial since the last call
+
+    struct Touch { bool pressed; int x; int y; };
+    extern Touch touch;
+
+    extern uint32_t regs[3];            // SENS_SAR_DAC_CTRL1/2, RTC_CNTL_CLK_CONF
+    extern bool dacEnabled[2];
+    double signalFrequency();           // from the registers, 0 if the tone generator is off
+}
@@ -0,0 +1,339 @@
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <time.h>
+#include "Sim.h"
+#include "esp_sleep.h"
+#include "driver/dac.h"
+#include "driver/uart.h"
+#include "soc/sens_reg.h"
+
+/**
+ * Virtual clock, esp_timer, Serial, pins and sleep of the simulated board
+ */
+
+namespace sim
+{
+    static std::atomic<int64_t> usNow(0);
+    static std::thread::id mainThread = std::this_thread::get_id();
+    int64_t usHorizon = 0;
+    Touch touch = { false, 0, 0 };
+    uint32_t regs[3] = { 0, 0, 0 };
+    bool dacEnabled[2] = { false, false };
+
+    bool isMainThread() { return std::this_thread::get_id() == mainThread; }
+
+    int64_t now()
+    {
+        if (isMainThread()) return usNow += 1;  // every clock read costs 1 us, so busy waits end
+        return usNow;
+    }
+
+    struct Timer
+    {
+        esp_timer_create_args_t args;
+        int64_t usDue;
+        uint64_t usPeriod;
+        bool armed;
+    };
+    static std::vector<Timer *> timers;
+    static std::recursive_mutex timerLock;
+
+    void advance(int64_t us)
+    {
+        int64_t usEnd = usNow + us;
+        while (true)  // fire the due timers in time order
+        {
+            Timer *next = nullptr;
+            {
+                std::lock_guard<std::recursive_mutex> lock(timerLock);
+                for (Timer *t : timers)
+                {
+                    if (t->armed && t->usDue <= usEnd && (! next || t->usDue < next->usDue)) next = t;
+                }
+                if (! next) break;
+                if (next->usDue > usNow) usNow = next->usDue;
+                if (next->usPeriod > 0) next->usDue += next->usPeriod;
+                else next->armed = false;
+            }
+            next->args.callback(next->args.arg);
+        }
+        if (usEnd > usNow) usNow = usEnd;
+    }
+
+    double signalFrequency()
+    {
+        if (! (regs[0] & SENS_SW_TONE_EN)) return 0.0;
+        if (! (regs[1] & (SENS_DAC_CW_EN1_M | SENS_DAC_CW_EN2_M))) return 0.0;
+        uint32_t step = regs[0] & SENS_SW_FSTEP_V;
+        uint32_t divi = (regs[2] >> RTC_CNTL_CK8M_DIV_SEL_S) & RTC_CNTL_CK8M_DIV_SEL_V;
+        return 8000000.0 / (1 + divi) * step / 65536;
+    }
+}
+
+
+uint32_t micros() { return (uint32_t)sim::now(); }
+uint32_t millis() { return (uint32_t)(sim::now() / 1000); }
+int64_t esp_timer_get_time() { return sim::now(); }
+
+void delay(uint32_t ms)
+{
+    if (sim::isMainThread()) sim::advance(ms * 1000LL);
+    else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    if (sim::isMainThread()) sim::advance(us);
+}
+
+void yield() {}
+
+void simLog(char level, const char *file, int line, const char *func, const char *format, ...)
+{
+    const char *name = strrchr(file, '/');
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    ::printf("[%6u][%c][%s:%d] %s(): %s\n", (unsigned)(sim::now() / 1000), level, name ? name + 1 : file, line, func, text);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+void pinMatrixInAttach(uint8_t pin, uint8_t signal, bool inverted) {}
+
+int digitalRead(uint8_t pin)
+{
+    if (pin == TP_IRQ) return sim::touch.pressed ? LOW : HIGH;  // PENIRQ is low while touched
+    return LOW;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    if (inMax == inMin) return outMin;
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+static uint32_t seed = 1;
+long random(long max)
+{
+    seed = seed * 1103515245 + 12345;  // fixed sequence, runs are reproducible
+    return max > 0 ? (seed >> 8) % max : 0;
+}
+long random(long min, long max) { return min + random(max - min); }
+
+
+// --- Print, Stream, Serial ---
+
+size_t Print::printf(const char *format, ...)
+{
+    char small[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if (n < (int)sizeof(small)) return write((const uint8_t *)small, n);
+
+    std::vector<char> big(n + 1);
+    va_start(args, format);
+    vsnprintf(big.data(), big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t *)big.data(), n);
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t n = 0;
+    while (n < length && available() > 0) buffer[n++] = read();
+    return n;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+    String s;
+    while (available() > 0)
+    {
+        char c = read();
+        if (c == terminator) break;
+        s += c;
+    }
+    return s;
+}
+
+HardwareSerial Serial;
+
+static std::mutex serialLock;
+static std::string serialOutput;  // for expect and capture of the script
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    std::lock_guard<std::mutex> lock(serialLock);
+    serialOutput.append((const char *)buffer, size);
+    return fwrite(buffer, 1, size, stdout);
+}
+
+std::string sim::takeSerialOutput()
+{
+    std::lock_guard<std::mutex> lock(serialLock);
+    std::string out;
+    out.swap(serialOutput);
+    return out;
+}
+
+int HardwareSerial::available() { return _rx.size(); }
+
+int HardwareSerial::read()
+{
+    if (_rx.empty()) return -1;
+    int c = (uint8_t)_rx[0];
+    _rx.erase(0, 1);
+    return c;
+}
+
+int HardwareSerial::peek() { return _rx.empty() ? -1 : (uint8_t)_rx[0]; }
+void HardwareSerial::flush() { fflush(stdout); }
+
+void HardwareSerial::simFeed(const char *data, size_t len)
+{
+    _rx.append(data, len);
+    if (_onReceive) _onReceive();
+}
+
+EspClass ESP;
+
+// The firmware allocates with new (String is a std::string here), so 
+// counting new and delete gives the heap it uses. The size is kept in 
+// front of the block.
+static std::atomic<size_t> heapUsed { 0 };
+static const size_t heapHeader = alignof(std::max_align_t);
+
+size_t simHeapUsed() { return heapUsed; }
+
+void *operator new(size_t n)
+{
+    char *p = (char *)malloc(n + heapHeader);
+    if (p == nullptr) throw std::bad_alloc();
+    *(size_t *)p = n;
+    heapUsed += n;
+    return p + heapHeader;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p == nullptr) return;
+    char *block = (char *)p - heapHeader;
+    heapUsed -= *(size_t *)block;
+    free(block);
+}
+
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+uint32_t EspClass::getCycleCount()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) * 240 / 1000);
+}
+
+void EspClass::restart()
+{
+    ::printf("[sim] ESP.restart(), simulation ends\n");
+    exit(0);
+}
+
+
+// --- esp_timer ---
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    sim::Timer *t = new sim::Timer{ *args, 0, 0, false };
+    std::lock_guard<std::recursive_mutex> lock(sim::timerLock);
+    sim::timers.push_back(t);
+    *handle = (esp_timer_handle_t)t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t us)
+{
+    sim::Timer *t = (sim::Timer *)timer;
+    std::lock_guard<std::recursive_mutex> lock(sim::timerLock);
+    t->usDue = sim::usNow + us;
+    t->usPeriod = 0;
+    t->armed = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t us)
+{
+    sim::Timer *t = (sim::Timer *)timer;
+    std::lock_guard<std::recursive_mutex> lock(sim::timerLock);
+    t->usDue = sim::usNow + us;
+    t->usPeriod = us;
+    t->armed = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::recursive_mutex> lock(sim::timerLock);
+    ((sim::Timer *)timer)->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::recursive_mutex> lock(sim::timerLock);
+    sim::timers.erase(std::remove(sim::timers.begin(), sim::timers.end(), (sim::Timer *)timer), sim::timers.end());
+    delete (sim::Timer *)timer;
+    return ESP_OK;
+}
+
+
+// --- sleep and DAC ---
+
+static esp_sleep_wakeup_cause_t wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) { return ESP_OK; }
+esp_err_t esp_sleep_enable_uart_wakeup(int uart_num) { return ESP_OK; }
+esp_err_t uart_set_wakeup_threshold(uart_port_t uart_num, int wakeup_threshold) { return ESP_OK; }
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option) { return ESP_OK; }
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return wakeupCause; }
+
+esp_err_t esp_light_sleep_start()
+{
+    ::printf("[sim] light sleep until the end of the script step\n");
+    if (sim::usHorizon > sim::usNow) sim::advance(sim::usHorizon - sim::usNow);
+    wakeupCause = ESP_SLEEP_WAKEUP_EXT0;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start()
+{
+    ::printf("[sim] deep sleep, simulation ends\n");
+    fflush(stdout);
+    exit(0);
+}
+
+esp_err_t dac_output_enable(dac_channel_t channel)
+{
+    sim::dacEnabled[channel == DAC_CHANNEL_1 ? 0 : 1] = true;
+    return ESP_OK;
+}
+
+esp_err_t dac_output_disable(dac_channel_t channel)
+{
+    sim::dacEnabled[channel == DAC_CHANNEL_1 ? 0 : 1] = false;
+    return ESP_OK;
+}
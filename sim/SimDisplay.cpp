@@ -0,0 +1,530 @@
+#include <LovyanGFX.hpp>
+#include <math.h>
+#include "Sim.h"
+
+/**
+ * Framebuffer display of the simulator, see LovyanGFX.hpp for the cost model
+ */
+
+namespace lgfx { inline namespace v1 {
+
+namespace fonts
+{
+    const GFXfont Font0(8), DejaVu9(9), DejaVu12(12), DejaVu18(18), DejaVu24(24);
+}
+
+static const int windowBytes = 11;          // CASET + 4, RASET + 4, RAMWR
+static const uint32_t hzWrite = 40000000;
+static const uint32_t hzRead  = 16000000;
+
+// 3x5 glyphs, 3 bits per row from top to bottom, lower case is drawn as upper case
+struct Glyph { char c; uint16_t bits; };
+static const Glyph glyphs[] =
+{
+    {'0', 0b111'101'101'101'111}, {'1', 0b010'110'010'010'111}, {'2', 0b111'001'111'100'111},
+    {'3', 0b111'001'111'001'111}, {'4', 0b101'101'111'001'001}, {'5', 0b111'100'111'001'111},
+    {'6', 0b111'100'111'101'111}, {'7', 0b111'001'001'010'010}, {'8', 0b111'101'111'101'111},
+    {'9', 0b111'101'111'001'111},
+    {'A', 0b010'101'111'101'101}, {'B', 0b110'101'110'101'110}, {'C', 0b011'100'100'100'011},
+    {'D', 0b110'101'101'101'110}, {'E', 0b111'100'110'100'111}, {'F', 0b111'100'110'100'100},
+    {'G', 0b011'100'101'101'011}, {'H', 0b101'101'111'101'101}, {'I', 0b111'010'010'010'111},
+    {'J', 0b001'001'001'101'010}, {'K', 0b101'101'110'101'101}, {'L', 0b100'100'100'100'111},
+    {'M', 0b101'111'111'101'101}, {'N', 0b110'101'101'101'101}, {'O', 0b010'101'101'101'010},
+    {'P', 0b110'101'110'100'100}, {'Q', 0b010'101'101'110'011}, {'R', 0b110'101'110'101'101},
+    {'S', 0b011'100'010'001'110}, {'T', 0b111'010'010'010'010}, {'U', 0b101'101'101'101'111},
+    {'V', 0b101'101'101'101'010}, {'W', 0b101'101'111'111'101}, {'X', 0b101'101'010'101'101},
+    {'Y', 0b101'101'010'010'010}, {'Z', 0b111'001'010'100'111},
+    {'.', 0b000'000'000'000'010}, {',', 0b000'000'000'010'100}, {'-', 0b000'000'111'000'000},
+    {'+', 0b000'010'111'010'000}, {'*', 0b000'101'010'101'000}, {'/', 0b001'001'010'100'100},
+    {'(', 0b001'010'010'010'001}, {')', 0b100'010'010'010'100}, {':', 0b000'010'000'010'000},
+    {'=', 0b000'111'000'111'000}, {'?', 0b110'001'010'000'010}, {'!', 0b010'010'010'000'010},
+    {'%', 0b101'001'010'100'101}, {'<', 0b001'010'100'010'001}, {'>', 0b100'010'001'010'100},
+    {'_', 0b000'000'000'000'111}, {'\'',0b010'010'000'000'000}, {'"', 0b101'101'000'000'000},
+    {'#', 0b101'111'101'111'101}, {'[', 0b110'100'100'100'110}, {']', 0b011'001'001'001'011},
+    {'|', 0b010'010'010'010'010}, {'&', 0b010'101'010'101'011}, {'@', 0b111'101'111'100'011},
+    {'^', 0b010'101'000'000'000}, {';', 0b000'010'000'010'100}, {' ', 0},
+};
+
+static uint16_t glyphBits(char c)
+{
+    c = toupper(c);
+    for (const Glyph &g : glyphs) if (g.c == c) return g.bits;
+    return 0b111'111'111'111'111;  // unknown: a block
+}
+
+
+void DrawStats::print(const char *title)
+{
+    ::printf("\n%s\n", title);
+    for (const char *p = title; *p; p++) ::putchar('-');
+    ::printf("\nprimitive         calls      pixels       bytes\n");
+    for (auto &p : primitives)
+    {
+        ::printf("%-14s %8u %11llu %11llu\n", p.first.c_str(), p.second.calls,
+            (unsigned long long)p.second.pixels, (unsigned long long)p.second.bytes);
+    }
+    ::printf("pixels written %11llu\npixels read    %11llu\nwindows        %11u\n",
+        (unsigned long long)pixelsWritten, (unsigned long long)pixelsRead, windows);
+    ::printf("SPI bytes      %11llu written, %llu read\nSPI time       %11.1f ms\n",
+        (unsigned long long)bytesWritten, (unsigned long long)bytesRead, usSpi / 1000.0);
+}
+
+
+LGFXBase::LGFXBase(int width, int height) : _width(width), _height(height), _fb(width * height, 0)
+{
+}
+
+void LGFXBase::setRotation(int r)
+{
+    _rotation = r & 7;
+    int w = std::min(_width, _height), h = std::max(_width, _height);
+    if (_rotation & 1) std::swap(w, h);  // the panel is portrait at rotation 0
+    if (w != _width)
+    {
+        _width = w;
+        _height = h;
+        _fb.assign(w * h, 0);
+    }
+}
+
+/**
+ * Book the pixels and address windows of one primitive and let the
+ * transfer time pass
+ */
+void LGFXBase::count(const char *primitive, uint64_t pixels, uint32_t windows)
+{
+    if (_offscreen) return;
+    uint64_t bytes = windows * windowBytes + pixels * 2;
+    DrawStats::Primitive &p = _stats.primitives[primitive];
+    p.calls++;
+    _stats.calls++;
+    p.pixels += pixels;
+    p.bytes += bytes;
+    _stats.pixelsWritten += pixels;
+    _stats.bytesWritten += bytes;
+    _stats.windows += windows;
+    uint64_t us = bytes * 8 * 1000000 / hzWrite;
+    _stats.usSpi += us;
+    if (sim::isMainThread()) sim::advance(us);
+}
+
+void LGFXBase::simResetStats()
+{
+    _total.calls += _stats.calls;
+    _total.pixelsWritten += _stats.pixelsWritten;
+    _total.pixelsRead += _stats.pixelsRead;
+    _total.bytesWritten += _stats.bytesWritten;
+    _total.bytesRead += _stats.bytesRead;
+    _total.windows += _stats.windows;
+    _total.usSpi += _stats.usSpi;
+    _stats = DrawStats();
+}
+
+void LGFXBase::plot(int x, int y, uint16_t color)
+{
+    if (x >= 0 && x < _width && y >= 0 && y < _height) _fb[y * _width + x] = color;
+}
+
+void LGFXBase::span(int x, int y, int w, uint16_t color)
+{
+    if (y < 0 || y >= _height) return;
+    int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+    for (int i = x0; i < x1; i++) _fb[y * _width + i] = color;
+}
+
+static int clippedArea(int x, int y, int w, int h, int width, int height)
+{
+    int x0 = std::max(x, 0), x1 = std::min(x + w, width);
+    int y0 = std::max(y, 0), y1 = std::min(y + h, height);
+    return (x1 > x0 && y1 > y0) ? (x1 - x0) * (y1 - y0) : 0;
+}
+
+void LGFXBase::setAddrWindow(int x, int y, int w, int h)
+{
+    _winX = x;
+    _winY = y;
+    _winW = w;
+    _winH = h;
+    _winPos = 0;
+    _writeWindows++;
+    if (_writeDepth == 0) endWrite();
+}
+
+void LGFXBase::writePixels(const uint16_t *data, int32_t len, bool swap)
+{
+    for (int32_t i = 0; i < len && _winPos < _winW * _winH; i++, _winPos++)
+    {
+        plot(_winX + _winPos % _winW, _winY + _winPos / _winW, data[i]);
+    }
+    _writePixels += len;
+    if (_writeDepth == 0) endWrite();
+}
+
+/**
+ * The windows and pixels since startWrite() are one call
+ */
+void LGFXBase::endWrite()
+{
+    if (_writeDepth > 0 && --_writeDepth > 0) return;
+    if (_writePixels > 0 || _writeWindows > 0) count("writePixels", _writePixels, _writeWindows);
+    _writePixels = 0;
+    _writeWindows = 0;
+}
+
+void *LGFX_Sprite::createSprite(int w, int h)
+{
+    _width = w;
+    _height = h;
+    _fb.assign(w * h, 0);
+    return _fb.data();
+}
+
+void LGFX_Sprite::deleteSprite()
+{
+    _fb.clear();
+    _fb.shrink_to_fit();
+    _width = _height = 0;
+}
+
+void LGFXBase::fillScreen(uint32_t color)
+{
+    std::fill(_fb.begin(), _fb.end(), (uint16_t)color);
+    count("fillScreen", _fb.size(), 1);
+}
+
+void LGFXBase::drawPixel(int x, int y, uint32_t color)
+{
+    plot(x, y, color);
+    count("drawPixel", 1, 1);
+}
+
+void LGFXBase::drawFastHLine(int x, int y, int w, uint32_t color)
+{
+    span(x, y, w, color);
+    count("drawFastHLine", clippedArea(x, y, w, 1, _width, _height), 1);
+}
+
+void LGFXBase::drawFastVLine(int x, int y, int h, uint32_t color)
+{
+    for (int i = 0; i < h; i++) plot(x, y + i, color);
+    count("drawFastVLine", clippedArea(x, y, 1, h, _width, _height), 1);
+}
+
+void LGFXBase::fillRect(int x, int y, int w, int h, uint32_t color)
+{
+    for (int r = 0; r < h; r++) span(x, y + r, w, color);
+    count("fillRect", clippedArea(x, y, w, h, _width, _height), 1);
+}
+
+void LGFXBase::drawRect(int x, int y, int w, int h, uint32_t color)
+{
+    span(x, y, w, color);
+    span(x, y + h - 1, w, color);
+    for (int r = 1; r < h - 1; r++)
+    {
+        plot(x, y + r, color);
+        plot(x + w - 1, y + r, color);
+    }
+    count("drawRect", 2 * w + 2 * std::max(h - 2, 0), 4);
+}
+
+/**
+ * Half width of a circle of radius r at distance dy from its center
+ */
+static int halfWidth(int r, int dy)
+{
+    return (int)floor(sqrt((double)r * r - (double)dy * dy) + 0.5);
+}
+
+void LGFXBase::fillRoundRect(int x, int y, int w, int h, int r, uint32_t color)
+{
+    r = std::min(r, std::min(w, h) / 2);
+    uint64_t pixels = 0;
+    uint32_t windows = 1;
+    for (int row = 0; row < h; row++)
+    {
+        int dy = row < r ? r - row : (row >= h - r ? row - (h - r - 1) : 0);
+        int inset = dy > 0 ? r - halfWidth(r, dy) : 0;
+        span(x + inset, y + row, w - 2 * inset, color);
+        pixels += w - 2 * inset;
+        if (dy > 0) windows++;  // the rounded rows are spans, the rest is one block
+    }
+    count("fillRoundRect", pixels, windows);
+}
+
+void LGFXBase::drawRoundRect(int x, int y, int w, int h, int r, uint32_t color)
+{
+    r = std::min(r, std::min(w, h) / 2);
+    uint64_t pixels = 0;
+    uint32_t windows = 4;
+    span(x + r, y, w - 2 * r, color);
+    span(x + r, y + h - 1, w - 2 * r, color);
+    for (int row = r; row < h - r; row++)
+    {
+        plot(x, y + row, color);
+        plot(x + w - 1, y + row, color);
+    }
+    pixels += 2 * (w - 2 * r) + 2 * (h - 2 * r);
+    for (int dy = 1; dy <= r; dy++)  // corners, one pixel per row and side
+    {
+        int dx = halfWidth(r, dy);
+        int cxl = x + r, cxr = x + w - r - 1, cyt = y + r, cyb = y + h - r - 1;
+        plot(cxl - dx, cyt - dy, color);
+        plot(cxr + dx, cyt - dy, color);
+        plot(cxl - dx, cyb + dy, color);
+        plot(cxr + dx, cyb + dy, color);
+        pixels += 4;
+        windows += 4;
+    }
+    count("drawRoundRect", pixels, windows);
+}
+
+void LGFXBase::fillCircle(int x, int y, int r, uint32_t color)
+{
+    uint64_t pixels = 0;
+    for (int dy = -r; dy <= r; dy++)
+    {
+        int dx = halfWidth(r, dy);
+        span(x - dx, y + dy, 2 * dx + 1, color);
+        pixels += 2 * dx + 1;
+    }
+    count("fillCircle", pixels, 2 * r + 1);
+}
+
+void LGFXBase::drawCircle(int x, int y, int r, uint32_t color)
+{
+    uint64_t pixels = 0;
+    int f = 1 - r, ddx = 1, ddy = -2 * r, px = 0, py = r;
+    plot(x, y + r, color);
+    plot(x, y - r, color);
+    plot(x + r, y, color);
+    plot(x - r, y, color);
+    pixels += 4;
+    while (px < py)
+    {
+        if (f >= 0) { py--; ddy += 2; f += ddy; }
+        px++; ddx += 2; f += ddx;
+        plot(x + px, y + py, color); plot(x - px, y + py, color);
+        plot(x + px, y - py, color); plot(x - px, y - py, color);
+        plot(x + py, y + px, color); plot(x - py, y + px, color);
+        plot(x + py, y - px, color); plot(x - py, y - px, color);
+        pixels += 8;
+    }
+    count("drawCircle", pixels, pixels);
+}
+
+void LGFXBase::drawLine(int x0, int y0, int x1, int y1, uint32_t color)
+{
+    int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    uint64_t pixels = 0;
+    uint32_t windows = 1;
+    bool steep = -dy > dx;
+    while (true)
+    {
+        plot(x0, y0, color);
+        pixels++;
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        bool stepX = e2 >= dy, stepY = e2 <= dx;
+        if (stepX) { err += dy; x0 += sx; }
+        if (stepY) { err += dx; y0 += sy; }
+        if (steep ? stepX : stepY) windows++;  // a new run along the major axis
+    }
+    count("drawLine", pixels, windows);
+}
+
+
+// --- text ---
+
+int LGFXBase::glyphScale()
+{
+    return std::max(1, (int)(_font->size * _textSize / 6));
+}
+
+int LGFXBase::glyphAdvance()
+{
+    return std::max(4, (int)(_font->size * _textSize * 0.6f + 0.5f));
+}
+
+int32_t LGFXBase::fontHeight()
+{
+    return (int32_t)(_font->size * _textSize * 1.17f + 0.5f);
+}
+
+int32_t LGFXBase::textWidth(const char *s)
+{
+    return strlen(s) * glyphAdvance();
+}
+
+size_t LGFXBase::drawString(const char *s, int x, int y)
+{
+    int w = textWidth(s), h = fontHeight();
+    int hAlign = _datum & 3, vAlign = _datum & 12;
+    if (hAlign == 1) x -= w / 2;
+    else if (hAlign == 2) x -= w;
+    if (_datum & 16) y -= h * 4 / 5;  // baseline
+    else if (vAlign == 4) y -= h / 2;
+    else if (vAlign == 8) y -= h;
+
+    int scale = glyphScale(), advance = glyphAdvance();
+    int gx0 = (advance - 3 * scale) / 2, gy0 = (h - 5 * scale) / 2;
+    uint64_t pixels = 0;
+    uint32_t windows = 0;
+    bool fillBg = _textBg != _textColor;
+    for (const char *p = s; *p; p++, x += advance)
+    {
+        if (fillBg)  // the glyph box is filled with the background color
+        {
+            for (int r = 0; r < h; r++) span(x, y + r, advance, _textBg);
+            pixels += advance * h;
+            windows++;
+        }
+        uint16_t bits = glyphBits(*p);
+        for (int row = 0; row < 5; row++)
+        {
+            int rowBits = (bits >> (3 * (4 - row))) & 7;
+            for (int col = 0; col < 3; col++)
+            {
+                if (! (rowBits & (4 >> col))) continue;
+                int run = 1;  // left to right runs of set bits are one window
+                while (col + run < 3 && (rowBits & (4 >> (col + run)))) run++;
+                for (int sy = 0; sy < scale; sy++)
+                {
+                    span(x + gx0 + col * scale, y + gy0 + row * scale + sy, run * scale, _textColor);
+                    pixels += run * scale;
+                    windows++;
+                }
+                col += run - 1;
+            }
+        }
+    }
+    count("drawString", pixels, windows);
+    return w;
+}
+
+
+// --- read back ---
+
+static void countRead(DrawStats &stats, uint64_t pixels)
+{
+    uint64_t bytes = windowBytes + 1 + pixels * 3;  // dummy byte, then RGB666 as 3 bytes per pixel
+    stats.primitives["readRect"].calls++;
+    stats.calls++;
+    stats.primitives["readRect"].pixels += pixels;
+    stats.primitives["readRect"].bytes += bytes;
+    stats.pixelsRead += pixels;
+    stats.bytesRead += bytes;
+    stats.windows++;
+    uint64_t us = bytes * 8 * 1000000 / hzRead;
+    stats.usSpi += us;
+    if (sim::isMainThread()) sim::advance(us);
+}
+
+void LGFXBase::readRect(int x, int y, int w, int h, uint16_t *data)
+{
+    for (int r = 0; r < h; r++)
+        for (int c = 0; c < w; c++)
+        {
+            int px = x + c, py = y + r;
+            *data++ = (px >= 0 && px < _width && py >= 0 && py < _height) ? _fb[py * _width + px] : 0;
+        }
+    countRead(_stats, (uint64_t)w * h);
+}
+
+void LGFXBase::readRect(int x, int y, int w, int h, swap565_t *data)
+{
+    readRect(x, y, w, h, (uint16_t *)data);
+    for (int i = 0; i < w * h; i++) data[i].raw = (data[i].raw >> 8) | (data[i].raw << 8);
+}
+
+void LGFXBase::readRect(int x, int y, int w, int h, rgb888_t *data)
+{
+    std::vector<uint16_t> row(w);
+    for (int r = 0; r < h; r++)
+    {
+        readRect(x, y + r, w, 1, row.data());
+        for (int c = 0; c < w; c++, data++)
+        {
+            uint16_t p = row[c];
+            data->r = ((p >> 11) & 0x1f) * 255 / 31;
+            data->g = ((p >> 5) & 0x3f) * 255 / 63;
+            data->b = (p & 0x1f) * 255 / 31;
+        }
+    }
+}
+
+void LGFXBase::readRect(int x, int y, int w, int h, bgr888_t *data)
+{
+    readRect(x, y, w, h, (rgb888_t *)data);
+    for (int i = 0; i < w * h; i++) std::swap(data[i].r, data[i].b);
+}
+
+void LGFXBase::pushImage(int x, int y, int w, int h, const uint16_t *data)
+{
+    for (int r = 0; r < h; r++)
+        for (int c = 0; c < w; c++) plot(x + c, y + r, data[r * w + c]);
+    count("pushImage", clippedArea(x, y, w, h, _width, _height), 1);
+}
+
+/**
+ * Write the framebuffer as 24 bit BMP
+ */
+bool LGFXBase::simWriteBmp(const char *path) const
+{
+    FILE *f = fopen(path, "wb");
+    if (! f) return false;
+    int rowSize = (_width * 3 + 3) & ~3;
+    bitmap_header_t hdr = {};
+    hdr.bfType = 0x4d42;
+    hdr.bfOffBits = sizeof(hdr);
+    hdr.bfSize = sizeof(hdr) + rowSize * _height;
+    hdr.biSize = 40;
+    hdr.biWidth = _width;
+    hdr.biHeight = _height;
+    hdr.biPlanes = 1;
+    hdr.biBitCount = 24;
+    hdr.biSizeImage = rowSize * _height;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    std::vector<uint8_t> row(rowSize, 0);
+    for (int y = _height - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < _width; x++)
+        {
+            uint16_t p = _fb[y * _width + x];
+            row[3 * x + 0] = (p & 0x1f) * 255 / 31;
+            row[3 * x + 1] = ((p >> 5) & 0x3f) * 255 / 63;
+            row[3 * x + 2] = ((p >> 11) & 0x1f) * 255 / 31;
+        }
+        fwrite(row.data(), rowSize, 1, f);
+    }
+    return fclose(f) == 0;
+}
+
+
+// --- touch ---
+
+bool LGFX_Device::getTouch(int *x, int *y)
+{
+    if (! sim::touch.pressed) return false;
+    *x = sim::touch.x;
+    *y = sim::touch.y;
+    return true;
+}
+
+bool LGFX_Device::getTouch(uint16_t *x, uint16_t *y)
+{
+    int tx, ty;
+    if (! getTouch(&tx, &ty)) return false;
+    *x = tx;
+    *y = ty;
+    return true;
+}
+
+void LGFX_Device::calibrateTouch(uint16_t *data, uint32_t fg, uint32_t bg, int size)
+{
+    if (data) memset(data, 0, 8 * sizeof(uint16_t));
+}
+
+}}  // namespace lgfx::v1
@@ -0,0 +1,272 @@
+#include <Arduino.h>
+#include <pthread.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Sim.h"
+
+/**
+ * FreeRTOS on host threads. Every task is a thread. The loop task is the
+ * main thread; its waits let virtual time pass, the waits of the other
+ * tasks take real time. Priorities and cores are ignored.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static std::mutex rtosLock;               // guards all semaphores, queues and notifications
+static std::condition_variable changed;   // signalled whenever one of them changes
+
+struct SimTask
+{
+    uint32_t notified = 0;
+};
+static SimTask mainTask;
+static thread_local SimTask *currentTask = &mainTask;
+
+struct SimSemaphore
+{
+    UBaseType_t count;
+    UBaseType_t max;
+    bool recursive;
+    std::thread::id owner;
+    int depth;
+};
+
+struct SimQueue
+{
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+/**
+ * Wait until ready() or the ticks have passed. The main thread lets virtual
+ * time pass in steps of 1 ms and gives the other tasks a moment of real
+ * time in each step, so the threads can answer.
+ */
+template <typename Ready>
+static bool waitFor(std::unique_lock<std::mutex> &lock, TickType_t ticks, Ready ready)
+{
+    if (ready()) return true;
+    if (ticks == 0) return false;
+    if (sim::isMainThread())
+    {
+        int64_t usEnd = sim::now() + ticks * 1000LL;
+        while (! ready())
+        {
+            if (ticks != portMAX_DELAY && sim::now() >= usEnd) return false;
+            changed.wait_for(lock, std::chrono::microseconds(200));
+            if (ready()) return true;
+            lock.unlock();
+            sim::advance(1000);
+            lock.lock();
+        }
+        return true;
+    }
+    if (ticks == portMAX_DELAY)
+    {
+        changed.wait(lock, ready);
+        return true;
+    }
+    return changed.wait_until(lock, Clock::now() + std::chrono::milliseconds(ticks), ready);
+}
+
+
+// --- critical sections ---
+
+static std::recursive_mutex critical;
+void simEnterCritical(portMUX_TYPE *mux) { critical.lock(); }
+void simExitCritical(portMUX_TYPE *mux) { critical.unlock(); }
+
+
+// --- tasks ---
+
+struct TaskStart { TaskFunction_t fn; void *arg; SimTask *task; };
+
+static void *taskMain(void *p)
+{
+    TaskStart start = *(TaskStart *)p;
+    delete (TaskStart *)p;
+    currentTask = start.task;
+    start.fn(start.arg);
+    return nullptr;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    SimTask *task = new SimTask;
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, taskMain, new TaskStart{ fn, arg, task }) != 0)
+    {
+        delete task;
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    return xTaskCreate(fn, name, stack, arg, prio, handle);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == currentTask) pthread_exit(nullptr);  // the handle stays valid, it is small
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks);
+}
+
+TickType_t xTaskGetTickCount() { return millis(); }
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentTask; }
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) { return 1; }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    SimTask *task = currentTask;
+    std::unique_lock<std::mutex> lock(rtosLock);
+    if (task == &mainTask && ticks != 0 && task->notified == 0)
+    {
+        lock.unlock();
+        sim::idle(ticks == portMAX_DELAY ? INT64_MAX : ticks * 1000LL);
+        lock.lock();
+    }
+    else
+    {
+        waitFor(lock, ticks, [task] { return task->notified > 0; });
+    }
+    uint32_t n = task->notified;
+    if (n > 0) task->notified = clear ? 0 : n - 1;
+    return n;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> lock(rtosLock);
+    task->notified++;
+    changed.notify_all();
+    return pdPASS;
+}
+
+namespace sim
+{
+    /**
+     * The loop task sleeps: let time pass up to usMax, but not past the end
+     * of the script step and not past a notification
+     */
+    void idle(int64_t usMax)
+    {
+        int64_t usEnd = now() + usMax;
+        if (usMax == INT64_MAX || usEnd > usHorizon) usEnd = usHorizon;
+        while (now() < usEnd)
+        {
+            {
+                std::lock_guard<std::mutex> lock(rtosLock);
+                if (mainTask.notified > 0) return;
+            }
+            advance(std::min<int64_t>(1000, usEnd - now()));
+        }
+    }
+}
+
+
+// --- semaphores ---
+
+static SimSemaphore *newSemaphore(UBaseType_t max, UBaseType_t initial, bool recursive)
+{
+    return new SimSemaphore{ initial, max, recursive, std::thread::id(), 0 };
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()                                 { return newSemaphore(1, 0, false); }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t n) { return newSemaphore(max, n, false); }
+SemaphoreHandle_t xSemaphoreCreateMutex()                                  { return newSemaphore(1, 1, false); }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()                         { return newSemaphore(1, 1, true); }
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(rtosLock);
+    if (! waitFor(lock, ticks, [sem] { return sem->count > 0; })) return pdFALSE;
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    std::lock_guard<std::mutex> lock(rtosLock);
+    if (sem->count >= sem->max) return pdFALSE;
+    sem->count++;
+    changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(rtosLock);
+    std::thread::id self = std::this_thread::get_id();
+    if (sem->depth > 0 && sem->owner == self)
+    {
+        sem->depth++;
+        return pdTRUE;
+    }
+    if (! waitFor(lock, ticks, [sem] { return sem->depth == 0; })) return pdFALSE;
+    sem->owner = self;
+    sem->depth = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    std::lock_guard<std::mutex> lock(rtosLock);
+    if (sem->depth == 0 || sem->owner != std::this_thread::get_id()) return pdFALSE;
+    if (--sem->depth == 0) changed.notify_all();
+    return pdTRUE;
+}
+
+
+// --- queues ---
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    return new SimQueue{ length, itemSize, {} };
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(rtosLock);
+    if (! waitFor(lock, ticks, [queue] { return queue->items.size() < queue->length; })) return pdFALSE;
+    const uint8_t *p = (const uint8_t *)item;
+    queue->items.emplace_back(p, p + queue->itemSize);
+    changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return xQueueSend(queue, item, ticks);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(rtosLock);
+    if (! waitFor(lock, ticks, [queue] { return ! queue->items.empty(); })) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(rtosLock);
+    return queue->items.size();
+}
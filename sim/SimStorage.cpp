@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include <SD.h>
+#include <Preferences.h>
+
+/**
+ * SD card, SPI and NVS of the simulator
+ */
+
+fs::SDFS SD;
+SPIClass SPI;
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+static const size_t nvsEntries = 630;      // 5 pages of 126 entries of 32 bytes
+
+bool Preferences::begin(const char *name, bool readOnly)
+{
+    if (strlen(name) > 15) return false;   // NVS keys and namespaces have at most 15 characters
+    _ns = &nvs[name];
+    _readOnly = readOnly;
+    return true;
+}
+
+bool Preferences::clear()
+{
+    if (! _ns || _readOnly) return false;
+    _ns->clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    return _ns && ! _readOnly && _ns->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    return _ns && _ns->count(key) > 0;
+}
+
+size_t Preferences::freeEntries()
+{
+    size_t used = 0;
+    for (auto &ns : nvs)
+        for (auto &kv : ns.second) used += 1 + (kv.second.size() + 31) / 32;  // header entry + data
+    return used < nvsEntries ? nvsEntries - used : 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len)
+{
+    if (! _ns || _readOnly || strlen(key) > 15) return 0;
+    const uint8_t *p = (const uint8_t *)value;
+    (*_ns)[key].assign(p, p + len);
+    return len;
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen)
+{
+    if (! _ns) return 0;
+    auto it = _ns->find(key);
+    if (it == _ns->end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    if (! _ns) return 0;
+    auto it = _ns->find(key);
+    return it == _ns->end() ? 0 : it->second.size();
+}
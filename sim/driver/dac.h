@@ -0,0 +1,6 @@
+#pragma once
+#include "esp_timer.h"
+
+typedef enum { DAC_CHANNEL_1 = 1, DAC_CHANNEL_2 = 2, DAC_CHANNEL_MAX } dac_channel_t;
+esp_err_t dac_output_enable(dac_channel_t channel);
+esp_err_t dac_output_disable(dac_channel_t channel);
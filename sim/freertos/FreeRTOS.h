@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+// FreeRTOS on host threads, see SimRtos.cpp. Ticks are milliseconds.
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define pdFAIL  0
+#define portMAX_DELAY       0xffffffffu
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY      0x7fffffff
+
+// critical sections are one global lock, like interrupts off on a single core
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+void simEnterCritical(portMUX_TYPE *mux);
+void simExitCritical(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux)      simEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)       simExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux)  simEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)   simExitCritical(mux)
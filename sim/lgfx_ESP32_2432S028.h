@@ -0,0 +1,29 @@
+#pragma once
+#include <LovyanGFX.hpp>
+
+// The CYD display of the simulator: 240 x 320 in portrait, touch from the script
+
+// Traffic to the ILI9341 since the start, as counted by the board file
+struct BusCounters
+{
+    uint32_t transactions = 0;  // drawing calls
+    uint32_t windows = 0;       // address windows set
+    uint32_t pixels = 0;        // pixels written
+    uint32_t bytesWritten = 0;
+    uint32_t bytesRead = 0;
+};
+
+class LGFX : public lgfx::LGFX_Device
+{
+    public:
+        BusCounters getBusCounters()
+        {
+            BusCounters c;
+            c.transactions = _total.calls + _stats.calls;
+            c.windows      = _total.windows + _stats.windows;
+            c.pixels       = _total.pixelsWritten + _stats.pixelsWritten;
+            c.bytesWritten = _total.bytesWritten + _stats.bytesWritten;
+            c.bytesRead    = _total.bytesRead + _stats.bytesRead;
+            return c;
+        }
+};
@@ -0,0 +1,217 @@
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+#include "Sim.h"
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+/**
+ * File         sim_main.cpp
+ *
+ * Purpose      Runs the firmware on the host: setup() once, then loop()
+ *              under the control of a script, in virtual time.
+ *
+ * Usage        cwsim [-s script] [-o outdir] [-r refdir]
+ *
+ *              The script is read from stdin without -s. Commands, one per line:
+ *              wait <ms>                  run loop() for ms
+ *              touch <x> <y> [ms]         press at x, y for ms (150), then release
+ *              drag <x0> <y0> <x1> <y1> [ms]  press and move in 10 ms steps (300)
+ *              serial <text>              send text and a newline to the serial port
+ *              shot <name>                write the screen to outdir/name.bmp; with -r
+ *                                         compare it to refdir/name.bmp and write
+ *                                         outdir/name.diff.bmp if pixels differ
+ *              stats [title]              print the draw statistics since the last stats
+ *              signal                     print the frequency set in the SENS registers
+ *              expect <text>              the serial output since the last expect or
+ *                                         capture must contain text
+ *              capture <name>             write the serial output since the last expect
+ *                                         or capture to outdir/name
+ *              # comment
+ *
+ *              The exit code is 1 if a screenshot differs from its reference,
+ *              has none in refdir, or an expected text is missing.
+ */
+
+extern LGFX lcd;
+
+static const int64_t usLoopPass = 50;   // CPU time of a loop() pass that neither sleeps nor draws
+
+static void runFor(int64_t us)
+{
+    sim::usHorizon = sim::now() + us;
+    while (sim::now() < sim::usHorizon)
+    {
+        int64_t usStart = sim::now();
+        loop();
+        if (sim::now() - usStart < usLoopPass) sim::advance(usLoopPass);
+    }
+}
+
+static bool readBmp(const char *path, int &w, int &h, std::vector<uint8_t> &pixels)
+{
+    FILE *f = fopen(path, "rb");
+    if (! f) return false;
+    lgfx::bitmap_header_t hdr;
+    bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1 && hdr.bfType == 0x4d42 && hdr.biBitCount == 24;
+    if (ok)
+    {
+        w = hdr.biWidth;
+        h = hdr.biHeight;
+        pixels.resize(((w * 3 + 3) & ~3) * h);
+        fseek(f, hdr.bfOffBits, SEEK_SET);
+        ok = fread(pixels.data(), pixels.size(), 1, f) == 1;
+    }
+    fclose(f);
+    return ok;
+}
+
+/**
+ * Compare the screenshot with its reference. Differing pixels are red in
+ * the diff image, the rest is dimmed.
+ */
+static bool compareShot(const std::string &outPath, const std::string &refPath, const std::string &diffPath)
+{
+    int w, h, rw, rh;
+    std::vector<uint8_t> out, ref;
+    if (! readBmp(refPath.c_str(), rw, rh, ref))
+    {
+        printf("[sim] no reference %s, take it with a run without -r\n", refPath.c_str());
+        return false;
+    }
+    readBmp(outPath.c_str(), w, h, out);
+    if (w != rw || h != rh)
+    {
+        printf("[sim] %s is %d x %d, the reference %d x %d\n", outPath.c_str(), w, h, rw, rh);
+        return false;
+    }
+    int differ = 0;
+    for (size_t i = 0; i + 2 < out.size(); i += 3)
+    {
+        bool same = out[i] == ref[i] && out[i + 1] == ref[i + 1] && out[i + 2] == ref[i + 2];
+        differ += ! same;
+        out[i] = same ? out[i] / 4 : 0;
+        out[i + 1] = same ? out[i + 1] / 4 : 0;
+        out[i + 2] = same ? out[i + 2] / 4 : 255;
+    }
+    if (differ == 0) return true;
+
+    FILE *f = fopen(diffPath.c_str(), "wb");
+    FILE *o = fopen(outPath.c_str(), "rb");
+    lgfx::bitmap_header_t hdr;
+    if (f && o && fread(&hdr, sizeof(hdr), 1, o) == 1)
+    {
+        fwrite(&hdr, sizeof(hdr), 1, f);
+        fwrite(out.data(), out.size(), 1, f);
+    }
+    if (f) fclose(f);
+    if (o) fclose(o);
+    printf("[sim] %s: %d pixels differ from the reference, see %s\n", outPath.c_str(), differ, diffPath.c_str());
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    const char *scriptPath = nullptr;
+    std::string outDir = ".", refDir;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:o:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': scriptPath = optarg; break;
+            case 'o': outDir = optarg; break;
+            case 'r': refDir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-s script] [-o outdir] [-r refdir]\n", argv[0]);
+                return 2;
+        }
+    }
+    FILE *script = scriptPath ? fopen(scriptPath, "r") : stdin;
+    if (! script)
+    {
+        perror(scriptPath);
+        return 2;
+    }
+
+    sim::usHorizon = INT64_MAX;
+    setup();
+
+    int mismatches = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), script))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        char cmd[16] = "";
+        int n = 0;
+        if (sscanf(line, " %15s %n", cmd, &n) < 1 || cmd[0] == '#') continue;
+        const char *arg = line + n;
+        int x0, y0, x1, y1, ms;
+
+        if (strcmp(cmd, "wait") == 0)
+        {
+            runFor(atoi(arg) * 1000LL);
+        }
+        else if (strcmp(cmd, "touch") == 0 && sscanf(arg, "%d %d %d", &x0, &y0, &ms) >= 2)
+        {
+            if (sscanf(arg, "%*d %*d %d", &ms) < 1) ms = 150;
+            sim::touch = { true, x0, y0 };
+            runFor(ms * 1000LL);
+            sim::touch.pressed = false;
+        }
+        else if (strcmp(cmd, "drag") == 0 && sscanf(arg, "%d %d %d %d", &x0, &y0, &x1, &y1) == 4)
+        {
+            if (sscanf(arg, "%*d %*d %*d %*d %d", &ms) < 1) ms = 300;
+            int steps = std::max(1, ms / 10);
+            for (int i = 0; i <= steps; i++)
+            {
+                sim::touch = { true, x0 + (x1 - x0) * i / steps, y0 + (y1 - y0) * i / steps };
+                runFor(10000);
+            }
+            sim::touch.pressed = false;
+        }
+        else if (strcmp(cmd, "serial") == 0)
+        {
+            std::string text = std::string(arg) + "\n";
+            Serial.simFeed(text.data(), text.size());
+        }
+        else if (strcmp(cmd, "shot") == 0 && *arg)
+        {
+            std::string out = outDir + "/" + arg + ".bmp";
+            if (! lcd.simWriteBmp(out.c_str())) printf("[sim] cannot write %s\n", out.c_str());
+            else if (! refDir.empty() && ! compareShot(out, refDir + "/" + arg + ".bmp", outDir + "/" + arg + ".diff.bmp")) mismatches++;
+        }
+        else if (strcmp(cmd, "stats") == 0)
+        {
+            lcd.simStats().print(*arg ? arg : "Display");
+            lcd.simResetStats();
+        }
+        else if (strcmp(cmd, "signal") == 0)
+        {
+            printf("[sim] signal %.3f Hz\n", sim::signalFrequency());
+        }
+        else if (strcmp(cmd, "expect") == 0 && *arg)
+        {
+            if (sim::takeSerialOutput().find(arg) == std::string::npos)
+            {
+                printf("[sim] expected \"%s\" in the serial output\n", arg);
+                mismatches++;
+            }
+        }
+        else if (strcmp(cmd, "capture") == 0 && *arg)
+        {
+            std::string out = outDir + "/" + arg;
+            std::string text = sim::takeSerialOutput();
+            FILE *f = fopen(out.c_str(), "w");
+            if (! f || fwrite(text.data(), 1, text.size(), f) != text.size()) printf("[sim] cannot write %s\n", out.c_str());
+            if (f) fclose(f);
+        }
+        else
+        {
+            printf("[sim] unknown script line: %s\n", line);
+        }
+        fflush(stdout);
+    }
+    printf("[sim] %.3f s simulated\n", sim::now() / 1e6);
+    return mismatches > 0;
+}
@@ -0,0 +1,3 @@
+#pragma once
+#define HSPIQ_IN_IDX 8
+#define VSPIQ_IN_IDX 64
@@ -0,0 +1,50 @@
+#pragma once
+#include "Sim.h"
+
+// The registers of the cosine wave generator with the field layout of the 
+// ESP32, backed by sim::regs. sim::signalFrequency() reads them back.
+
+#define SENS_SAR_DAC_CTRL1_REG  0
+#define SENS_SAR_DAC_CTRL2_REG  1
+#define RTC_CNTL_CLK_CONF_REG   2
+
+#define SENS_SW_FSTEP           0x0000FFFF
+#define SENS_SW_FSTEP_V         0xFFFF
+#define SENS_SW_FSTEP_S         0
+#define SENS_SW_TONE_EN         (1u << 16)
+#define SENS_SW_TONE_EN_M       (1u << 16)
+
+#define SENS_DAC_DC1            0x000000FF
+#define SENS_DAC_DC1_V          0xFF
+#define SENS_DAC_DC1_S          0
+#define SENS_DAC_DC2            0x000000FF
+#define SENS_DAC_DC2_V          0xFF
+#define SENS_DAC_DC2_S          8
+#define SENS_DAC_SCALE1         0x00000003
+#define SENS_DAC_SCALE1_V       0x3
+#define SENS_DAC_SCALE1_S       16
+#define SENS_DAC_SCALE2         0x00000003
+#define SENS_DAC_SCALE2_V       0x3
+#define SENS_DAC_SCALE2_S       18
+#define SENS_DAC_INV1           0x00000003
+#define SENS_DAC_INV1_V         0x3
+#define SENS_DAC_INV1_S         20
+#define SENS_DAC_INV2           0x00000003
+#define SENS_DAC_INV2_V         0x3
+#define SENS_DAC_INV2_S         22
+#define SENS_DAC_CW_EN1_M       (1u << 24)
+#define SENS_DAC_CW_EN2_M       (1u << 25)
+
+#define RTC_CNTL_CK8M_DIV_SEL   0x00000007
+#define RTC_CNTL_CK8M_DIV_SEL_V 0x7
+#define RTC_CNTL_CK8M_DIV_SEL_S 12
+
+#define READ_PERI_REG(r)                (sim::regs[r])
+#define WRITE_PERI_REG(r, v)            (sim::regs[r] = (v))
+#define SET_PERI_REG_MASK(r, m)         (sim::regs[r] |= (m))
+#define CLEAR_PERI_REG_MASK(r, m)       (sim::regs[r] &= ~(m))
+#define GET_PERI_REG_MASK(r, m)         (sim::regs[r] & (m))
+#define SET_PERI_REG_BITS(r, b, v, s)   (sim::regs[r] = (sim::regs[r] & ~((b) << (s))) | (((v) & (b)) << (s)))
+#define GET_PERI_REG_BITS2(r, b, s)     ((sim::regs[r] >> (s)) & (b))
+#define REG_SET_FIELD(r, f, v)          SET_PERI_REG_BITS(r, f##_V, v, f##_S)
+#define REG_GET_FIELD(r, f)             GET_PERI_REG_BITS2(r, f##_V, f##_S)
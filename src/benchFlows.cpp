@@ -0,0 +1,76 @@
+#include <Arduino.h>
+#include "UiFlow.h"
+
+/**
+ * Measure how many flows the runner resumes per millisecond. Each size 
+ * runs for msRun, once with flows that yield at every pass (the cost of
+ * a resume) and once with flows that wait 1 ms in FLOW_DELAY (timers).
+ * A timer flow can fire at most once per ms, so timers/ms equals the
+ * number of flows as long as the runner keeps up.
+ * 
+ * Usage    benchFlows();   // from setup() or with FLOW BENCH
+*/
+class YieldFlow : public UiFlow
+{
+    public:
+        uint32_t count = 0;
+    protected:
+        void run() override
+        {
+            FLOW_BEGIN();
+            while (true)
+            {
+                count++;
+                FLOW_YIELD();
+            }
+            FLOW_END();
+        }
+};
+
+class TimerFlow : public UiFlow
+{
+    public:
+        uint32_t count = 0;
+    protected:
+        void run() override
+        {
+            FLOW_BEGIN();
+            while (true)
+            {
+                FLOW_DELAY(1);
+                count++;
+            }
+            FLOW_END();
+        }
+};
+
+template <typename F>
+static float resumesPerMs(int n, uint32_t msRun)
+{
+    UiFlowRunner runner;
+    std::vector<F> flows(n);
+    for (F &f : flows) runner.start(&f);
+    uint32_t msStart = millis();
+    while (millis() - msStart < msRun) runner.run();
+    uint32_t total = 0;
+    for (F &f : flows) total += f.count;
+    return total / (float)msRun;
+}
+
+void benchFlows()
+{
+    const int sizes[] = { 1, 10, 100, 1000 };
+    const uint32_t msRun = 200;
+
+    Serial.printf(R"(
+UI flow benchmark, %u ms per size
+-----------------
+ flows   yields/ms   us/yield   timers/ms
+)", msRun);
+    for (int n : sizes)
+    {
+        float yields = resumesPerMs<YieldFlow>(n, msRun);
+        float timers = resumesPerMs<TimerFlow>(n, msRun);
+        Serial.printf("%6d  %10.1f  %9.3f  %10.1f\n", n, yields, yields > 0 ? 1000.0f / yields : 0.0f, timers);
+    }
+}
@@ -1,5 +1,7 @@
 #include <Arduino.h>
 #include <SD.h>
+#include "VspiBus.h"
+#include "SdWriter.h"
 
 
 /**
@@ -11,15 +13,18 @@
  * SPIClass sdcardSPI(VSPI);
  * in main.cpp 
  * and pass sdcardSPI as argument to initSDcard()
+ * frequency is the SPI clock, the SD library defaults to 4 MHz.
 */
-void initSDCard(SPIClass &spi)
+void initSDCard(SPIClass &spi, uint32_t frequency)
 {
   // Use custom SPI class
+  vspiAcquire(VspiDevice::SDCARD); // SD.begin() takes MISO from the touch controller,
   spi.begin(TF_SCLK, TF_MISO, TF_MOSI, TF_CS);
-  if (!SD.begin(TF_CS, spi)) // 👉 Use default frequency of 4MHz
+  if (!SD.begin(TF_CS, spi, frequency))
       log_e("==> SD.begin failed!");
   else
       log_e("==> done");
+  vspiRelease(VspiDevice::SDCARD); // the end of the transaction routes it back
 
     // Use default VSPI with pins 5, 18, 19, 23 (CS, SCLK, MISO, MOSI)
 /*     if (!SD.begin()) // 👉 Use default frequency of 4MHz
@@ -35,6 +40,7 @@ void initSDCard(SPIClass &spi)
 void printSDCardInfo()
 {
   const char *knownCardTypes[] = {"NONE", "MMC", "SDSC", "SDHC", "UNKNOWN"};
+  vspiAcquire(VspiDevice::SDCARD);
   sdcard_type_t cardType = SD.cardType();
   //uint64_t numSectors= SD.numSectors();
   //uint64_t sectorSize= SD.sectorSize(); 
@@ -42,6 +48,7 @@ void printSDCardInfo()
   uint64_t cardTotal = SD.totalBytes() >> 20;
   uint64_t cardUsed  = SD.usedBytes() >>  20;
   uint64_t cardFree  = cardTotal - cardUsed; 
+  vspiRelease(VspiDevice::SDCARD);
   Serial.printf(R"(
 SDCard Info
 -----------
@@ -50,7 +57,8 @@ size   %6llu MB
 total  %6llu MB
 used   %6llu MB
 free   %6llu MB
-)", knownCardTypes[cardType], cardSize, cardTotal, cardUsed, cardFree);
+)", knownCardTypes[cardType], (unsigned long long)cardSize, (unsigned long long)cardTotal,
+    (unsigned long long)cardUsed, (unsigned long long)cardFree);
   Serial.printf("\n");  
 }
 
@@ -69,7 +77,11 @@ void listFiles(File dir, int indent=0)
 {
   while (true) 
   {
-    File entry =  dir.openNextFile();
+    File entry;
+    {
+      VspiTransaction bus(VspiDevice::SDCARD);
+      entry = dir.openNextFile();
+    }
 
     if (! entry) break; // no more files
     
@@ -83,8 +95,80 @@ void listFiles(File dir, int indent=0)
     else 
     {
       // files have sizes, directories do not
-      Serial.printf("%s, %d\n", entry.name(), entry.size());
+      Serial.printf("%s, %u\n", entry.name(), (unsigned)entry.size());
     }
+    VspiTransaction bus(VspiDevice::SDCARD);
     entry.close();
   }
-}
\ No newline at end of file
+}
+
+
+/**
+ * Write a test file at several SPI clocks, once with File::write in rows of 
+ * 480 bytes like a 16 bit BMP screenshot and once through SdWriter, and print 
+ * throughput and write latencies. The card is left at the default 4 MHz.
+ * 
+ * Usage    benchSDCard(sdcardSPI);     // after initSDCard()
+*/
+void benchSDCard(SPIClass &spi)
+{
+  const uint32_t clocks[] = { 4000000, 10000000, 20000000, 40000000 };
+  const int rowSize = 480;
+  const int rows = 2048;                  // ~1 MB
+  const char *path = "/bench.tmp";
+  uint8_t row[rowSize];
+  for (int i = 0; i < rowSize; i++) row[i] = i;
+
+  Serial.printf(R"(
+SDCard Benchmark, %d rows of %d bytes
+----------------
+  clock   File MB/s  SdWriter MB/s   p50 us   p90 us   p99 us   max us
+)", rows, rowSize);
+  for (uint32_t clock : clocks)
+  {
+    {
+      VspiTransaction bus(VspiDevice::SDCARD);
+      SD.end();
+    }
+    initSDCard(spi, clock);
+    bool card;
+    {
+      VspiTransaction bus(VspiDevice::SDCARD);
+      card = SD.cardType() != CARD_NONE;
+    }
+    if (! card)
+    {
+      Serial.printf("%4u MHz  no card\n", clock / 1000000);
+      continue;
+    }
+
+    uint32_t usStart = micros();
+    bool ok;
+    {
+      VspiTransaction bus(VspiDevice::SDCARD);
+      File file = SD.open(path, FILE_WRITE);
+      ok = file;
+      for (int r = 0; r < rows && ok; r++) ok = file.write(row, rowSize) == rowSize;
+      file.close();
+    }
+    uint32_t usFile = micros() - usStart;
+
+    SdWriter writer;
+    ok = ok && writer.open(path, rows * rowSize);
+    for (int r = 0; r < rows && ok; r++) ok = writer.write(row, rowSize);
+    ok = writer.close() && ok;
+    SdWriter::Stats w = writer.getStats();
+
+    if (ok)
+      Serial.printf("%4u MHz  %9.3f  %13.3f  %7u  %7u  %7u  %7u\n", clock / 1000000, 
+        rows * rowSize / (float)usFile, w.mBps, w.usP50, w.usP90, w.usP99, w.usMax);
+    else
+      Serial.printf("%4u MHz  write failure\n", clock / 1000000);
+  }
+  {
+    VspiTransaction bus(VspiDevice::SDCARD);
+    SD.remove(path);
+    SD.end();
+  }
+  initSDCard(spi, 4000000);
+}
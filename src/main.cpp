@@ -48,25 +48,53 @@
 #include "lgfx_ESP32_2432S028.h"
 #include "CosineWaveGenerator.h"
 #include "UiComponents.h"
-#include "Wait.h"
+#include "CwSequencer.h"
+#include "CwScpi.h"
+#include "CwProtocol.h"
+#include "Scheduler.h"
+#include "VspiBus.h"
+#include "Screenshot.h"
+#include "TileRecorder.h"
+#include "CwEventLog.h"
+#include "CwPresets.h"
+#include "CwModel.h"
+#include "BootProfiler.h"
+#include "CwSleep.h"
+#include "UiFlow.h"
+#include "UiBench.h"
+#include "UiBudgets.h"
+#include "TouchTrace.h"
+#include "UiScreens.h"
+#include "UiGlyphs.h"
 
 using Action = void(&)(LGFX &lcd);
 enum Rotation {PORTRAIT, LANDSCAPE};
 
 LGFX lcd;
 GFXfont myFont = fonts::DejaVu18;
-//SPIClass sdcardSPI(VSPI); // uncomment line 56, 333 and 352 to take screenshot
+//SPIClass sdcardSPI(VSPI); // uncomment here and at initSDCard() and takeScreenshot() in setup() to take screenshot
 
 constexpr int dig_clk_rtc_freq = 8000000.0;       // 8 MHz assumed operating frequency
 constexpr double f0 = 132.5; //dig_clk_rtc_freq / 65536.0; // = 122.0703125 resulting reference frequency, change it to your measured frequency on startup
 CosineWaveGenerator cwGen(f0);
+CwSequencer sequencer(cwGen);  // plays frequency programs from the SD card
+CwScpi scpi(cwGen, Serial);    // remote control with SCPI-style commands
+CwProtocol cwProto(cwGen, Serial);  // remote control with binary batch frames
+CwEventLog eventLog(cwGen);    // audit trail of all generator changes on the SD card
+CwPresets presets(cwGen);      // last state and user presets in NVS
+CwModel model;                 // settings shown by the panel, see UiPanelCwGen
+BootProfiler boot;             // phases from reset to the first interactive frame
+constexpr bool fastStart = true;  // bring the generator output up before the display is initialized
+constexpr uint32_t msIdleSleep = 0;  // light sleep after this time without input, 0 = never, e.g. 15 * 60 * 1000
+constexpr uint32_t usFrameSlice = 4000;  // drawing of queued repaints per pass of loop()
 
 extern void nop(LGFX &lcd);
 extern void initDisplay(LGFX &lcd, uint8_t rotation=0, lgfx::v1::GFXfont *theFont=&myFont, Action greet=nop);
-extern void initSDCard(SPIClass &spi);
+extern void initSDCard(SPIClass &spi, uint32_t frequency=4000000);
 extern void lcdInfo(LGFX &lcd);
 extern void printSDCardInfo();
-extern bool saveBmpToSD_16bit(LGFX &lcd, const char *filename);
+extern void benchSDCard(SPIClass &spi);
+extern void benchFlows();
 
 class UiPanelTitle : public UiPanel
 {
@@ -77,9 +105,15 @@ class UiPanelTitle : public UiPanel
             if (! _hidden) { show(); }
         }
 
-        void show()
+        int parts() { return bands() + 1; }
+
+        void drawPart(int part)
         {
-            UiPanel::show();
+            if (part < bands())
+            {
+                UiPanel::drawPart(part);
+                return;
+            }
             _lcd.setTextDatum(textdatum_t::middle_left);
             panelText(3, 12, "Cosine Wave Generator", TFT_MAROON, fonts::DejaVu18);
             panelText(20, 28, "f = f0 * step / (1 + divider)", TFT_BLACK, fonts::DejaVu12);
@@ -88,278 +122,1158 @@ class UiPanelTitle : public UiPanel
 };
 
 
+/**
+ * The value fields and the LED of the generator settings. The panel shows
+ * the parameters of the model: a change goes to the model first, then only
+ * the fields and registers of the parameters that changed are updated.
+*/
 class UiPanelCwGen : public UiPanel
 {
     public:
         UiPanelCwGen(LGFX &lcd, int x, int y, int w, int h, int bgColor, bool hidden=true) : 
             UiPanel(lcd, x, y, w, h, bgColor, hidden)
         {
-            _frequency->setRange(15.0, 8000000.0);
-            _f0->setRange(100.0, 150.0);
-            _mode->setRange(0, 3);
-            _divider->setRange(0, 7);
-            _step->setRange(1, 65535);
-            _tolerance->setRange(1, 999);
+            setKeyRepeat(500);
+            for (const Field &f : _fields) { addTouchable(f.btn); }
+            addTouchable(&_presets);
+            addTouchable(&_sweep);
+            show(CwModel::ALL, false);  // the fields show the model
             if (! _hidden) { show(); }
         }
 
-        void show()
+        int parts() { return bands() + 9; }
+
+        void drawPart(int part)
         {
-            UiPanel::show();
-            for (int i = 0; i < _btns.size(); i++)
-            {
-                _btns.at(i)->draw();
-            }
+            int widget = part - bands();
+            if (widget < 0)       UiPanel::drawPart(part);
+            else if (widget < 7)  _fields[widget].btn->draw();
+            else if (widget == 7) _presets.draw();
+            else                  _sweep.draw();
         }
 
-        void handleKeys(int x, int y);
-        std::vector<UiButton *> getButtons() { return _btns; }
+        using UiPanel::show;
+        void apply(UiButton *field);
+        void applySweep(uint8_t changes);
+        void syncWithGenerator();
+        void loadPreset(const CwPreset &p);
+        UiButton *getField(uint8_t param);
+        UiHslider *getSweep() { return &_sweep; }
 
     private:
-      int d = 8;  // distance from the left panel side
-      UiButton *_frequency = new UiButton(this, _x+d, _y+10,  200, 26, defaultTheme, "122.0703125", "f"); 
-      UiButton *_f0        = new UiButton(this, _x+d, _y+50,  135, 26, "122.0703125", "f0");
-      UiButton *_mode      = new UiButton(this, _x+d, _y+90,   30, 26, "2", "Mode 0..3");
-      UiButton *_divider   = new UiButton(this, _x+d, _y+130,  30, 26, "0", "Divider 0..7");
-      UiButton *_step      = new UiButton(this, _x+d, _y+170,  70, 26, "1", "Step 1..65535");
-      UiButton *_tolerance = new UiButton(this, _x+d, _y+210,  70, 26, "10", "Tolerance o/oo");
-      UiButton *_setMatch  = new UiLed(this, _x+d+44, _y+260,  12, TFT_GOLD, "Optimal match", true);
-
-      std::vector<UiButton *> _btns = { _frequency, _f0, _mode, _divider, _step, _tolerance, _setMatch};
+        struct Field
+        {
+            uint8_t param;  // CwModel::FREQUENCY, ...
+            UiButton *btn;
+        };
+
+        static void editField(UiPanel *panel, UiButton *field);
+        static void toggleMatch(UiPanel *panel, UiButton *led);
+        static void openPresets(UiPanel *panel, UiButton *btn);
+        static void sweepFrequency(UiPanel *panel, UiButton *slider);
+        void show(uint8_t changes, bool redraw);
+        uint8_t paramOf(UiButton *btn);
+
+        static constexpr UiWidgetDef _layout[] =
+        { //  x    y    w   h  value          label             min  max        integer  color
+            { 8,   8, 200, 26, "122.0703125", "f",              15.0, 8000000.0, false, 0,        nullptr, editField },
+            { 8,  70, 135, 26, "122.0703125", "f0",             100.0, 150.0,    false, 0,        nullptr, editField },
+            { 8, 106,  30, 26, "2",           "Mode 0..3",      0, 3,            true,  0,        nullptr, editField },
+            { 8, 142,  30, 26, "0",           "Divider 0..7",   0, 7,            true,  0,        nullptr, editField },
+            { 8, 178,  70, 26, "1",           "Step 1..65535",  1, 65535,        true,  0,        nullptr, editField },
+            { 8, 214,  70, 26, "10",          "Tolerance o/oo", 1, 999,          true,  0,        nullptr, editField },
+            { 52, 260, 24, 24, "",            "Optimal match",  0, 0,            false, TFT_GOLD, nullptr, toggleMatch },
+            { 152, 106, 80, 26, "Presets",    "",               0, 0,            false, 0,        nullptr, openPresets },
+            { 8,  44, 200, 12, "",            "",               1.176091259, 6.903089987, false, TFT_GOLD, nullptr, sweepFrequency },  // log10 15 .. 8e6
+        };
+
+        UiButton _frequency { this, &_layout[0] };
+        UiButton _f0        { this, &_layout[1] };
+        UiButton _mode      { this, &_layout[2] };
+        UiButton _divider   { this, &_layout[3] };
+        UiButton _step      { this, &_layout[4] };
+        UiButton _tolerance { this, &_layout[5] };
+        UiLed    _setMatch  { this, &_layout[6], true };
+        UiButton _presets   { this, &_layout[7] };  // opens the presets screen
+        UiHslider _sweep    { this, &_layout[8] };  // log10 of the frequency
+
+        Field _fields[7] = { {CwModel::FREQUENCY, &_frequency}, {CwModel::F0, &_f0}, {CwModel::MODE, &_mode},
+                             {CwModel::DIVIDER, &_divider}, {CwModel::STEP, &_step}, {CwModel::TOLERANCE, &_tolerance},
+                             {CwModel::MATCH, &_setMatch} };
 };
+constexpr UiWidgetDef UiPanelCwGen::_layout[];
+
+
+/**
+ * The user presets 1..9 with their frequency. Touching one recalls it and
+ * returns to the generator screen. The panel only exists while its screen 
+ * is shown.
+*/
+class UiPanelPresets : public UiPanel
+{
+    public:
+        UiPanelPresets(LGFX &lcd, int x, int y, int w, int h, int bgColor, bool hidden=true);
+
+        int parts() { return bands() + _slotCount + 1; }
+
+        void drawPart(int part)
+        {
+            int widget = part - bands();
+            if (widget < 0)               UiPanel::drawPart(part);
+            else if (widget < _slotCount) _slots[widget].draw();
+            else                          _back.draw();
+        }
+
+    private:
+        static void recall(UiPanel *panel, UiButton *slot);
+        static void back(UiPanel *panel, UiButton *btn);
+
+        static const int _slotCount = CwPresets::slots - 1;  // slot 0 is the last state
+        static constexpr UiWidgetDef _layout[_slotCount + 1] =
+        { //  x    y    w   h  value   label  min max integer color
+            { 8,   6,  40, 24, "1",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8,  33,  40, 24, "2",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8,  60,  40, 24, "3",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8,  87,  40, 24, "4",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8, 114,  40, 24, "5",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8, 141,  40, 24, "6",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8, 168,  40, 24, "7",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8, 195,  40, 24, "8",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8, 222,  40, 24, "9",    "",    0, 0,  false, 0, nullptr, recall },
+            { 8, 254,  80, 26, "Back", "",    0, 0,  false, 0, nullptr, back },
+        };
+
+        UiButton _slots[_slotCount] = 
+        {
+            {this, &_layout[0]}, {this, &_layout[1]}, {this, &_layout[2]},
+            {this, &_layout[3]}, {this, &_layout[4]}, {this, &_layout[5]},
+            {this, &_layout[6]}, {this, &_layout[7]}, {this, &_layout[8]},
+        };
+        UiButton _back { this, &_layout[_slotCount] };
+        char _labels[_slotCount][20];
+};
+constexpr UiWidgetDef UiPanelPresets::_layout[];
 
 // Declare pointers to the panels and initialize them with nullptr
 UiPanelTitle *panelTitle = nullptr;
-UiPanelCwGen *panelCwGen = nullptr; 
+UiPanelCwGen *panelCwGen = nullptr;  // pooled, exists from setup() on
+UiScreens screens;        // content panels below the title, see setupScreens()
 
 // Declare the static class variable again in main
 std::vector<UiPanel *> UiPanel::panels;
 
 // Create they keypad hidden
 UiKeypad keypad(lcd, 20,80, TFT_GOLD, true);
-Wait waitUserInput(100);  // look for user input every 100 ms
-
+Scheduler scheduler;      // periodic jobs of loop(), see setupJobs()
+UiFlowRunner flows;       // UI flows that wait without blocking loop()
+TileRecorder recorder(lcd);
+CwSleep sleeper(lcd, presets);  // sleeps until the screen is touched
+UiBench uiBench(lcd);     // UI scenarios measured by UI BENCH
+void replayTouch(int x, int y);
+void sweep(bool dragging);
+void sweepPoll();
+void printSweepStats();
+TouchTrace touchTrace(replayTouch);  // records and replays the touches
 
-void UiPanelCwGen::handleKeys(int x, int y)
+/**
+ * Enter a value field with the keypad: open the keypad, await OK or X, 
+ * apply the value and restore the panels. The keypad takes all touches
+ * while it is open.
+*/
+class EditFlow : public UiFlow
 {
-  //freq = f0 * step / (1 + divi)
-    int mode, step, divi, tol;
-    double f, f0;
+    public:
+        void edit(UiButton *field)
+        {
+            _field = field;
+            flows.start(this);
+        }
 
-    for (int i = 0; i < _btns.size(); i++)
-    {
-        if (_btns.at(i)->touched(x, y)) 
+    protected:
+        void run() override
         {
-            log_i("Key pressed: %d", i);
-            switch(i)
-            {
-                case 0: // frequency
-                    _pKeypad->addValueField(_btns.at(i)); // Register the value field with the keypad
-                    _pKeypad->show(); // show keypad 
-                break;
-
-                case 1: // f0
-                    _pKeypad->addValueField(_btns.at(i)); // Register the value field with the keypad
-                    _pKeypad->show(); // show keypad                    
-                break;
-
-                case 2: // mode
-                    _pKeypad->addValueField(_btns.at(i)); // Register the value field with the keypad
-                    _pKeypad->show(); // show keypad                    
-                break;
-
-                case 3: // divider
-                    _pKeypad->addValueField(_btns.at(i)); // Register the value field with the keypad
-                    _pKeypad->show(); // show keypad                   
-                break;
-
-                case 4: // step
-                    _pKeypad->addValueField(_btns.at(i)); // Register the value field with the keypad
-                    _pKeypad->show(); // show keypad                   
-                break;
-
-                case 5: // tolerance
-                    _pKeypad->addValueField(_btns.at(i)); // Register the value field with the keypad
-                    _pKeypad->show(); // show keypad                   
-                break;
-
-                case 6: // best/optimal match
-                    UiLed * led = reinterpret_cast<UiLed *>(_btns.at(6));
-                    led->toggle();
-                    if (led->isOn())
-                    {
-                        led->setLabel("Optimal match");
-                        panelCwGen->redrawPanels();
-                    } 
-                        
-                    else
-                    {
-                        led->setLabel("Best match");
-                        panelCwGen->redrawPanels();
-                    }
-                break; 
-            }
-            delay(500);
+            FLOW_BEGIN();
+            keypad.open(_field);
+            FLOW_AWAIT(! keypad.isOpen());
+            if (keypad.isAccepted()) panelCwGen->apply(_field);
+            UiPanel::redrawPanels();
+            FLOW_END();
         }
+
+    private:
+        UiButton *_field = nullptr;
+};
+EditFlow editFlow;
+
+
+/**
+ * Touch handlers of the fields, called by UiPanel::touch()
+*/
+void UiPanelCwGen::editField(UiPanel *panel, UiButton *field)
+{
+    log_i("Key pressed: %s", field->getLabel().c_str());
+    editFlow.edit(field);  // open the keypad for the value field
+}
+
+void UiPanelCwGen::toggleMatch(UiPanel *panel, UiButton *led)
+{
+    model.setOptimalMatch(! model.isOptimalMatch());
+    static_cast<UiPanelCwGen *>(panel)->show(model.takeChanges(), true);
+}
+
+void UiPanelCwGen::openPresets(UiPanel *panel, UiButton *btn)
+{
+    screens.post("presets");
+}
+
+void UiPanelCwGen::sweepFrequency(UiPanel *panel, UiButton *slider)
+{
+    double v;
+    slider->getValue(v);
+    model.setFrequency(pow(10.0, v));
+    sweep(static_cast<UiHslider *>(slider)->isDragging());
+}
+
+/**
+ * Write the parameters that changed to the generator. Divider and step go
+ * in one update, so the output never shows half of the change. target is
+ * the frequency they were solved for, 0 if they were set directly.
+*/
+void writeGenerator(uint8_t changes, double target=0.0)
+{
+    CwUpdate u;
+    u.target = target;
+    if (changes & CwModel::F0)      cwGen.setReferenceFrequency(model.getF0());  // before the update, that computes f
+    if (changes & CwModel::DIVIDER) u.setDivi(model.getDivider());
+    if (changes & CwModel::STEP)    u.setStep(model.getStep());
+    if (changes & CwModel::MODE)    u.setMode((CWmode)model.getMode());
+    if (u.mask) cwGen.update(u);
+    if (changes & CwModel::TOLERANCE) cwGen.setToleranceForBestMatch(model.getTolerance());
+}
+
+/**
+ * Apply the value entered into a field with the keypad. Called by EditFlow 
+ * when the keypad is closed with OK, the panels are redrawn after it.
+*/
+void UiPanelCwGen::apply(UiButton *field)
+{
+    int i;
+    double v;
+    uint8_t param = paramOf(field);
+    switch (param)
+    {
+        case CwModel::FREQUENCY: field->getValue(v); model.setFrequency(v); break;
+        case CwModel::F0:        field->getValue(v); model.setF0(v);        break;
+        case CwModel::MODE:      field->getValue(i); model.setMode(i);      break;
+        case CwModel::DIVIDER:   field->getValue(i); model.setDivider(i);   break;
+        case CwModel::STEP:      field->getValue(i); model.setStep(i);      break;
+        case CwModel::TOLERANCE: field->getValue(i); model.setTolerance(i); break;
     }
+    uint8_t changes = model.takeChanges();
+    log_i("f=%.10g, f0=%.10g, divi=%d, step=%d, changed 0x%02x", model.getFrequency(), model.getF0(),
+        model.getDivider(), model.getStep(), changes);
+    writeGenerator(changes, param == CwModel::FREQUENCY ? v : 0.0);
+    show(changes | param, false);  // the field still shows what was typed
+}
+
+/**
+ * Write the changes of the slider samples since the last call and show
+ * them. Called by the sweep job while the knob is dragged.
+*/
+void UiPanelCwGen::applySweep(uint8_t changes)
+{
+    writeGenerator(changes);
+    show(changes, true);
+}
+
+/**
+ * Show the settings of the generator after they were changed remotely.
+ * Only the value fields whose parameter changed are redrawn.
+*/
+void UiPanelCwGen::syncWithGenerator()
+{
+    model.setF0(cwGen.getReferenceFrequency());
+    model.setMode((int)cwGen.getMode(DAC_CHANNEL_2));
+    model.setDivider(cwGen.getClockDivisor());
+    model.setStep(cwGen.getFrequencyStep());
+    model.setTolerance(cwGen.getToleranceForBestMatch());
+    show(model.takeChanges(), true);
 }
 
 /**
- * Update frequency, divider and step when the frequency is entered with
- * the keypad. The function is registered as okCallback in the keypad. 
+ * Show the parameters in changes. A field is only updated if its text
+ * differs and only drawn with redraw.
 */
-void updateFrequency(UiButton *btn)
-{
-    int S[8];       // steps
-    double F[8];    // resulting frequencies
-    double D[8];    // delta abs(f_target - f)
-    int mode, step, divi, tol, s, bestDivider, optimalDivisor;
-    double f, ft, f0, q, minDelta;
-    std::vector<UiButton *> btns = panelCwGen->getButtons();
-
-    if (btn == btns.at(0)) // f
-    {
-        btns.at(0)->getValue(ft);  // get target frequency
-        btns.at(1)->getValue(f0);  // f0
-        q = ft / f0;
-        btns.at(5)->getValue(tol);
-        
-        for (int d = 0; d < 8; d++)
+void UiPanelCwGen::show(uint8_t changes, bool redraw)
+{
+    char buf[24];
+    redraw = redraw && ! _hidden;
+    for (const Field &f : _fields)
+    {
+        if (! (changes & f.param)) continue;
+        switch (f.param)
         {
-            S[d] = round(q * ( 1+ d));
-            F[d] = f0 * S[d] / (1 + d);  // keep step s and resulting frequency f for all divisors d
-            D[d] = abs(ft - F[d]);       // keep difference to target frequency
-            Serial.printf("%d %2d %10.5f %10.5f\n", d, S[d], F[d], D[d]);
+            case CwModel::FREQUENCY: snprintf(buf, sizeof(buf), "%.10g", model.getFrequency()); break;
+            case CwModel::F0:        snprintf(buf, sizeof(buf), "%.10g", model.getF0());        break;
+            case CwModel::MODE:      snprintf(buf, sizeof(buf), "%d", model.getMode());         break;
+            case CwModel::DIVIDER:   snprintf(buf, sizeof(buf), "%d", model.getDivider());      break;
+            case CwModel::STEP:      snprintf(buf, sizeof(buf), "%d", model.getStep());         break;
+            case CwModel::TOLERANCE: snprintf(buf, sizeof(buf), "%d", model.getTolerance());    break;
+            case CwModel::MATCH:
+                if (_setMatch.isOn() == model.isOptimalMatch()) continue;
+                _setMatch.setOn(model.isOptimalMatch());
+                _setMatch.setLabel(model.isOptimalMatch() ? "Optimal match" : "Best match", redraw);
+                continue;
         }
+        if (f.btn->getValue() == buf) continue;
+        redraw ? f.btn->updateValue(String(buf)) : f.btn->setValue(buf);
+    }
+    if ((changes & CwModel::FREQUENCY) && ! _sweep.isDragging()) _sweep.slideToValue(log10(model.getFrequency()), redraw);
+}
 
-        if (reinterpret_cast<UiLed *>(btns.at(6))->isOn())  // Optimal match
-        {  // Find the smallest divider that results in a frequency within specified tolerance.
-            log_i("Search optimal divider/step pair for given tolerance"); 
-            minDelta = ft * tol/1000;
-            bestDivider = 0;
-            for (int d = 0; d < 8; d++)
-            {
-                if (D[d] <= minDelta) { bestDivider = d; d=8;}
-            }  
-        }
-        else  // Best match. Find the best divider/step pair  
-        {     // that best approximates the desired frequency  
-            log_i("Search best divider/step pair for best approximation");   
-            minDelta = D[7];
-            bestDivider = 7;
-            for (int d = 6; d > 0; d--)
-            {
-                if (D[d] <= minDelta) { bestDivider = d; minDelta = D[d]; }
-            }
-        }
-        log_i("Divider=%d / step=%d", bestDivider, S[bestDivider]);
-        f = f0 * S[bestDivider] / (1 + bestDivider);
-        btns.at(3)->updateValue(bestDivider);
-        btns.at(4)->updateValue(S[bestDivider]);
-        btns.at(0)->updateValue(f);
-        cwGen.setClockDivisor(bestDivider);
-        cwGen.setFrequencyStep(S[bestDivider]);
+UiButton *UiPanelCwGen::getField(uint8_t param)
+{
+    for (const Field &f : _fields)
+    {
+        if (f.param == param) return f.btn;
     }
+    return nullptr;
+}
 
-    if (btn == btns.at(1)) // f0
+uint8_t UiPanelCwGen::paramOf(UiButton *btn)
+{
+    for (const Field &f : _fields)
     {
-        btns.at(1)->getValue(f0);
-        btns.at(4)->getValue(step);
-        btns.at(3)->getValue(divi);
-        f = f0 * step / (1.0  + divi);
-        btns.at(0)->updateValue(f);
-        cwGen.setReferenceFrequency(f0);
+        if (f.btn == btn) return f.param;
     }
+    return 0;
+}
+
+/**
+ * The settings shown by the panel fields before anything was changed
+*/
+CwPreset defaultPreset()
+{
+    CwPreset p;
+    p.f0 = 122.0703125;
+    p.mode = (uint8_t)CWmode::CW_SINE;
+    p.divi = 0;
+    p.step = 1;
+    p.tolerance = 10;
+    p.enable = true;
+    p.app = 1;  // optimal match
+    return p;
+}
+
+/**
+ * Set the model to a preset, the changes stay marked
+*/
+void loadModel(const CwPreset &p)
+{
+    model.setF0(p.f0);
+    model.setMode(p.mode);
+    model.setDivider(p.divi);
+    model.setStep(p.step);
+    model.setTolerance(p.tolerance);
+    model.setOptimalMatch(p.app & 1);
+}
 
-    if (btn == btns.at(2)) // mode
+/**
+ * Set the model and the fields to the preset without drawing, show() or 
+ * redrawPanels() draws the panel once. The generator has the preset already.
+*/
+void UiPanelCwGen::loadPreset(const CwPreset &p)
+{
+    loadModel(p);
+    show(model.takeChanges(), false);
+}
+
+
+UiPanelPresets::UiPanelPresets(LGFX &lcd, int x, int y, int w, int h, int bgColor, bool hidden) :
+    UiPanel(lcd, x, y, w, h, bgColor, hidden)
+{
+    CwPreset p;
+    for (int i = 0; i < _slotCount; i++)
     {
-        btns.at(2)->getValue(mode);
-        log_i("Set mode to: %d", mode);
-        cwGen.setMode(DAC_CHANNEL_2, (CWmode)mode);
+        if (presets.load(i + 1, p))
+            snprintf(_labels[i], sizeof(_labels[i]), "%.10g Hz", p.f0 * p.step / (1 + p.divi));
+        else
+            snprintf(_labels[i], sizeof(_labels[i]), "empty");
+        _slots[i].setLabel(_labels[i], false);
+        addTouchable(&_slots[i]);
     }
+    addTouchable(&_back);
+    if (! _hidden) { show(); }
+}
 
-    if (btn == btns.at(3)) // divider
+/**
+ * Apply the preset of the slot and return to the generator. An empty slot 
+ * does nothing.
+*/
+void UiPanelPresets::recall(UiPanel *panel, UiButton *slot)
+{
+    CwPreset p;
+    int i = slot - static_cast<UiPanelPresets *>(panel)->_slots;
+    if (! presets.load(i + 1, p)) return;
+    presets.apply(p);
+    panelCwGen->loadPreset(p);  // drawn when the screen is shown
+    screens.post("generator");
+}
+
+void UiPanelPresets::back(UiPanel *panel, UiButton *btn)
+{
+    screens.post("generator");
+}
+
+/**
+ * Factories of the screens. The generator panel is pooled: it holds the 
+ * keypad and is shown most of the time. The presets panel is deleted when
+ * its screen is left.
+*/
+UiPanel *createGenerator()
+{
+    panelCwGen = new UiPanelCwGen(lcd, 0, 35, lcd.width(), lcd.height(), TFT_MAROON);
+    panelCwGen->addKeypad(&keypad);  // add a keypad to enter numeric values 
+    return panelCwGen;
+}
+
+UiPanel *createPresets()
+{
+    return new UiPanelPresets(lcd, 0, 35, lcd.width(), lcd.height(), TFT_NAVY);
+}
+
+void setupScreens()
+{
+    screens.setHeader(panelTitle);
+    screens.add("generator", createGenerator, true);
+    screens.add("presets",   createPresets);
+}
+
+
+/**
+ * Save the screen as BMP or QOI file on the SD card.
+ * Touch and SD card share VSPI, the capture writes the file
+ * block by block in bus transactions (see VspiBus.h).
+*/
+void takeScreenshot(ScreenshotFormat format=ScreenshotFormat::BMP16)
+{   
+    static int count=0;
+    char buf[64];
+    switch (format)
+    {
+        case ScreenshotFormat::BMP16:
+            snprintf(buf, sizeof(buf), "/SCREENSHOTS/screen%03d.bmp", count++);
+            saveBmpToSD_16bit(lcd, buf);
+        break;
+        case ScreenshotFormat::BMP24:
+            snprintf(buf, sizeof(buf), "/SCREENSHOTS/screen%03d.bmp", count++);
+            saveBmpToSD_24bit(lcd, buf);
+        break;
+        case ScreenshotFormat::QOI:
+            snprintf(buf, sizeof(buf), "/SCREENSHOTS/screen%03d.qoi", count++);
+            saveQoiToSD_16bit(lcd, buf);
+        break;
+    }
+    log_i("Screenshot saved: %s\n", buf);
+}
+
+/**
+ * Capture the screen in all formats and compare size and time
+*/
+void compareScreenshotFormats()
+{
+    CaptureStats bmp16, bmp24, qoi;
+    saveBmpToSD_16bit(lcd, "/SCREENSHOTS/compare16.bmp", &bmp16);
+    saveBmpToSD_24bit(lcd, "/SCREENSHOTS/compare24.bmp", &bmp24);
+    saveQoiToSD_16bit(lcd, "/SCREENSHOTS/compare.qoi", &qoi);
+    Serial.printf(R"(
+Screenshot formats
+------------------
+format       bytes      ms    kB/s
+BMP 16bit  %7u  %6u  %6.1f
+BMP 24bit  %7u  %6u  %6.1f
+QOI        %7u  %6u  %6.1f
+)", bmp16.bytes, bmp16.msTotal, bmp16.kBps, bmp24.bytes, bmp24.msTotal, bmp24.kBps, 
+    qoi.bytes, qoi.msTotal, qoi.kBps);
+}
+
+
+/**
+ * Remote commands of the application
+ * CAPT?          stream a screenshot as QOI in framed chunks (see streamScreenshot.cpp)
+ * BAUD <rate>    switch the baud rate. If no command arrives at the new rate
+ *                within 2 s, the previous rate is restored.
+ * BAUD?          current baud rate
+ * REC ON|OFF     start/stop recording the changed screen tiles to the SD card
+ * REC?           recorder statistics
+ * BUS?           VSPI bus statistics of touch and SD card
+ * LOG ON|OFF     start/stop logging the generator changes to /LOGS/events.cwl
+ * LOG?           event log statistics
+ * *SAV <n>       save the settings as preset n (1..9, 0 is the last state)
+ * *SAV?          preset statistics
+ * *RCL <n>       recall preset n
+ * SLEEP LIGHT|DEEP  sleep until the screen is touched
+ * SLEEP?         sleep statistics
+ * SCHED?         run time and lateness of the loop jobs
+ * FLOW?          UI flow statistics
+ * FLOW BENCH     resumes of flows and timers per millisecond (blocks the UI)
+ * UI BENCH       measure the UI scenarios and compare them with their budgets,
+ *                prints PASS or FAIL, DISABLED without budgets, and saves
+ *                /uibench.csv on the SD card
+ * UI?            results of the last UI BENCH as CSV
+ * UI SCREEN <name>  switch to the screen GENERATOR or PRESETS
+ * UI SCREENS     latency and heap of the last screen switches
+ * UI FRAMES      frame time, slices and input of the queued repaints
+ * UI GLYPHS [ON|OFF]  text from the glyph atlas or LGFX, then the text statistics
+ * UI SWEEP       samples and generator writes of the frequency slider
+ * TOUCH REC [path]  record the touches to the serial port as TOUCH commands,
+ *                or to a file on the SD card
+ * TOUCH <ms> <x> <y> | <ms> UP   add an event to the replay list
+ * TOUCH LOAD <path>  replace the replay list with a recording on the SD card
+ * TOUCH PLAY [FAST]  replay the list at the recorded times or as fast as possible,
+ *                then print the latency of each event and the final state
+ * TOUCH CLEAR    empty the replay list
+ * TOUCH STOP     end the recording or the replay
+ * TOUCH?         report of the last replay and the current state
+*/
+uint32_t baudPrevious = 0;    // rate to restore if the new one does not work
+uint32_t baudCommandCount = 0;
+int baudJob = -1;
+uint32_t msLastInput = 0;     // serial or touch, for the idle sleep
+
+/**
+ * Restores the previous baud rate 2 s after BAUD if no command arrived at the new one
+*/
+void checkBaudFallback(void *)
+{
+    baudJob = -1;  // one-shot, the id is free again
+    if (baudPrevious == 0) return;
+    if (scpi.getCommandCount() == baudCommandCount)  // no command at the new rate
     {
-        btns.at(3)->getValue(divi);
-        btns.at(1)->getValue(f0);
-        btns.at(4)->getValue(step);
-        f = f0 * step / (1.0  + divi);
-        btns.at(0)->updateValue(f);
-        log_i("f=%.3g, f0=%.3g, divi=%d, step=%d", f, f0, divi, step);
-        cwGen.setClockDivisor(divi);         
+        Serial.updateBaudRate(baudPrevious);
     }
+    baudPrevious = 0;
+}
+
+void cmdCapture(const char *arg, bool query, Stream &io)
+{
+    streamScreenshot(lcd, io);
+}
 
-    if (btn == btns.at(4)) // step
+void cmdBaud(const char *arg, bool query, Stream &io)
+{
+    if (query)
     {
-        btns.at(4)->getValue(step);
-        btns.at(1)->getValue(f0);
-        btns.at(3)->getValue(divi);
-        f = f0 * step / (1.0  + divi);
-        btns.at(0)->updateValue(f);
-        log_i("f=%.3g, f0=%.3g, divi=%d, step=%d", f, f0, divi, step);
-        cwGen.setFrequencyStep(step);
+        io.printf("%u\n", Serial.baudRate());
+        return;
     }
+    uint32_t baud = atol(arg);
+    if (baud < 9600 || baud > 3000000)
+    {
+        io.printf("ERR %s out of range 9600..3000000\n", arg);
+        return;
+    }
+    io.println("OK");
+    io.flush();
+    baudPrevious = Serial.baudRate();
+    baudCommandCount = scpi.getCommandCount();
+    Serial.updateBaudRate(baud);
+    scheduler.cancel(baudJob);  // a second BAUD restarts the 2 s
+    baudJob = scheduler.after(2000000, checkBaudFallback, nullptr, "baud");
+}
 
-    if (btn == btns.at(5)) // tolerance
+void cmdRecord(const char *arg, bool query, Stream &io)
+{
+    static int count = 0;
+    char path[40];
+    if (query)
+    {
+        recorder.printStats();
+    }
+    else if (strcasecmp(arg, "ON") == 0)
     {
-        btns.at(5)->getValue(tol); 
-        cwGen.setToleranceForBestMatch(tol);        
+        snprintf(path, sizeof(path), "/SCREENSHOTS/session%03d.cwt", count++);
+        io.println(recorder.begin(path) ? path : "ERR cannot open file");
     }
+    else
+    {
+        recorder.end();
+    }
+}
+
+void cmdBus(const char *arg, bool query, Stream &io)
+{
+    vspiPrintStats();
 }
 
+void cmdLog(const char *arg, bool query, Stream &io)
+{
+    if (query)
+        eventLog.printStats();
+    else if (strcasecmp(arg, "ON") == 0)
+        io.println(eventLog.begin("/LOGS/events.cwl") ? "OK" : "ERR cannot open file");
+    else
+        eventLog.end();
+}
+
+bool argToSlot(const char *arg, Stream &io, int &slot)
+{
+    char *end;
+    slot = strtol(arg, &end, 10);
+    if (end == arg || slot < 0 || slot >= CwPresets::slots)
+    {
+        io.printf("ERR %s out of range 0..%d\n", arg, CwPresets::slots - 1);
+        return false;
+    }
+    return true;
+}
+
+void cmdSave(const char *arg, bool query, Stream &io)
+{
+    int slot;
+    if (query)
+        presets.printStats();
+    else if (argToSlot(arg, io, slot) && ! presets.save(slot, presets.capture(model.isOptimalMatch())))
+        io.println("ERR cannot save preset");
+}
+
+void cmdRecall(const char *arg, bool query, Stream &io)
+{
+    int slot;
+    CwPreset p;
+    if (! argToSlot(arg, io, slot)) return;
+    if (! presets.load(slot, p))
+    {
+        io.printf("ERR preset %d is empty\n", slot);
+        return;
+    }
+    presets.apply(p);
+    model.setOptimalMatch(p.app & 1);  // shown with the fields by syncWithGenerator()
+}
 
 /**
- * 👉 An empty white image is created when SD card 
- * and touch are both active. Why are the pixels
- * not output to the file? 
+ * Sleep until the screen is touched. After a light sleep the
+ * screen is repainted, a deep sleep restarts through setup().
 */
-void takeScreenshot()
-{   
-    static int count=0;
-    char buf[64];
-    snprintf(buf, sizeof(buf), "/SCREENSHOTS/screen%03d.bmp", count++);
-    saveBmpToSD_16bit(lcd, buf);
-    log_i("Screenshot saved: %s\n", buf);
+void goToSleep(SleepMode mode)
+{
+    log_i("==> %s sleep", mode == SleepMode::DEEP ? "deep" : "light");
+    if (mode == SleepMode::DEEP)  // close the files, the RAM is lost
+    {
+        sequencer.stop();
+        recorder.end();
+        eventLog.end();
+    }
+    sleeper.sleep(mode, model.isOptimalMatch());
+    keypad.isHidden() ? UiPanel::redrawPanels() : keypad.show();
+}
+
+void cmdSleep(const char *arg, bool query, Stream &io)
+{
+    if (query)
+        sleeper.printStats();
+    else if (strcasecmp(arg, "LIGHT") == 0)
+        goToSleep(SleepMode::LIGHT);
+    else if (strcasecmp(arg, "DEEP") == 0)
+        goToSleep(SleepMode::DEEP);
+    else
+        io.printf("ERR %s is not LIGHT or DEEP\n", arg);
+}
+
+void cmdScheduler(const char *arg, bool query, Stream &io)
+{
+    scheduler.printStats();
+}
+
+void cmdFlow(const char *arg, bool query, Stream &io)
+{
+    if (query)
+        flows.printStats();
+    else if (strcasecmp(arg, "BENCH") == 0)
+        benchFlows();
+    else
+        io.printf("ERR %s is not BENCH\n", arg);
+}
+
+/**
+ * Pass a touch to the top-most widget under it, -1, -1 when the finger 
+ * was lifted
+*/
+void handleTouch(int x, int y)
+{
+    //log_i("Key pressed at %3d, %3d\n", x, y);
+    UiPanel::touch(x, y);
+}
+
+/**
+ * A replayed touch does what the touch job and the flows do in one pass of 
+ * loop(), so its latency includes the drawing of the flows it resumed
+*/
+void replayTouch(int x, int y)
+{
+    handleTouch(x, y);
+    screens.loop();
+    flows.run();
+}
+
+void tap(UiButton *btn)
+{
+    int x, y;
+    btn->getCenter(x, y);
+    handleTouch(x, y);
+}
+
+/**
+ * Scenarios of UI BENCH. They drive the UI through handleTouch() and the
+ * edit flow like a finger would, only without the pauses. The limits are 
+ * in include/UiBudgets.h.
+*/
+void benchOpenKeypad()
+{
+    tap(panelCwGen->getField(CwModel::FREQUENCY));
+    flows.run();
+}
+
+void benchTypeFrequency()
+{
+    for (const char *key : {"1", "2", "3", "4", "5", "6", "7"}) tap(keypad.getKey(key));
+}
+
+void benchPressOk()
+{
+    tap(keypad.getKey("OK"));
+    flows.run();  // the edit flow applies the value and queues the redraw
+    UiPanel::renderer.flush();
+}
+
+void benchToggleMatch()
+{
+    tap(panelCwGen->getField(CwModel::MATCH));
+}
+
+// the frequency slider from left to right and lift, written once
+void benchDragSlider()
+{
+    int x, y, w, h;
+    panelCwGen->getSweep()->getBounds(x, y, w, h);
+    for (int i = 0; i <= 40; i++) handleTouch(x + 1 + (w - 2) * i / 40, y + h / 2);
+    handleTouch(-1, -1);
+}
+
+void setupBench()
+{
+    uiBench.add("keypad open",   benchOpenKeypad);
+    uiBench.add("type 1234567",  benchTypeFrequency);
+    uiBench.add("press OK",      benchPressOk);
+    uiBench.add("match LED",     benchToggleMatch);
+    uiBench.add("slider drag",   benchDragSlider);
+}
+
+/**
+ * FNV-1a hash of the screen content, to compare the end of two replays
+*/
+uint32_t screenHash()
+{
+    uint16_t row[320];
+    uint32_t hash = 2166136261u;
+    int w = std::min<int>(lcd.width(), 320);
+    for (int y = 0; y < lcd.height(); y++)
+    {
+        lcd.readRect(0, y, w, 1, row);
+        for (int x = 0; x < w; x++) hash = (hash ^ row[x]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * The settings shown by the panel, of the generator and the screen hash,
+ * one line to compare runs
+*/
+void printUiState(Stream &io)
+{
+    UiPanel::renderer.flush();  // the hash of the finished frame
+    auto text = [](uint8_t param) { return panelCwGen->getField(param)->getValue(); };
+    io.printf("STATE ui f=%s f0=%s mode=%s divider=%s step=%s tolerance=%s match=%s keypad=%s screen=%s\n",
+        text(CwModel::FREQUENCY).c_str(), text(CwModel::F0).c_str(), text(CwModel::MODE).c_str(),
+        text(CwModel::DIVIDER).c_str(), text(CwModel::STEP).c_str(), text(CwModel::TOLERANCE).c_str(),
+        model.isOptimalMatch() ? "optimal" : "best", keypad.isOpen() ? "open" : "closed", screens.current());
+    io.printf("STATE gen f=%.10g f0=%.10g mode=%d divider=%d step=%d\n", cwGen.getActualFrequency(),
+        cwGen.getReferenceFrequency(), (int)cwGen.getMode(DAC_CHANNEL_2), cwGen.getClockDivisor(), cwGen.getFrequencyStep());
+    io.printf("STATE screen %08x\n", screenHash());
+}
+
+void cmdTouch(const char *arg, bool query, Stream &io)
+{
+    bool ok = true;
+    if (query)
+    {
+        touchTrace.printReport();
+        printUiState(io);
+        return;
+    }
+    if (strncasecmp(arg, "REC", 3) == 0)
+        ok = arg[3] == 0 ? touchTrace.record(io) : touchTrace.record(arg + 4);
+    else if (strncasecmp(arg, "PLAY", 4) == 0)
+        ok = touchTrace.play(strcasecmp(arg + 4, " FAST") == 0);
+    else if (strncasecmp(arg, "LOAD ", 5) == 0)
+        ok = touchTrace.load(arg + 5);
+    else if (strcasecmp(arg, "CLEAR") == 0)
+        touchTrace.clear();
+    else if (strcasecmp(arg, "STOP") == 0)
+        touchTrace.stop();
+    else
+        ok = touchTrace.add(arg);
+    if (! ok) io.printf("ERR TOUCH %s\n", arg);
+}
+
+void cmdUi(const char *arg, bool query, Stream &io)
+{
+    if (query)
+    {
+        uiBench.printCsv(io);
+        return;
+    }
+    if (strcasecmp(arg, "SCREENS") == 0)
+    {
+        screens.printStats();
+        return;
+    }
+    if (strcasecmp(arg, "FRAMES") == 0)
+    {
+        UiPanel::renderer.printStats(usFrameSlice);
+        return;
+    }
+    if (strcasecmp(arg, "SWEEP") == 0)
+    {
+        printSweepStats();
+        return;
+    }
+    if (strncasecmp(arg, "GLYPHS", 6) == 0)
+    {
+        if (strcasecmp(arg + 6, " ON") == 0) uiGlyphs.setDirect(false);
+        else if (strcasecmp(arg + 6, " OFF") == 0) uiGlyphs.setDirect(true);
+        uiGlyphs.printStats();
+        return;
+    }
+    if (strcasecmp(arg, "BENCH") != 0 && strncasecmp(arg, "SCREEN ", 7) != 0)
+    {
+        io.printf("ERR %s is not BENCH, SCREEN <name>, SCREENS, FRAMES, GLYPHS or SWEEP\n", arg);
+        return;
+    }
+    if (! keypad.isHidden())
+    {
+        io.println("ERR close the keypad first");
+        return;
+    }
+    if (strncasecmp(arg, "SCREEN ", 7) == 0)
+    {
+        if (! screens.show(arg + 7)) io.printf("ERR no screen %s\n", arg + 7);
+        return;
+    }
+    screens.show("generator");  // the scenarios use its fields
+    CwPreset saved = presets.capture(model.isOptimalMatch());
+    int failed = uiBench.run(uiBudgets, uiBudgetCount);
+    presets.apply(saved);  // the scenarios changed the frequency and the match mode
+    panelCwGen->loadPreset(saved);
+    UiPanel::redrawPanels();
+
+    uiBench.printResults();
+    bool card;
+    {
+        VspiTransaction bus(VspiDevice::SDCARD);
+        card = SD.cardType() != CARD_NONE;
+    }
+    if (card) uiBench.saveCsv("/uibench.csv");  // SdWriter takes the bus per block
+    const UiBench::Result *results;
+    int measured = uiBench.getResults(results);
+    if (uiBench.getChecked() == 0)
+    {
+        io.printf("DISABLED %d scenarios measured, no calibrated budgets in UiBudgets.h\n", measured);
+        return;
+    }
+    io.printf("%s %d of %d scenarios over budget\n", failed ? "FAIL" : "PASS", failed, uiBench.getChecked());
+}
+
+/**
+ * Jobs of loop(). Each one runs at its own period, loop() sleeps in between.
+*/
+int touchJob = -1;
+int dragJob = -1;                       // polls the touch while a widget is dragged
+bool sweeping = false;                  // the knob of the frequency slider is dragged
+constexpr uint32_t usDragPoll = 10000;
+constexpr uint32_t usSweepWrite = 20000;
+uint8_t sweepChanges = 0;               // of the samples since the last write
+uint32_t usSweepStart = 0;
+uint32_t usSweepWritten = 0;            // start of the last write
+uint32_t usSweepPending = 0;            // since when sweepChanges waits for its write
+struct SweepStats
+{
+    uint32_t drags;
+    uint32_t samples;       // new knob positions
+    uint32_t writes;        // to the generator
+    uint32_t usMaxWrite;    // with the redraw of the fields
+    uint32_t usMaxLag;      // from a sample that changed the frequency to its write
+    uint64_t usDragged;
+} sweepStats;
+
+void pollTouch(void *)
+{
+    int x, y;
+    bool polled, touched;
+    static uint32_t skipped = 0;
+    Scheduler::Stats job;
+    {
+        VspiTransaction bus(VspiDevice::TOUCH, 0);  // skip the poll while the SD card owns the bus
+        polled = bool(bus);
+        touched = polled && lcd.getTouch(&x, &y);
+    }
+    scheduler.getStats(touchJob, job);
+    if (UiPanel::renderer.isBusy()) UiPanel::renderer.countInput(touched, job.skipped - skipped);
+    skipped = job.skipped;
+    if (polled) touchTrace.sample(touched, x, y);
+    if (touched && ! touchTrace.isPlaying())  // a replay owns the touch handler
+    {
+        msLastInput = millis();
+        handleTouch(x, y);
+    }
+    else if (polled && ! touchTrace.isPlaying())
+    {
+        handleTouch(-1, -1);  // lifted
+    }
+    if (sweeping) sweepPoll();
+    if (UiPanel::isDragging() && dragJob < 0)  // follow the finger closely
+    {
+        dragJob = scheduler.every(usDragPoll, pollTouch, nullptr, "drag");
+    }
+    else if (! UiPanel::isDragging() && dragJob >= 0)
+    {
+        scheduler.cancel(dragJob);
+        dragJob = -1;
+    }
+}
+
+/**
+ * Frequency sweep with the slider below the frequency field. Every sample
+ * of the drag goes to the model, the generator and the fields follow with
+ * the changes of all samples since the last write. The write is done by the
+ * drag poll, every second one at usDragPoll, so the output follows the
+ * finger at 50 Hz. A job of its own at usSweepWrite would compete with the
+ * poll and lose periods whenever a write with its redraw overran. The value
+ * under the finger when it is lifted is written at once.
+*/
+void writeSweep()
+{
+    if (sweepChanges == 0) return;
+    uint32_t usStart = micros();
+    panelCwGen->applySweep(sweepChanges);
+    sweepChanges = 0;
+    usSweepWritten = usStart;
+    sweepStats.writes++;
+    sweepStats.usMaxLag = std::max(sweepStats.usMaxLag, usStart - usSweepPending);
+    sweepStats.usMaxWrite = std::max(sweepStats.usMaxWrite, micros() - usStart);
+}
+
+/**
+ * Called by the drag poll. Writes if usSweepWrite passed since the last
+ * write, less half a poll for the jitter of the poll.
+*/
+void sweepPoll()
+{
+    if (micros() - usSweepWritten >= usSweepWrite - usDragPoll / 2) writeSweep();
+}
+
+void sweep(bool dragging)
+{
+    uint8_t changes = model.takeChanges();
+    if (changes && ! sweepChanges) usSweepPending = micros();
+    sweepChanges |= changes;
+    if (dragging)
+    {
+        sweepStats.samples++;
+        if (sweeping) return;
+        sweeping = true;
+        sweepStats.drags++;
+        usSweepStart = micros();
+        usSweepWritten = usSweepStart - usSweepWrite;  // the first sample is written by the next poll
+        return;
+    }
+    sweeping = false;
+    writeSweep();
+    sweepStats.usDragged += micros() - usSweepStart;
+}
+
+void printSweepStats()
+{
+    const SweepStats &s = sweepStats;
+    double seconds = s.usDragged / 1e6;
+    Serial.printf(R"(
+UI sweep
+--------
+drags      %6u, %.2f s
+samples    %6u, %.1f per s
+writes     %6u, %.1f per s, %u samples coalesced
+write us   %6u max
+lag us     %6u max, %s
+)", s.drags, seconds, s.samples, seconds > 0 ? s.samples / seconds : 0.0, s.writes, 
+    seconds > 0 ? s.writes / seconds : 0.0, s.samples > s.writes ? s.samples - s.writes : 0, s.usMaxWrite,
+    s.usMaxLag, s.usMaxLag <= usSweepWrite ? "follows at 50 Hz" : "SLOWER than 50 Hz");
+}
+
+void captureTiles(void *)
+{
+    if (recorder.isRecording()) recorder.capture();
+}
+
+void savePresets(void *)
+{
+    presets.loop(model.isOptimalMatch());  // saves the last state once it settled
+}
+
+/**
+ * Light sleep after msIdleSleep without input, but not while work is pending
+ * that the sleep would stop: a running sequence, timed batches, recording or
+ * logging.
+ */
+bool isBusy()
+{
+    return sequencer.isRunning() || cwProto.usUntilNext() >= 0 || recorder.isRecording() || eventLog.isLogging();
+}
+
+void checkIdle(void *)
+{
+    if (msIdleSleep > 0 && millis() - msLastInput > msIdleSleep && ! isBusy())
+    {
+        goToSleep(SleepMode::LIGHT);
+        msLastInput = millis();
+    }
+}
+
+void setupJobs()
+{
+    touchJob = scheduler.every(100000, pollTouch, nullptr, "touch");  // look for user input every 100 ms
+    scheduler.every(500000,  captureTiles, nullptr, "record");  // capture the changed tiles while recording
+    scheduler.every(500000,  savePresets,  nullptr, "presets");
+    scheduler.every(1000000, checkIdle,    nullptr, "idle");
+    Serial.onReceive([]() { scheduler.wake(); });  // end the idle sleep for remote commands
 }
 
 
 void setup() 
 {
+  boot.mark("setup");           // runtime startup until setup() is called
+
+  // Resume from deep sleep, restore the last state or start with the defaults
+  CwPreset last;
+  bool warm = sleeper.warmStart(last);  // NVS is opened later, the snapshot is in RTC memory
+  bool restored = warm || (presets.begin() && presets.load(0, last));
+  if (! restored) last = defaultPreset();
+  boot.mark("nvs");
+  if (fastStart)  // signal first, the display follows
+  {
+    presets.apply(last);
+    boot.signal();
+  }
+
+  Serial.setRxBufferSize(1024);  // buffer remote commands while the UI is busy
+  Serial.setTxBufferSize(4096);  // keep the screenshot stream going while encoding
   Serial.begin(115200);
+  scpi.addCommand("CAPT", cmdCapture);
+  scpi.addCommand("BAUD", cmdBaud);
+  scpi.addCommand("REC",  cmdRecord);
+  scpi.addCommand("BUS",  cmdBus);
+  scpi.addCommand("LOG",  cmdLog);
+  scpi.addCommand("*SAV", cmdSave);
+  scpi.addCommand("*RCL", cmdRecall, true);
+  scpi.addCommand("SLEEP", cmdSleep);
+  scpi.addCommand("SCHED", cmdScheduler);
+  scpi.addCommand("FLOW",  cmdFlow);
+  scpi.addCommand("UI",    cmdUi);
+  scpi.addCommand("TOUCH", cmdTouch);
+  boot.mark("serial");
 
   lcd.setBaseColor(DARKERGREY);
   initDisplay(lcd, Rotation::PORTRAIT, &myFont, lcdInfo);
+  boot.mark("display");
   
   //initSDCard(sdcardSPI);      // Init SD card to take screenshots
   //printSDCardInfo();          // Print SD card details
+  //benchSDCard(sdcardSPI);     // Compare write speed and latency at several SPI clocks
+  //benchFlows();               // Resumes of UI flows and timers per millisecond
+  //sequencer.begin("/PROGRAMS/sweep.csv");  // Play a program from the SD card
+  //eventLog.begin("/LOGS/events.cwl");       // Log all generator changes to the SD card
 
-  // Create the panels and showm them ( argument hidden is set to false)
+  // Create the title, the generator screen is built from the model and painted once
+  bool paintOnce = fastStart || restored;
   panelTitle = new UiPanelTitle(lcd, 0, 0,  lcd.width(), 35, TFT_GOLD,  false);
-  panelCwGen = new UiPanelCwGen(lcd, 0, 35, lcd.width(), lcd.height(), TFT_MAROON,  false);
-  panelCwGen->addKeypad(&keypad);         // add a keypad to enter numeric values 
-  keypad.addOkCallback(updateFrequency);  // callback called when OK is tapped on the keyboard
+  setupScreens();
 
-  // Initialize the static class variable with all panels
-  UiPanel::panels = { panelTitle, panelCwGen };
-
-  cwGen.enable(DAC_CHANNEL_2);  // CYD uses DAC_CHANNEL_1 for CDS-LDR
+  if (paintOnce)  // one register update and one redraw
+  {
+    if (! fastStart)
+    {
+      presets.apply(last);
+      boot.signal();
+    }
+    loadModel(last);
+    model.takeChanges();  // the generator has them already
+  }
+  screens.show("generator");
+  if (! paintOnce)
+  {
+    cwGen.enable(DAC_CHANNEL_2);  // CYD uses DAC_CHANNEL_1 for CDS-LDR
 
-  // Initialize the settings
-  updateFrequency(panelCwGen->getButtons().at(1));
-  updateFrequency(panelCwGen->getButtons().at(3));
-  updateFrequency(panelCwGen->getButtons().at(4));
+    writeGenerator(CwModel::ALL);  // the settings the panel shows
+    boot.signal();
+  }
+  boot.mark("panels");
+  if (warm) presets.begin();
+  setupJobs();
+  setupBench();
+  UiPanel::setKeyClock([]() { return touchTrace.msClock(); });
+  UiPanel::renderer.setPreempt([]() { return Serial.available() > 0 || cwProto.usUntilNext() == 0; });
 
   //takeScreenshot(); // uncomment to take screenshot on startup
+  //compareScreenshotFormats(); // uncomment to compare the screenshot formats
 }
 
 
 void loop() 
 {
-    int x, y;
-    if (waitUserInput.isOver() && lcd.getTouch(&x, &y))
+    static bool remoteChanged = false;
+
+    boot.interactive();     // prints the boot profile once
+    sleeper.interactive();  // records the wake-up latency once after a sleep
+
+    if (Serial.available() > 0) msLastInput = millis();
+    while (Serial.available() > 0)  // binary frames and text commands share the port
+    {
+        char c = Serial.read();
+        if (! cwProto.feed(c)) remoteChanged |= scpi.feed(c);
+    }
+    remoteChanged |= cwProto.loop();
+    if (remoteChanged && keypad.isHidden())  // keep the panel in sync with remote changes
     {
-        //log_i("Key pressed at %3d, %3d\n", x, y);
-        if (!panelCwGen->isHidden()) panelCwGen->handleKeys(x, y);
-        if (!keypad.isHidden())      keypad.handleKeys(x, y);
+        panelCwGen->syncWithGenerator();
+        remoteChanged = false;
     }
+
+    scheduler.run();
+    screens.loop();  // the switch a touch handler asked for
+    if (touchTrace.loop())  // the replay has ended
+    {
+        touchTrace.printReport();
+        printUiState(Serial);
+    }
+    flows.run();  // continues the flows whose condition came true in the jobs
+    UiPanel::renderer.run(usFrameSlice);  // a slice of the queued repaints, input first
+
+    int64_t usMax = 1000000;
+    int32_t usBatch = cwProto.usUntilNext();  // a timed batch must not wait for the next job
+    int32_t msFlow  = flows.msUntilNext();
+    int32_t usTouch = touchTrace.usUntilNext();
+    if (usBatch >= 0) usMax = std::min<int64_t>(usMax, usBatch);
+    if (usTouch >= 0) usMax = std::min<int64_t>(usMax, usTouch);
+    if (msFlow  >= 0) usMax = std::min<int64_t>(usMax, msFlow * 1000);
+    if (UiPanel::renderer.isBusy()) usMax = 0;
+    scheduler.idle(usMax);
 }
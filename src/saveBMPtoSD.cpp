@@ -1,64 +1,180 @@
 #include <Arduino.h>
-#include <SD.h>
 #include <LovyanGFX.hpp>
 #include "lgfx_ESP32_2432S028.h"
+#include "SdWriter.h"
+#include "Screenshot.h"
+#include "QoiEncoder.h"
 
+/**
+ * Screenshots are captured in blocks of rows. While one block is read from
+ * the display (HSPI), a writer task stores the previous block on the SD card
+ * (VSPI). The two blocks are used in turn (ping-pong). The writer task hands
+ * the blocks to an SdWriter, which writes the file in whole, aligned buffers
+ * and preallocates it when the size is known (BMP).
+ * The screen can be saved as BMP or as QOI image. QOI is a simple lossless
+ * compression that shrinks the flat areas of the UI to a few bytes.
+ */
 
-bool saveBmpToSD_16bit(LGFX &lcd, const char *filename)
+static const int rowsPerBlock = 16;
+
+struct CaptureJob
 {
-  bool result = false;
-  File file = SD.open(filename, "w");
-  if (file)
-  {
-    int width  = lcd.width();
-    int height = lcd.height();
+    SdWriter writer;
+    uint8_t *block[2];
+    int      len[2];
+    QueueHandle_t full;            // indices of blocks ready to be written
+    QueueHandle_t free;            // indices of blocks ready to be filled
+    uint32_t bytes;                // bytes handed to the writer
+    bool     ok;
+};
 
-    int rowSize = (2 * width + 3) & ~ 3;
+static void freeCapture(CaptureJob *job)
+{
+    if (job->full) vQueueDelete(job->full);
+    if (job->free) vQueueDelete(job->free);
+    free(job->block[0]);
+    free(job->block[1]);
+    delete job;
+}
 
-    lgfx::bitmap_header_t bmpheader;
-    bmpheader.bfType = 0x4D42;
-    bmpheader.bfSize = rowSize * height + sizeof(bmpheader);
-    bmpheader.bfOffBits = sizeof(bmpheader);
+static void writerTask(void *arg)
+{
+    CaptureJob &job = *static_cast<CaptureJob *>(arg);
+    int i;
 
-    bmpheader.biSize = 40;
-    bmpheader.biWidth = width;
-    bmpheader.biHeight = height;
-    bmpheader.biPlanes = 1;
-    bmpheader.biBitCount = 16;
-    bmpheader.biCompression = 3;
+    while (xQueueReceive(job.full, &i, portMAX_DELAY) == pdTRUE && i >= 0)
+    {
+        job.ok &= job.writer.write(job.block[i], job.len[i]);  // one bus transaction per buffer
+        xQueueSend(job.free, &i, portMAX_DELAY);
+    }
+    job.ok &= job.writer.close();
+
+    i = -1;
+    xQueueSend(job.free, &i, portMAX_DELAY);  // report completion
+    vTaskDelete(nullptr);
+}
 
-    file.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
-    std::uint8_t buffer[rowSize];
-    memset(&buffer[rowSize - 4], 0, 4);
-    for (int y = lcd.height() - 1; y >= 0; y--)
+/**
+ * Read the rows yTop .. yTop+n-1 into buf in bottom-up order as required by BMP
+ */
+static void readRowsBottomUp(LGFX &lcd, int yTop, int n, int bitCount, int rowSize, uint8_t *buf)
+{
+    int width = lcd.width();
+    int bytesPerRow = width * bitCount / 8;
+
+    if (bytesPerRow == rowSize)  // no padding, read the block at once and reverse the rows
+    {
+        if (bitCount == 16) lcd.readRect(0, yTop, width, n, (lgfx::rgb565_t*)buf);
+        else                lcd.readRect(0, yTop, width, n, (lgfx::rgb888_t*)buf);
+        uint8_t tmp[rowSize];
+        for (int a = 0, b = n - 1; a < b; a++, b--)
+        {
+            memcpy(tmp, &buf[a * rowSize], rowSize);
+            memcpy(&buf[a * rowSize], &buf[b * rowSize], rowSize);
+            memcpy(&buf[b * rowSize], tmp, rowSize);
+        }
+    }
+    else
+    {
+        for (int r = 0; r < n; r++)
+        {
+            uint8_t *row = &buf[(n - 1 - r) * rowSize];
+            if (bitCount == 16) lcd.readRect(0, yTop + r, width, 1, (lgfx::rgb565_t*)row);
+            else                lcd.readRect(0, yTop + r, width, 1, (lgfx::rgb888_t*)row);
+            memset(&row[bytesPerRow], 0, rowSize - bytesPerRow);
+        }
+    }
+}
+
+/**
+ * Open the file, allocate the two blocks and start the writer task.
+ * fileSize is preallocated if known, 0 otherwise.
+ * Returns nullptr on failure.
+ */
+static CaptureJob *beginCapture(const char *filename, int blockSize, uint32_t fileSize)
+{
+    CaptureJob *job = new CaptureJob();
+    job->writer.open(filename, fileSize);
+    job->block[0] = (uint8_t *)malloc(blockSize);
+    job->block[1] = (uint8_t *)malloc(blockSize);
+    job->full = xQueueCreate(2, sizeof(int));
+    job->free = xQueueCreate(3, sizeof(int));
+    job->ok = true;
+
+    if (job->writer.isOpen() && job->block[0] && job->block[1] && job->full && job->free)
     {
-      lcd.readRect(0, y, lcd.width(), 1, (lgfx::rgb565_t*)buffer);
-      file.write(buffer, rowSize);
+        for (int i = 0; i < 2; i++) xQueueSend(job->free, &i, 0);
+        xTaskCreate(writerTask, "capWriter", 4096, job, uxTaskPriorityGet(nullptr), nullptr);
+        return job;
     }
-    file.close();
-    result = true;
-  }
-  else
-  {
-    Serial.print("error:file open failure\n");
-  }
-
-  return result;
+
+    if (! job->writer.isOpen())
+    {
+        Serial.print("error:file open failure\n");
+    }
+    else
+    {
+        Serial.print("error:out of memory\n");
+    }
+    freeCapture(job);  // closes the file
+    return nullptr;
+}
+
+/**
+ * Wait for a block that can be filled
+ */
+static int nextBlock(CaptureJob *job)
+{
+    int i;
+    xQueueReceive(job->free, &i, portMAX_DELAY);
+    return i;
 }
 
+/**
+ * Hand the filled block over to the writer
+ */
+static void submitBlock(CaptureJob *job, int i, int len)
+{
+    job->len[i] = len;
+    job->bytes += len;
+    xQueueSend(job->full, &i, portMAX_DELAY);
+}
 
-bool saveBmpToSD_24bit(LGFX &lcd, const char *filename)
+/**
+ * Wait for the writer to close the file, report and release the job
+ */
+static bool endCapture(CaptureJob *job, const char *filename, uint32_t msStart, CaptureStats *stats)
 {
-  bool result = false;
-  File file = SD.open(filename, "w");
-  if (file)
-  {
+    int i = -1;
+    xQueueSend(job->full, &i, portMAX_DELAY);
+    do { xQueueReceive(job->free, &i, portMAX_DELAY); } while (i >= 0);  // wait for the writer
+
+    bool result = job->ok;
+    if (! result) Serial.print("error:file write failure\n");
+
+    uint32_t ms = millis() - msStart;
+    uint32_t bytes = job->bytes;
+    log_i("%s: %u bytes in %u ms, %.1f kB/s", filename, bytes, ms, ms ? bytes / (float)ms : 0.0f);
+    SdWriter::Stats w = job->writer.getStats();
+    log_i("%u writes, latency p50 %u us, p99 %u us, max %u us", w.writes, w.usP50, w.usP99, w.usMax);
+    if (stats) *stats = { ms, bytes, ms ? bytes / (float)ms : 0.0f };
+
+    freeCapture(job);
+    return result;
+}
+
+static bool saveBmpToSD(LGFX &lcd, const char *filename, int bitCount, CaptureStats *stats)
+{
+    uint32_t msStart = millis();
     int width  = lcd.width();
     int height = lcd.height();
+    int rowSize = (bitCount / 8 * width + 3) & ~ 3;
 
-    int rowSize = (3 * width + 3) & ~ 3;
+    CaptureJob *job = beginCapture(filename, rowsPerBlock * rowSize, rowSize * height + sizeof(lgfx::bitmap_header_t));
+    if (! job) return false;
 
     lgfx::bitmap_header_t bmpheader;
+    memset(&bmpheader, 0, sizeof(bmpheader));
     bmpheader.bfType = 0x4D42;
     bmpheader.bfSize = rowSize * height + sizeof(bmpheader);
     bmpheader.bfOffBits = sizeof(bmpheader);
@@ -67,24 +183,86 @@ bool saveBmpToSD_24bit(LGFX &lcd, const char *filename)
     bmpheader.biWidth = width;
     bmpheader.biHeight = height;
     bmpheader.biPlanes = 1;
-    bmpheader.biBitCount = 24;
-    bmpheader.biCompression = 0;
+    bmpheader.biBitCount = bitCount;
+    bmpheader.biCompression = bitCount == 16 ? 3 : 0;
+
+    int i = nextBlock(job);
+    memcpy(job->block[i], &bmpheader, sizeof(bmpheader));
+    submitBlock(job, i, sizeof(bmpheader));
+
+    for (int yBottom = height; yBottom > 0; yBottom -= rowsPerBlock)
+    {
+        int n = std::min(rowsPerBlock, yBottom);
+        i = nextBlock(job);
+        readRowsBottomUp(lcd, yBottom - n, n, bitCount, rowSize, job->block[i]);
+        submitBlock(job, i, n * rowSize);
+    }
+
+    return endCapture(job, filename, msStart, stats);
+}
+
+/**
+ * Save the screen as QOI image. The rows are read in blocks and 
+ * encoded into the blocks handed to the writer. A block is passed on 
+ * as soon as the next row might not fit into it anymore.
+ */
+static bool saveQoiToSD(LGFX &lcd, const char *filename, CaptureStats *stats)
+{
+    uint32_t msStart = millis();
+    int width  = lcd.width();
+    int height = lcd.height();
+    int blockSize = rowsPerBlock * 2 * width;
+    int rowMax = QoiEncoder::maxEncodedSize(width) + QoiEncoder::endSize;
 
-    file.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
-    std::uint8_t buffer[rowSize];
-    memset(&buffer[rowSize - 4], 0, 4);
-    for (int y = lcd.height() - 1; y >= 0; y--)
+    uint16_t *rows = (uint16_t *)malloc(blockSize);
+    CaptureJob *job = rows ? beginCapture(filename, std::max(blockSize, rowMax + QoiEncoder::headerSize), 0) : nullptr;
+    if (! job)
     {
-      lcd.readRect(0, y, lcd.width(), 1, (lgfx::rgb888_t*)buffer);
-      file.write(buffer, rowSize);
+        free(rows);
+        return false;
     }
-    file.close();
-    result = true;
-  }
-  else
-  {
-    Serial.print("error:file open failure\n");
-  }
-
-  return result;
-}
\ No newline at end of file
+
+    QoiEncoder qoi;
+    int i = nextBlock(job);
+    int len = qoi.begin(width, height, job->block[i]);
+    int capacity = std::max(blockSize, rowMax + QoiEncoder::headerSize);
+
+    for (int y = 0; y < height; y += rowsPerBlock)
+    {
+        int n = std::min(rowsPerBlock, height - y);
+        lcd.readRect(0, y, width, n, (lgfx::rgb565_t*)rows);
+        for (int r = 0; r < n; r++)
+        {
+            if (len + rowMax > capacity)
+            {
+                submitBlock(job, i, len);
+                i = nextBlock(job);
+                len = 0;
+            }
+            len += qoi.encode565(&rows[r * width], width, &job->block[i][len]);
+        }
+    }
+    len += qoi.end(&job->block[i][len]);
+    submitBlock(job, i, len);
+    free(rows);
+
+    return endCapture(job, filename, msStart, stats);
+}
+
+
+bool saveBmpToSD_16bit(LGFX &lcd, const char *filename, CaptureStats *stats)
+{
+    return saveBmpToSD(lcd, filename, 16, stats);
+}
+
+
+bool saveBmpToSD_24bit(LGFX &lcd, const char *filename, CaptureStats *stats)
+{
+    return saveBmpToSD(lcd, filename, 24, stats);
+}
+
+
+bool saveQoiToSD_16bit(LGFX &lcd, const char *filename, CaptureStats *stats)
+{
+    return saveQoiToSD(lcd, filename, stats);
+}
@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <LovyanGFX.hpp>
+#include "lgfx_ESP32_2432S028.h"
+#include "Screenshot.h"
+#include "QoiEncoder.h"
+#include "CwProtocol.h"
+
+/**
+ * Streams the screen as QOI image over a serial port, no SD card needed.
+ * The image is sent in COBS framed chunks that use the framing and CRC of
+ * the binary control protocol (see CwProtocol.h):
+ *
+ *   0x00 COBS(type(1) seq(2) data(n) crc(2)) 0x00
+ *   type 0x91  begin  data = width(2) height(2) format(1, 0 = QOI)
+ *        0x92  chunk  data = up to 240 bytes of the QOI file
+ *        0x93  end    data = file size(4) capture time in ms(4)
+ *
+ * seq counts the frames of one screenshot from 0, so the receiver detects
+ * lost chunks. Text output between the frames is ignored by the receiver.
+ * tools/cwscreen.py reassembles the images and writes PNG files.
+ */
+
+enum StreamFrame : uint8_t { SF_BEGIN = 0x91, SF_CHUNK = 0x92, SF_END = 0x93 };
+
+static const int chunkSize = 240;
+static const int rowsPerBlock = 16;
+
+static void sendFrame(Stream &io, uint8_t type, uint16_t seq, const uint8_t *data, int len)
+{
+    uint8_t p[3 + chunkSize + 2];
+    p[0] = type;
+    p[1] = seq & 0xff;
+    p[2] = seq >> 8;
+    memcpy(&p[3], data, len);
+    uint16_t crc = CwProtocol::crc16(p, 3 + len);
+    p[3 + len] = crc & 0xff;
+    p[4 + len] = crc >> 8;
+
+    uint8_t frame[sizeof(p) + 3];  // one COBS code byte suffices for up to 254 bytes
+    frame[0] = 0;
+    size_t n = CwProtocol::cobsEncode(p, 5 + len, &frame[1]);
+    frame[n + 1] = 0;
+    io.write(frame, n + 2);
+}
+
+bool streamScreenshot(LGFX &lcd, Stream &io, CaptureStats *stats)
+{
+    uint32_t msStart = millis();
+    int width  = lcd.width();
+    int height = lcd.height();
+    int outSize = QoiEncoder::headerSize + QoiEncoder::maxEncodedSize(width) + QoiEncoder::endSize + chunkSize;
+
+    uint16_t *rows = (uint16_t *)malloc(rowsPerBlock * width * 2);
+    uint8_t  *out  = (uint8_t *)malloc(outSize);
+    if (! rows || ! out)
+    {
+        free(rows);
+        free(out);
+        io.println("ERR out of memory");
+        return false;
+    }
+
+    uint16_t seq = 0;
+    uint8_t info[5] = { (uint8_t)width, (uint8_t)(width >> 8), (uint8_t)height, (uint8_t)(height >> 8), 0 };
+    sendFrame(io, SF_BEGIN, seq++, info, sizeof(info));
+
+    QoiEncoder qoi;
+    uint32_t bytes = 0;
+    int len = qoi.begin(width, height, out);
+    for (int y = 0; y < height; y += rowsPerBlock)
+    {
+        int n = std::min(rowsPerBlock, height - y);
+        lcd.readRect(0, y, width, n, (lgfx::rgb565_t*)rows);
+        for (int r = 0; r < n; r++)
+        {
+            len += qoi.encode565(&rows[r * width], width, &out[len]);
+            if (y + r == height - 1) len += qoi.end(&out[len]);
+
+            int sent = 0;  // send the complete chunks, keep the rest for the next row
+            while (len - sent >= chunkSize || (y + r == height - 1 && len > sent))
+            {
+                int k = std::min(chunkSize, len - sent);
+                sendFrame(io, SF_CHUNK, seq++, &out[sent], k);
+                sent += k;
+            }
+            memmove(out, &out[sent], len - sent);
+            len -= sent;
+            bytes += sent;
+        }
+    }
+    io.flush();
+
+    uint32_t ms = millis() - msStart;
+    uint8_t summary[8] = { (uint8_t)bytes, (uint8_t)(bytes >> 8), (uint8_t)(bytes >> 16), (uint8_t)(bytes >> 24),
+                           (uint8_t)ms, (uint8_t)(ms >> 8), (uint8_t)(ms >> 16), (uint8_t)(ms >> 24) };
+    sendFrame(io, SF_END, seq++, summary, sizeof(summary));
+    if (stats) *stats = { ms, bytes, ms ? bytes / (float)ms : 0.0f };
+
+    free(rows);
+    free(out);
+    return true;
+}
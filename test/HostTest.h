@@ -0,0 +1,53 @@
+#pragma once
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+/**
+ * File         HostTest.h
+ *
+ * Purpose      Checks for the host tests, one program per test directory,
+ *              built and run by test/run.sh. A failed check prints where it
+ *              is, the expression and the values, and the test goes on with
+ *              the next check. hostTestResult() is the exit code of main().
+ *
+ * Usage        static void testSolve()
+ *              {
+ *                  CHECK_EQUAL(3, divider);
+ *                  CHECK_NEAR(1007.08, f, 0.01);
+ *              }
+ *              int main() { RUN_TEST(testSolve); return hostTestResult(); }
+ */
+namespace hosttest
+{
+    inline int &failures() { static int n = 0; return n; }
+
+    inline std::string str(const std::string &v) { return v; }
+    inline std::string str(const char *v) { return v ? v : "nullptr"; }
+    template <typename T> std::string str(T v) { return std::to_string(v); }
+
+    inline void fail(const char *file, int line, const char *what, const std::string &values)
+    {
+        printf("%s:%d: FAIL %s%s\n", file, line, what, values.c_str());
+        failures()++;
+    }
+}
+
+#define CHECK(cond) \
+    do { if (! (cond)) hosttest::fail(__FILE__, __LINE__, #cond, ""); } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+    do { auto e_ = (expected); auto a_ = (actual); \
+         if (! (e_ == a_)) hosttest::fail(__FILE__, __LINE__, #actual, \
+             ", expected " + hosttest::str(e_) + ", got " + hosttest::str(a_)); } while (0)
+
+#define CHECK_NEAR(expected, actual, tolerance) \
+    do { double e_ = (expected), a_ = (actual); \
+         if (! (fabs(e_ - a_) <= (tolerance))) hosttest::fail(__FILE__, __LINE__, #actual, \
+             ", expected " + hosttest::str(e_) + ", got " + hosttest::str(a_)); } while (0)
+
+#define RUN_TEST(test) \
+    do { int before_ = hosttest::failures(); test(); \
+         printf("%s %s\n", hosttest::failures() == before_ ? "ok  " : "FAIL", #test); fflush(stdout); } while (0)
+
+inline int hostTestResult() { return hosttest::failures() > 0; }
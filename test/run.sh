@@ -0,0 +1,61 @@
+#!/bin/bash
+# Host tests. Builds the simulator and the unit tests in test/test_*/ with the
+# flags of env:native, runs the unit tests, then every script in sim/scripts
+# with its screenshots compared to sim/reference. The exit code is 1 if a test,
+# an expect of a script or a screenshot fails.
+#
+# Usage   test/run.sh [builddir]        (default /tmp/cwsim-test)
+cd "$(dirname "$0")/.."
+build=${1:-/tmp/cwsim-test}
+root=$(pwd)
+flags="-std=gnu++17 -O0 -Wall -Wno-sign-compare -DARDUINO=10819 -DCW_SIM -DCORE_DEBUG_LEVEL=3 -pthread"
+inc="-Isim -Iinclude -Itest"
+libs=""
+for d in lib/*/; do
+    case $d in lib/lgfx*|lib/PulseGen*) continue;; esac  # board only
+    inc="$inc -I$d"; libs="$libs $(ls $d*.cpp 2>/dev/null)"
+done
+runtime=$(ls sim/*.cpp | grep -v sim_main.cpp)
+
+# compile every source once, in parallel, into build/obj/<path>.o
+mkdir -p "$build/obj" "$build/out"
+compile()
+{
+    o="$build/obj/${1%.cpp}.o"
+    mkdir -p "$(dirname "$o")"
+    g++ $flags $inc -c "$1" -o "$o" || { echo "FAIL compile $1"; return 1; }
+}
+export -f compile; export build flags inc
+tests=$(ls test/test_*/*.cpp 2>/dev/null)
+echo $libs $runtime src/*.cpp sim/sim_main.cpp $tests | tr ' ' '\n' | xargs -P "$(nproc)" -I{} bash -c 'compile {}' || exit 1
+
+obj() { for f in "$@"; do echo -n "$build/obj/${f%.cpp}.o "; done; }
+rm -f "$build/libcw.a"
+ar rcs "$build/libcw.a" $(obj $libs $runtime)
+g++ $flags $(obj src/*.cpp sim/sim_main.cpp) "$build/libcw.a" -o "$build/cwsim" || exit 1
+
+failed=0
+for dir in test/test_*/; do
+    [ -d "$dir" ] || continue
+    name=$(basename "$dir")
+    if ! g++ $flags $(obj $dir*.cpp) "$build/libcw.a" -o "$build/$name"; then
+        echo "FAIL link $name"; failed=$((failed + 1)); continue
+    fi
+    # a test_*.py next to the sources checks what the program wrote, e.g. with a tool
+    if (cd "$build/out" && timeout 60 "../$name" && for py in "$root/$dir"test_*.py; do
+            [ -f "$py" ] || continue; python3 "$py" . || exit 1; done) > "$build/$name.log" 2>&1; then
+        echo "ok   $name"
+    else
+        cat "$build/$name.log"; echo "FAIL $name"; failed=$((failed + 1))
+    fi
+done
+for script in sim/scripts/*.txt; do
+    name=$(basename "$script" .txt)
+    if timeout 120 "$build/cwsim" -s "$script" -o "$build/out" -r sim/reference > "$build/$name.log" 2>&1; then
+        echo "ok   sim $name"
+    else
+        grep "^\[sim\]" "$build/$name.log"; echo "FAIL sim $name"; failed=$((failed + 1))
+    fi
+done
+[ $failed -eq 0 ] && echo "all host tests passed" || echo "$failed host tests failed"
+exit $((failed > 0))
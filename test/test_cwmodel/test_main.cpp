@@ -0,0 +1,111 @@
+#include "CwModel.h"
+#include "HostTest.h"
+
+// the reference frequency of the panel at start-up
+static const double f0 = 122.0703125;
+
+static void testSolveOptimal()
+{
+    int divider, step;
+    CwModel::solve(1000.0, f0, 10, true, divider, step);  // 976.56 Hz with divider 0..2 is off by more than 1 %
+    CHECK_EQUAL(3, divider);
+    CHECK_EQUAL(33, step);
+
+    CwModel::solve(15.0, f0, 1, true, divider, step);     // nothing within 1 o/oo: divider 0
+    CHECK_EQUAL(0, divider);
+    CHECK_EQUAL(1, step);
+}
+
+static void testSolveBest()
+{
+    int divider, step;
+    CwModel::solve(1000.0, f0, 10, false, divider, step);  // 1000.98 Hz
+    CHECK_EQUAL(4, divider);
+    CHECK_EQUAL(41, step);
+
+    CwModel::solve(f0 * 3, f0, 10, false, divider, step);  // exact for every divider: the lowest of 1..7
+    CHECK_EQUAL(1, divider);
+    CHECK_EQUAL(6, step);
+}
+
+static void testSolveClampsStep()
+{
+    int divider, step;
+    CwModel::solve(8000000.0, f0, 10, true, divider, step);
+    CHECK_EQUAL(0, divider);
+    CHECK_EQUAL(65535, step);
+
+    CwModel::solve(1.0, f0, 10, true, divider, step);
+    CHECK_EQUAL(1, step);
+}
+
+static void testRanges()
+{
+    CwModel m;
+    m.setDivider(9);
+    CHECK_EQUAL(7, m.getDivider());
+    m.setDivider(-1);
+    CHECK_EQUAL(0, m.getDivider());
+    m.setStep(0);
+    CHECK_EQUAL(1, m.getStep());
+    m.setStep(70000);
+    CHECK_EQUAL(65535, m.getStep());
+    m.setMode(5);
+    CHECK_EQUAL(3, m.getMode());
+    m.setMode(-2);
+    CHECK_EQUAL(0, m.getMode());
+    m.setTolerance(0);
+    CHECK_EQUAL(1, m.getTolerance());
+    m.setTolerance(1000);
+    CHECK_EQUAL(999, m.getTolerance());
+    m.setF0(-1.0);
+    CHECK_EQUAL(f0, m.getF0());
+}
+
+static void testChangeMask()
+{
+    CwModel m;
+    CHECK_EQUAL(0, m.takeChanges());
+
+    m.setFrequency(1000.0);
+    CHECK_EQUAL(CwModel::FREQUENCY | CwModel::DIVIDER | CwModel::STEP, m.takeChanges());
+    CHECK_NEAR(1007.080078, m.getFrequency(), 1e-6);
+    CHECK_EQUAL(0, m.getChanges());  // taken
+
+    m.setFrequency(1000.0);          // same solution, nothing changed
+    m.setStep(33);
+    m.setMode(2);
+    m.setTolerance(10);
+    m.setOptimalMatch(true);
+    m.setF0(f0);
+    CHECK_EQUAL(0, m.takeChanges());
+
+    m.setStep(34);
+    CHECK_EQUAL(CwModel::FREQUENCY | CwModel::STEP, m.takeChanges());
+    m.setDivider(4);
+    CHECK_EQUAL(CwModel::FREQUENCY | CwModel::DIVIDER, m.takeChanges());
+    m.setF0(125.0);
+    CHECK_EQUAL(CwModel::FREQUENCY | CwModel::F0, m.takeChanges());
+    CHECK_NEAR(125.0 * 34 / 5, m.getFrequency(), 1e-9);
+
+    m.setTolerance(20);               // no dependents
+    CHECK_EQUAL(CwModel::TOLERANCE, m.takeChanges());
+    m.setOptimalMatch(false);
+    CHECK_EQUAL(CwModel::MATCH, m.takeChanges());
+    m.setMode(0);
+    CHECK_EQUAL(CwModel::MODE, m.takeChanges());
+
+    m.setStep(35);                    // marks accumulate until taken
+    m.setMode(1);
+    CHECK_EQUAL(CwModel::FREQUENCY | CwModel::STEP | CwModel::MODE, m.getChanges());
+}
+
+int main()
+{
+    RUN_TEST(testSolveOptimal);
+    RUN_TEST(testSolveBest);
+    RUN_TEST(testSolveClampsStep);
+    RUN_TEST(testRanges);
+    RUN_TEST(testChangeMask);
+    return hostTestResult();
+}
@@ -0,0 +1,130 @@
+#include "CosineWaveGenerator.h"
+#include "Sim.h"
+#include "HostTest.h"
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+static const double f0 = 122.0703125;
+
+struct Event { int count; uint8_t mask; dac_channel_t channel; };
+static void onChange(void *context, CosineWaveGenerator &, uint8_t mask, dac_channel_t channel)
+{
+    Event &e = *static_cast<Event *>(context);
+    e.count++;
+    e.mask |= mask;
+    e.channel = channel;
+}
+
+static void testUpdateIsOneEvent()
+{
+    CosineWaveGenerator gen(f0);
+    Event e = {};
+    gen.addListener(onChange, &e);
+
+    CwUpdate u;
+    u.channel = DAC_CHANNEL_1;
+    u.setDivi(3);
+    u.setStep(33);
+    u.setScale(2);
+    u.setEnable(true);
+    gen.update(u);
+    CHECK_EQUAL(1, e.count);
+    CHECK_EQUAL(CwUpdate::DIVI | CwUpdate::STEP | CwUpdate::SCALE | CwUpdate::ENABLE, e.mask);
+    CHECK_EQUAL(DAC_CHANNEL_1, e.channel);
+    CHECK(gen.isEnabled(DAC_CHANNEL_1));
+    CHECK(sim::dacEnabled[0]);
+    CHECK_NEAR(1007.080078, sim::signalFrequency(), 1e-3);
+
+    e = {};
+    gen.update(u);                     // enabled already: not reported as a change
+    CHECK_EQUAL(1, e.count);
+    CHECK_EQUAL(CwUpdate::DIVI | CwUpdate::STEP | CwUpdate::SCALE, e.mask);
+
+    e = {};
+    CwUpdate off;
+    off.channel = DAC_CHANNEL_1;
+    off.setEnable(false);
+    gen.update(off);
+    CHECK_EQUAL(1, e.count);
+    CHECK_EQUAL(CwUpdate::ENABLE, e.mask);
+    CHECK(! sim::dacEnabled[0]);
+    gen.removeListener(onChange, &e);
+}
+
+static void testUpdateSetsTheTarget()
+{
+    CosineWaveGenerator gen(f0);
+    CwUpdate u;
+    u.setFrequency(1000.0, 3, 33);
+    gen.update(u);
+    CHECK_NEAR(1007.080078, gen.getActualFrequency(), 1e-6);
+    CHECK_EQUAL(1000.0, gen.getTargetFrequency());
+
+    CwUpdate raw;                      // divi and step without a target
+    raw.setStep(41);
+    gen.update(raw);
+    CHECK_EQUAL(gen.getActualFrequency(), gen.getTargetFrequency());
+
+    int divi, step;                    // the static solve does not need the generator
+    CHECK(CosineWaveGenerator::solveFrequency(1000.0, f0, 10, divi, step));
+    CHECK_EQUAL(3, divi);
+    CHECK_EQUAL(33, step);
+}
+
+static void testFrequencyEventsCarryTheChannel()
+{
+    CosineWaveGenerator gen(f0);
+    Event e = {};
+    gen.addListener(onChange, &e);
+    gen.setFrequencyStep(40, DAC_CHANNEL_1);
+    CHECK_EQUAL(DAC_CHANNEL_1, e.channel);
+    gen.setClockDivisor(2, DAC_CHANNEL_1);
+    CHECK_EQUAL(DAC_CHANNEL_1, e.channel);
+    gen.setFrequency(3, 33);           // default channel 2
+    CHECK_EQUAL(DAC_CHANNEL_2, e.channel);
+    CHECK_EQUAL(3, e.count);
+    gen.removeListener(onChange, &e);
+}
+
+// a listener that is slow, like one that runs into a full ring
+static std::atomic<int> inside(0), calls(0);
+static void slowListener(void *, CosineWaveGenerator &, uint8_t, dac_channel_t)
+{
+    inside++;
+    calls++;
+    usleep(2000);
+    inside--;
+}
+
+static void testRemoveWaitsForTheListener()
+{
+    CosineWaveGenerator gen(f0);
+    gen.addListener(slowListener, nullptr);
+    std::atomic<bool> stop(false);
+    std::thread writer([&] {           // e.g. the timer task of the sequencer
+        CwUpdate u;
+        for (int s = 1; ! stop; s = s % 100 + 1)
+        {
+            u.setStep(s);
+            gen.update(u);
+        }
+    });
+    while (calls < 3) usleep(100);
+    gen.removeListener(slowListener, nullptr);
+    CHECK_EQUAL(0, inside.load());     // no call in progress once removed
+    int after = calls;
+    usleep(10000);
+    CHECK_EQUAL(after, calls.load());
+    stop = true;
+    writer.join();
+}
+
+int main()
+{
+    RUN_TEST(testUpdateIsOneEvent);
+    RUN_TEST(testUpdateSetsTheTarget);
+    RUN_TEST(testFrequencyEventsCarryTheChannel);
+    RUN_TEST(testRemoveWaitsForTheListener);
+    return hostTestResult();
+}
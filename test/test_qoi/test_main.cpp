@@ -0,0 +1,109 @@
+#include "QoiEncoder.h"
+#include "HostTest.h"
+#include <vector>
+
+/**
+ * Encodes known RGB565 images and writes each as qoi_<name>.qoi, with the
+ * RGB888 pixels the decoder must return as qoi_<name>.rgb. test_qoi2png.py
+ * decodes them with tools/qoi2png.py and compares.
+ */
+
+static std::vector<uint8_t> encode(const std::vector<uint16_t> &px, int width, int height, int chunk)
+{
+    QoiEncoder qoi;
+    std::vector<uint8_t> out(QoiEncoder::headerSize + QoiEncoder::maxEncodedSize(px.size()) + QoiEncoder::endSize);
+    int n = qoi.begin(width, height, out.data());
+    for (size_t i = 0; i < px.size(); i += chunk)
+    {
+        int count = std::min((size_t)chunk, px.size() - i);
+        int len = qoi.encode565(&px[i], count, &out[n]);
+        CHECK(len <= QoiEncoder::maxEncodedSize(count));
+        n += len;
+    }
+    n += qoi.end(&out[n]);
+    out.resize(n);
+    return out;
+}
+
+static void save(const char *name, const std::vector<uint16_t> &px, int width, int height)
+{
+    std::vector<uint8_t> qoi = encode(px, width, height, width);  // row by row as the recorder does
+    std::vector<uint8_t> rgb;
+    for (uint16_t c : px)
+    {
+        uint8_t r5 = c >> 11, g6 = (c >> 5) & 0x3f, b5 = c & 0x1f;
+        rgb.push_back(r5 << 3 | r5 >> 2);
+        rgb.push_back(g6 << 2 | g6 >> 4);
+        rgb.push_back(b5 << 3 | b5 >> 2);
+    }
+    std::string base = std::string("qoi_") + name;
+    FILE *f = fopen((base + ".qoi").c_str(), "wb");
+    CHECK(f && fwrite(qoi.data(), 1, qoi.size(), f) == qoi.size());
+    if (f) fclose(f);
+    f = fopen((base + ".rgb").c_str(), "wb");
+    CHECK(f && fwrite(rgb.data(), 1, rgb.size(), f) == rgb.size());
+    if (f) fclose(f);
+}
+
+static std::vector<uint16_t> noise(int n)
+{
+    std::vector<uint16_t> px(n);
+    uint32_t x = 12345;
+    for (auto &p : px) { x = x * 1103515245 + 12345; p = x >> 16; }
+    return px;
+}
+
+static void testHeader()
+{
+    std::vector<uint8_t> q = encode(std::vector<uint16_t>(6, 0xffff), 3, 2, 3);
+    const uint8_t header[14] = { 'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 2, 3, 0 };
+    CHECK(q.size() >= 14 + 8 && memcmp(q.data(), header, 14) == 0);
+    CHECK_EQUAL(1, q.back());                   // end marker 0 0 0 0 0 0 0 1
+    CHECK_EQUAL((size_t)14 + 1 + 1 + 8, q.size());  // white: RGB op, then a run of 5
+}
+
+static void testRuns()
+{
+    std::vector<uint8_t> q = encode(std::vector<uint16_t>(200, 0x0000), 200, 1, 200);
+    // black is the initial pixel: runs of 62, 62, 62 and 14
+    CHECK_EQUAL((size_t)14 + 4 + 8, q.size());
+    CHECK_EQUAL(0xc0 | 61, q[14]);
+    CHECK_EQUAL(0xc0 | 13, q[17]);
+}
+
+static void testChunksDoNotMatter()
+{
+    std::vector<uint16_t> px = noise(97 * 13);
+    for (int i = 100; i < 300; i++) px[i] = 0x1234;  // a run across chunk borders
+    std::vector<uint8_t> whole = encode(px, 97, 13, px.size());
+    CHECK(whole == encode(px, 97, 13, 97));
+    CHECK(whole == encode(px, 97, 13, 7));
+    CHECK(whole == encode(px, 97, 13, 1));
+}
+
+static void testSaveImages()
+{
+    const int w = 320, h = 8;
+    save("flat", std::vector<uint16_t>(w * h, 0x2945), w, h);
+
+    std::vector<uint16_t> ramp(w * h);              // small steps: DIFF and LUMA
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) ramp[y * w + x] = (x / 10) << 11 | (x / 5 + y) << 5 | (31 - x / 10);
+    save("ramp", ramp, w, h);
+
+    save("noise", noise(97 * 13), 97, 13);          // mostly RGB
+
+    std::vector<uint16_t> palette(w * h);           // few colors, revisited: INDEX
+    const uint16_t colors[5] = { 0xf800, 0x07e0, 0x001f, 0xffff, 0x8410 };
+    for (int i = 0; i < w * h; i++) palette[i] = colors[(i / 3) % 5];
+    save("palette", palette, w, h);
+}
+
+int main()
+{
+    RUN_TEST(testHeader);
+    RUN_TEST(testRuns);
+    RUN_TEST(testChunksDoNotMatter);
+    RUN_TEST(testSaveImages);
+    return hostTestResult();
+}
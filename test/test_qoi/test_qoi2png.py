@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""
+Decodes the images written by test_main.cpp with tools/qoi2png.py and
+compares them with the pixels that were encoded, then checks that the PNG
+holds the same pixels.
+
+Usage   python3 test/test_qoi/test_qoi2png.py <directory of the .qoi files>
+"""
+import os
+import struct
+import sys
+import zlib
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "tools"))
+import qoi2png  # noqa: E402
+
+NAMES = ("flat", "ramp", "noise", "palette")
+
+
+def png_pixels(png):
+    """Returns (width, height, rgb bytes) of a PNG as written by png_encode."""
+    width, height = struct.unpack(">II", png[16:24])
+    raw, p = b"", 8
+    while p < len(png):
+        length, tag = struct.unpack(">I4s", png[p:p + 8])
+        if tag == b"IDAT":
+            raw += png[p + 8:p + 8 + length]
+        p += 12 + length
+    raw = zlib.decompress(raw)
+    stride = 3 * width
+    return width, height, b"".join(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)] for y in range(height))
+
+
+def main():
+    directory = sys.argv[1] if len(sys.argv) > 1 else "."
+    failed = 0
+    for name in NAMES:
+        base = os.path.join(directory, "qoi_" + name)
+        with open(base + ".qoi", "rb") as f:
+            w, h, rgb = qoi2png.qoi_decode(f.read())
+        with open(base + ".rgb", "rb") as f:
+            expected = f.read()
+        ok = w * h * 3 == len(expected) and rgb == expected
+        ok = ok and png_pixels(qoi2png.png_encode(w, h, rgb)) == (w, h, expected)
+        print("%s %s (%d x %d)" % ("ok  " if ok else "FAIL", name, w, h))
+        failed += not ok
+    return failed > 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
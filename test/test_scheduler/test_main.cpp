@@ -0,0 +1,127 @@
+#include "Scheduler.h"
+#include "HostTest.h"
+
+// fake clock: time passes only when a job or idle() says so
+static int64_t usClock = 0;
+static int64_t fakeClock() { return usClock; }
+static void fakeSleep(int64_t usMax) { usClock += usMax; }
+
+static int runsA, runsB;
+static void countA(void *) { runsA++; }
+static void countB(void *) { runsB++; }
+
+static void testPeriodsDoNotDrift()
+{
+    usClock = 0;
+    runsA = runsB = 0;
+    Scheduler sched(fakeClock, fakeSleep);
+    int a = sched.every(1000, countA, nullptr, "a");
+    int b = sched.every(2500, countB, nullptr, "b");
+    while (usClock < 10000)
+    {
+        usClock += 37;            // a loop pass, the jobs run up to 36 us late
+        sched.run();
+    }
+    CHECK_EQUAL(10, runsA);
+    CHECK_EQUAL(4, runsB);
+    CHECK_EQUAL(11000 - usClock, sched.usUntilNext());  // on the grid, not a period after the last run
+    Scheduler::Stats s;
+    CHECK(sched.getStats(a, s));
+    CHECK_EQUAL(0u, s.skipped);
+    CHECK(s.usMaxLate < 37);
+    CHECK(sched.getStats(b, s));
+    CHECK_EQUAL((uint32_t)runsB, s.runs);
+}
+
+static void overrun(void *) { usClock += 2500; }  // longer than its period
+
+static void testOverrunReturns()
+{
+    usClock = 0;
+    Scheduler sched(fakeClock, fakeSleep);
+    int id = sched.every(1000, overrun, nullptr, "slow");
+    usClock = 1000;
+    CHECK_EQUAL(1, sched.run());       // due again at once, but not in this call
+    CHECK_EQUAL(0, (int)sched.usUntilNext());
+    CHECK_EQUAL(1, sched.run());
+    Scheduler::Stats s;
+    CHECK(sched.getStats(id, s));
+    CHECK_EQUAL(2u, s.runs);
+    CHECK_EQUAL(2500u, s.usMaxRun);
+    CHECK_EQUAL(1u, s.skipped);         // the second run started at 3500 us, the one due at 3000 us was missed
+}
+
+static Scheduler *current;
+static int chained = -1;
+static void chainedJob(void *) { runsB++; }
+static void oneShot(void *)
+{
+    runsA++;
+    usClock += 10;
+    chained = current->after(0, chainedJob, nullptr, "chained");  // gets the slot of this job
+}
+
+static void testOneShotReusesItsSlot()
+{
+    usClock = 0;
+    runsA = runsB = 0;
+    Scheduler sched(fakeClock, fakeSleep);
+    current = &sched;
+    int id = sched.after(500, oneShot, nullptr, "once");
+    usClock = 500;
+    CHECK_EQUAL(1, sched.run());       // the chained job waits for the next call
+    CHECK_EQUAL(id, chained);
+    Scheduler::Stats s;
+    CHECK(sched.getStats(chained, s));
+    CHECK_EQUAL(std::string("chained"), std::string(s.name));
+    CHECK_EQUAL(0u, s.runs);           // not the run of the job it replaced
+    CHECK_EQUAL(1, sched.run());
+    CHECK_EQUAL(1, runsA);
+    CHECK_EQUAL(1, runsB);
+    CHECK(! sched.isScheduled(chained));
+}
+
+static int selfId = -1;
+static void cancelSelf(void *) { runsA++; current->cancel(selfId); }
+
+static void testPeriodicCancelsItself()
+{
+    usClock = 0;
+    runsA = 0;
+    Scheduler sched(fakeClock, fakeSleep);
+    current = &sched;
+    selfId = sched.every(1000, cancelSelf, nullptr, "self");
+    usClock = 5000;
+    CHECK_EQUAL(1, sched.run());
+    CHECK(! sched.isScheduled(selfId));
+    usClock = 10000;
+    CHECK_EQUAL(0, sched.run());
+    CHECK_EQUAL(1, runsA);
+}
+
+static void testIdleSleepsUntilTheNextDeadline()
+{
+    usClock = 0;
+    Scheduler sched(fakeClock, fakeSleep);
+    sched.every(3000, countA, nullptr, "a", 3000);
+    sched.after(1200, countB, nullptr, "b");
+    sched.idle(500);                   // at most usMax
+    CHECK_EQUAL(500, (int)usClock);
+    sched.idle();
+    CHECK_EQUAL(1200, (int)usClock);
+    sched.idle();                      // b is due, no sleep
+    CHECK_EQUAL(1200, (int)usClock);
+    sched.run();
+    sched.idle();
+    CHECK_EQUAL(3000, (int)usClock);
+}
+
+int main()
+{
+    RUN_TEST(testPeriodsDoNotDrift);
+    RUN_TEST(testOverrunReturns);
+    RUN_TEST(testOneShotReusesItsSlot);
+    RUN_TEST(testPeriodicCancelsItself);
+    RUN_TEST(testIdleSleepsUntilTheNextDeadline);
+    return hostTestResult();
+}
@@ -0,0 +1,132 @@
+#include "CwScpi.h"
+#include "Sim.h"
+#include "HostTest.h"
+#include <unistd.h>
+
+static const double f0 = 122.0703125;
+
+/** The SCPI port: lines to feed and the replies written. */
+class FakePort : public Stream
+{
+    public:
+        std::string in;
+        std::string out;
+
+        size_t write(uint8_t c) override { out += (char)c; return 1; }
+        int available() override { return in.size(); }
+        int read() override
+        {
+            if (in.empty()) return -1;
+            int c = (uint8_t)in[0];
+            in.erase(0, 1);
+            return c;
+        }
+        int peek() override { return in.empty() ? -1 : (uint8_t)in[0]; }
+};
+
+/**
+ * On the device printf() goes to UART0, the port SCPI answers on, so
+ * anything a command prints there ends up in the reply. Capture it.
+ */
+class StdoutCapture
+{
+    public:
+        StdoutCapture()
+        {
+            fflush(stdout);
+            _file = tmpfile();
+            _saved = dup(fileno(stdout));
+            dup2(fileno(_file), fileno(stdout));
+        }
+        std::string text()
+        {
+            fflush(stdout);
+            dup2(_saved, fileno(stdout));
+            close(_saved);
+            std::string s;
+            rewind(_file);
+            for (int c; (c = fgetc(_file)) != EOF; ) s += (char)c;
+            fclose(_file);
+            return s;
+        }
+
+    private:
+        FILE *_file;
+        int _saved;
+};
+
+static std::string send(CwScpi &scpi, FakePort &port, const char *line)
+{
+    port.out.clear();
+    port.in = std::string(line) + "\n";
+    scpi.loop();
+    return port.out;
+}
+
+static void testFreqIsQuiet()
+{
+    CosineWaveGenerator gen(f0);
+    FakePort port;
+    CwScpi scpi(gen, port);
+
+    StdoutCapture capture;
+    std::string reply = send(scpi, port, "FREQ 1000");
+    std::string printed = capture.text();
+    CHECK_EQUAL("", reply);
+    CHECK_EQUAL("", printed);
+    CHECK_NEAR(1007.080078, gen.getActualFrequency(), 1e-6);
+    CHECK_EQUAL(1000.0, gen.getTargetFrequency());
+    CHECK_EQUAL("1007.080078\n", send(scpi, port, "FREQ?"));
+}
+
+static void testFreqUsesTheChannel()
+{
+    CosineWaveGenerator gen(f0);
+    FakePort port;
+    CwScpi scpi(gen, port, DAC_CHANNEL_1);
+    send(scpi, port, "OUTP ON;FREQ 2000");
+    CHECK(gen.isEnabled(DAC_CHANNEL_1));
+    CHECK(! gen.isEnabled(DAC_CHANNEL_2));
+    CHECK_NEAR(2000.0, gen.getActualFrequency(), 20.0);
+}
+
+static void testNumbersAreStrict()
+{
+    CosineWaveGenerator gen(f0);
+    FakePort port;
+    CwScpi scpi(gen, port);
+    int step = gen.getFrequencyStep();
+
+    CHECK_EQUAL("ERR 5abc out of range 1..65535\n", send(scpi, port, "STEP 5abc"));
+    CHECK_EQUAL(step, gen.getFrequencyStep());
+    CHECK_EQUAL("ERR missing argument DIV\n", send(scpi, port, "DIV"));
+    CHECK_EQUAL("ERR 1e3x out of range 15..8000000\n", send(scpi, port, "FREQ 1e3x"));
+    CHECK_EQUAL("ERR 122k out of range 100..150\n", send(scpi, port, "REF 122k"));
+    CHECK_EQUAL(f0, gen.getReferenceFrequency());
+
+    CHECK_EQUAL("", send(scpi, port, "STEP 5"));
+    CHECK_EQUAL(5, gen.getFrequencyStep());
+    CHECK_EQUAL("", send(scpi, port, "FREQ 1e3"));
+    CHECK_NEAR(1007.080078, gen.getActualFrequency(), 1e-6);
+}
+
+static void testQueriesAndErrors()
+{
+    CosineWaveGenerator gen(f0);
+    FakePort port;
+    CwScpi scpi(gen, port);
+
+    CHECK_EQUAL("3\n", send(scpi, port, "DIV 3;DIV?"));
+    CHECK_EQUAL("0\r\n1\r\n", send(scpi, port, "OUTP?;OUTP ON;OUTP?"));
+    CHECK_EQUAL("ERR unknown command VOLT\n", send(scpi, port, "VOLT 1"));
+    CHECK_EQUAL("ERR MAYBE is not ON or OFF\n", send(scpi, port, "OUTP MAYBE"));
+}
+
+int main()
+{
+    RUN_TEST(testFreqIsQuiet);
+    RUN_TEST(testFreqUsesTheChannel);
+    RUN_TEST(testNumbersAreStrict);
+    RUN_TEST(testQueriesAndErrors);
+    return hostTestResult();
+}
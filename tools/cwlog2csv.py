@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+Converts the event log of the CYD cosine wave generator (see
+lib/CwEventLog/CwEventLog.h) to CSV.
+
+Usage   python3 tools/cwlog2csv.py events.cwl [-o events.csv]
+
+Writes to stdout without -o. Columns:
+  session   number of the begin() the record belongs to, from 1
+  ms        millis() of the device at the change
+  seq       event counter modulo 256, gaps show lost records
+  event     E change, L records lost (count in column lost)
+  changed   names of the changed fields
+  channel, step, divider, frequency, scale, offset, mode, enable
+            state of the channel after the change, frequency = f0 * step / (divider + 1)
+Uses only the standard library.
+"""
+import argparse
+import csv
+import struct
+import sys
+
+FIELDS = ["step", "divider", "scale", "offset", "mode", "enable"]  # CwUpdate flags 0x01 .. 0x20
+MODES = ["M_W", "W_M", "SINE", "NEG_SINE"]
+
+
+def records(data):
+    """Yields one dict per event or lost record."""
+    session, f0 = 0, None
+    for p in range(0, len(data) - 15, 16):
+        rec = data[p:p + 16]
+        kind = chr(rec[0])
+        if kind == "H":
+            if rec[1:4] != b"CWL":
+                raise ValueError("bad header at offset %d" % p)
+            session += 1
+            f0, = struct.unpack("<d", rec[8:16])
+        elif kind == "E":
+            seq, mask, channel, ms, step, divi, scale, offset, mode, enable = struct.unpack("<BBBIHBBBBB", rec[1:15])
+            yield {
+                "session": session, "ms": ms, "seq": seq, "event": "E",
+                "changed": "|".join(f for i, f in enumerate(FIELDS) if mask & (1 << i)),
+                "channel": channel, "step": step, "divider": divi,
+                "frequency": "%.3f" % (f0 * step / (divi + 1)) if f0 else "",
+                "scale": scale, "offset": offset, "mode": MODES[mode & 3], "enable": enable, "lost": "",
+            }
+        elif kind == "L":
+            ms, lost = struct.unpack("<II", rec[4:12])
+            yield {"session": session, "ms": ms, "event": "L", "lost": lost}
+        else:
+            raise ValueError("unknown record type at offset %d" % p)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="convert a generator event log to CSV")
+    ap.add_argument("file")
+    ap.add_argument("-o", help="CSV file, default stdout")
+    args = ap.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    if len(data) % 16:
+        print("ignoring %d bytes of an incomplete record" % (len(data) % 16), file=sys.stderr)
+
+    out = open(args.o, "w", newline="") if args.o else sys.stdout
+    columns = ["session", "ms", "seq", "event", "changed", "channel", "step", "divider",
+               "frequency", "scale", "offset", "mode", "enable", "lost"]
+    writer = csv.DictWriter(out, columns, restval="")
+    writer.writeheader()
+    for r in records(data):
+        writer.writerow(r)
+    if args.o:
+        out.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
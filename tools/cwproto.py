@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+Host side encoder for the binary control protocol of the CYD cosine wave generator
+(see lib/CwProtocol/CwProtocol.h) and a loopback throughput benchmark.
+
+Library  from cwproto import Batch, CwLink
+         link = CwLink("/dev/ttyUSB0")
+         link.send(Batch().step(440).divi(0).scale(1), ack=True)
+
+Bench    python3 tools/cwproto.py /dev/ttyUSB0 [frames] [updates_per_frame]
+         Sends frames back to back, every 16th with an acknowledge request, and
+         reports frames/s and updates/s after the last acknowledge arrived.
+Requires pyserial.
+"""
+import struct
+import sys
+import time
+
+TAG_STEP, TAG_DIVI, TAG_SCALE, TAG_OFFSET, TAG_MODE, TAG_ENABLE = range(1, 7)
+FLAG_TIME, FLAG_ACK, FLAG_REPLY = 0x01, 0x02, 0x80
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos, n = 0, 1
+    for b in data:
+        if b:
+            out.append(b)
+            n += 1
+        if b == 0 or n == 0xFF:
+            out[code_pos] = n
+            code_pos, n = len(out), 1
+            out.append(0)
+    out[code_pos] = n
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out, i = bytearray(), 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("invalid COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Batch:
+    """A set of generator updates applied together by the device."""
+
+    def __init__(self):
+        self.records = bytearray()
+
+    def _add(self, tag, value):
+        self.records += struct.pack("<BH", tag, value)
+        return self
+
+    def step(self, v):   return self._add(TAG_STEP, v)
+    def divi(self, v):   return self._add(TAG_DIVI, v)
+    def scale(self, v):  return self._add(TAG_SCALE, v)
+    def offset(self, v): return self._add(TAG_OFFSET, v)
+    def mode(self, v):   return self._add(TAG_MODE, v)
+    def enable(self, on=True): return self._add(TAG_ENABLE, 1 if on else 0)
+
+    def frame(self, seq, ack=False, us_time=None):
+        flags = (FLAG_ACK if ack else 0) | (FLAG_TIME if us_time is not None else 0)
+        payload = bytearray([flags, seq & 0xFF])
+        if us_time is not None:
+            payload += struct.pack("<I", us_time & 0xFFFFFFFF)
+        payload += self.records
+        payload += struct.pack("<H", crc16(payload))
+        return b"\x00" + cobs_encode(payload) + b"\x00"
+
+
+class CwLink:
+    def __init__(self, port, baud=115200):
+        import serial
+        self.port = serial.Serial(port, baud, timeout=2)
+        self.seq = 0
+
+    def send(self, batch, ack=False, us_time=None):
+        self.seq = (self.seq + 1) & 0xFF
+        self.port.write(batch.frame(self.seq, ack, us_time))
+        return self.seq
+
+    def read_reply(self):
+        """Returns (seq, status, device_micros) of the next acknowledge frame."""
+        buf = bytearray()
+        while True:
+            b = self.port.read(1)
+            if not b:
+                raise TimeoutError("no acknowledge from device")
+            if b[0] != 0:
+                buf += b
+            elif buf:
+                try:
+                    p = cobs_decode(bytes(buf))
+                except ValueError:
+                    p = b""
+                buf.clear()
+                if len(p) == 9 and p[0] == FLAG_REPLY and crc16(p[:7]) == struct.unpack("<H", p[7:])[0]:
+                    return p[1], p[2], struct.unpack("<I", p[3:7])[0]
+
+
+def bench(port, frames, per_frame):
+    link = CwLink(port)
+    link.send(Batch(), ack=True)
+    link.read_reply()
+    t0 = time.perf_counter()
+    pending = 0
+    for i in range(frames):
+        b = Batch()
+        for k in range(per_frame):
+            b.step(100 + (i + k) % 1000)
+        ack = i % 16 == 15 or i == frames - 1
+        link.send(b, ack=ack)
+        pending += ack
+    for _ in range(pending):
+        seq, status, _ = link.read_reply()
+        if status:
+            print("frame %d rejected with status %d" % (seq, status))
+    dt = time.perf_counter() - t0
+    size = len(Batch().step(1).frame(0)) + 3 * (per_frame - 1)
+    print("%d frames of %d updates (%d bytes) in %.3f s" % (frames, per_frame, size, dt))
+    print("%10.1f frames/s  %10.1f updates/s" % (frames / dt, frames * per_frame / dt))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    bench(sys.argv[1], int(sys.argv[2]) if len(sys.argv) > 2 else 1000,
+          int(sys.argv[3]) if len(sys.argv) > 3 else 1)
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""
+Receives screenshots of the CYD cosine wave generator over the serial port
+(no SD card needed) and writes them as PNG, see src/streamScreenshot.cpp.
+
+Usage   python3 tools/cwscreen.py /dev/ttyUSB0 [-n count] [-b baud] [--probe] [-o prefix]
+
+  -n count   number of screenshots, the frame rate is reported (default 1)
+  -b baud    switch device and host to this baud rate first (default 115200)
+  --probe    try increasing baud rates and keep the highest one that delivers
+             a screenshot without errors
+  -o prefix  output file prefix (default screen), files are prefix000.png ...
+Requires pyserial.
+"""
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+from cwproto import cobs_decode, crc16
+from qoi2png import png_encode, qoi_decode
+
+SF_BEGIN, SF_CHUNK, SF_END = 0x91, 0x92, 0x93
+PROBE_RATES = [230400, 460800, 921600, 1500000, 2000000]
+
+
+def frames(port):
+    """Yields (type, seq, data) of the valid frames received."""
+    buf = bytearray()
+    while True:
+        b = port.read(1)
+        if not b:
+            raise TimeoutError("no data from device")
+        if b[0]:
+            buf += b
+            continue
+        if len(buf) >= 5:
+            try:
+                p = cobs_decode(bytes(buf))
+            except ValueError:
+                p = b""
+            if len(p) >= 5 and crc16(p[:-2]) == struct.unpack("<H", p[-2:])[0]:
+                yield p[0], p[1] | p[2] << 8, p[3:-2]
+        buf.clear()
+
+
+def capture(port):
+    """Requests one screenshot, returns (qoi bytes, device ms) or raises on a lost chunk."""
+    port.reset_input_buffer()
+    port.write(b"CAPT?\n")
+    data, expected = None, 0
+    for ftype, seq, payload in frames(port):
+        if ftype == SF_BEGIN:
+            data, expected = bytearray(), 1
+            continue
+        if data is None:
+            continue
+        if seq != expected:
+            raise IOError("lost frame %d" % expected)
+        expected += 1
+        if ftype == SF_CHUNK:
+            data += payload
+        elif ftype == SF_END:
+            size, ms = struct.unpack("<II", payload)
+            if size != len(data):
+                raise IOError("size mismatch %d != %d" % (len(data), size))
+            return bytes(data), ms
+
+
+def set_baud(port, baud):
+    port.reset_input_buffer()
+    port.write(b"BAUD %d\n" % baud)
+    port.readline()
+    port.flush()
+    time.sleep(0.05)
+    port.baudrate = baud
+    port.write(b"*IDN?\n")  # confirms the new rate to the device
+    return b"CosineWaveGenerator" in port.readline()
+
+
+def probe(port):
+    best = port.baudrate
+    for baud in PROBE_RATES:
+        previous = port.baudrate
+        try:
+            if set_baud(port, baud):
+                capture(port)
+                best = baud
+                print("%8d baud ok" % baud)
+                continue
+        except (IOError, TimeoutError):
+            pass
+        print("%8d baud failed" % baud)
+        port.baudrate = previous  # the device falls back after 2 s
+        time.sleep(2.5)
+        break
+    return best
+
+
+def main():
+    ap = argparse.ArgumentParser(description="CYD screenshot receiver")
+    ap.add_argument("port")
+    ap.add_argument("-n", type=int, default=1)
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("--probe", action="store_true")
+    ap.add_argument("-o", default="screen")
+    args = ap.parse_args()
+
+    with serial.Serial(args.port, 115200, timeout=3) as port:
+        if args.probe:
+            print("highest stable rate %d baud" % probe(port))
+        elif args.baud != 115200 and not set_baud(port, args.baud):
+            print("device did not answer at %d baud" % args.baud)
+            return 1
+
+        t0 = time.perf_counter()
+        total = 0
+        for i in range(args.n):
+            qoi, ms = capture(port)
+            total += len(qoi)
+            w, h, rgb = qoi_decode(qoi)
+            name = "%s%03d.png" % (args.o, i)
+            with open(name, "wb") as f:
+                f.write(png_encode(w, h, rgb))
+            print("%s  %6d bytes  device %4d ms" % (name, len(qoi), ms))
+        dt = time.perf_counter() - t0
+        print("%d screenshots at %d baud: %.2f frames/s, %.1f kB/s"
+              % (args.n, port.baudrate, args.n / dt, total / dt / 1000))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
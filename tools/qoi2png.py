@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Converts QOI screenshots of the CYD cosine wave generator to PNG.
+
+Usage   python3 tools/qoi2png.py screen000.qoi [more.qoi ...]
+
+Writes screen000.png next to each input file. Uses only the standard library.
+"""
+import struct
+import sys
+import zlib
+
+
+def qoi_decode(data):
+    """Returns (width, height, rgb bytes) of a QOI image."""
+    if data[:4] != b"qoif":
+        raise ValueError("not a QOI file")
+    width, height = struct.unpack(">II", data[4:12])
+    index = [(0, 0, 0, 0)] * 64
+    r, g, b, a = 0, 0, 0, 255
+    out = bytearray()
+    p, run = 14, 0
+    for _ in range(width * height):
+        if run:
+            run -= 1
+        else:
+            op = data[p]
+            p += 1
+            if op == 0xFE:
+                r, g, b = data[p], data[p + 1], data[p + 2]
+                p += 3
+            elif op == 0xFF:
+                r, g, b, a = data[p], data[p + 1], data[p + 2], data[p + 3]
+                p += 4
+            elif op >> 6 == 0:
+                r, g, b, a = index[op]
+            elif op >> 6 == 1:
+                r = (r + ((op >> 4) & 3) - 2) & 0xFF
+                g = (g + ((op >> 2) & 3) - 2) & 0xFF
+                b = (b + (op & 3) - 2) & 0xFF
+            elif op >> 6 == 2:
+                vg = (op & 0x3F) - 32
+                d = data[p]
+                p += 1
+                r = (r + vg + (d >> 4) - 8) & 0xFF
+                g = (g + vg) & 0xFF
+                b = (b + vg + (d & 0x0F) - 8) & 0xFF
+            else:
+                run = op & 0x3F
+            index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = (r, g, b, a)
+        out += bytes((r, g, b))
+    return width, height, bytes(out)
+
+
+def png_encode(width, height, rgb):
+    def chunk(tag, payload):
+        return struct.pack(">I", len(payload)) + tag + payload + struct.pack(">I", zlib.crc32(tag + payload))
+    stride = 3 * width
+    raw = b"".join(b"\x00" + rgb[y * stride:(y + 1) * stride] for y in range(height))
+    return (b"\x89PNG\r\n\x1a\n" + chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 2, 0, 0, 0))
+            + chunk(b"IDAT", zlib.compress(raw, 9)) + chunk(b"IEND", b""))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    for name in sys.argv[1:]:
+        with open(name, "rb") as f:
+            w, h, rgb = qoi_decode(f.read())
+        png = name.rsplit(".", 1)[0] + ".png"
+        with open(png, "wb") as f:
+            f.write(png_encode(w, h, rgb))
+        print("%s -> %s (%d x %d)" % (name, png, w, h))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""
+Measures the command rate of the SCPI interface of the CYD cosine wave generator.
+
+Usage   python3 tools/scpi_bench.py /dev/ttyUSB0 [count]
+
+Runs two scenarios:
+  query      FREQ? round trips, one command waiting for the answer of the previous one
+  pipelined  STEP n commands sent back to back, synchronized with a final *IDN?
+The port may also be a pseudo-terminal, e.g. one end of
+  socat -d -d pty,raw,echo=0 pty,raw,echo=0
+Requires pyserial.
+"""
+import sys
+import time
+import serial
+
+
+def readline(port):
+    line = port.readline().decode(errors="replace").strip()
+    if not line:
+        raise TimeoutError("no answer from device")
+    return line
+
+
+def sync(port):
+    """Discard pending output until *IDN? is answered."""
+    port.reset_input_buffer()
+    port.write(b"*IDN?\n")
+    while "CosineWaveGenerator" not in readline(port):
+        pass
+
+
+def bench_query(port, count):
+    t0 = time.perf_counter()
+    for _ in range(count):
+        port.write(b"FREQ?\n")
+        readline(port)
+    return count / (time.perf_counter() - t0)
+
+
+def bench_pipelined(port, count):
+    t0 = time.perf_counter()
+    for i in range(count):
+        port.write(b"STEP %d\n" % (100 + i % 1000))
+    sync(port)
+    return count / (time.perf_counter() - t0)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 500
+    with serial.Serial(sys.argv[1], 115200, timeout=2) as port:
+        sync(port)
+        print("query      %8.1f commands/s" % bench_query(port, count))
+        print("pipelined  %8.1f commands/s" % bench_pipelined(port, count))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""
+Rebuilds the frames of a tile recording of the CYD cosine wave generator
+(see lib/TileRecorder/TileRecorder.h) as PNG files.
+
+Usage   python3 tools/tiles2png.py session.cwt [-o prefix] [--changed-only]
+
+Writes prefix0000.png, prefix0001.png, ... (default prefix: the file name
+without extension). --changed-only skips frames without changed tiles.
+Make a video with the timing of the recording ignored, e.g.
+  ffmpeg -framerate 2 -i session%04d.png session.mp4
+Uses only the standard library.
+"""
+import argparse
+import struct
+import sys
+
+from qoi2png import png_encode, qoi_decode
+
+
+def frames(data):
+    """Yields (ms, width, height, rgb, tile count) for every frame of the recording."""
+    p, canvas, width, height = 0, None, 0, 0
+    while p < len(data):
+        tag = data[p]
+        if data[p:p + 4] == b"CWTL":
+            width, height, tile = struct.unpack("<HHB", data[p + 4:p + 9])
+            canvas = bytearray(3 * width * height)
+            p += 9
+        elif tag == ord("F") and canvas is not None:
+            ms, = struct.unpack("<I", data[p + 1:p + 5])
+            p += 5
+            count = 0
+            while data[p] != 0xFF:
+                col, row, n = struct.unpack("<BBH", data[p:p + 4])
+                w, h, rgb = qoi_decode(data[p + 4:p + 4 + n])
+                p += 4 + n
+                for r in range(h):
+                    dst = 3 * ((row * tile + r) * width + col * tile)
+                    canvas[dst:dst + 3 * w] = rgb[3 * w * r:3 * w * (r + 1)]
+                count += 1
+            p += 1
+            yield ms, width, height, bytes(canvas), count
+        else:
+            raise ValueError("corrupt recording at offset %d" % p)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="rebuild frames of a tile recording")
+    ap.add_argument("file")
+    ap.add_argument("-o")
+    ap.add_argument("--changed-only", action="store_true")
+    args = ap.parse_args()
+    prefix = args.o or args.file.rsplit(".", 1)[0]
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    i = 0
+    try:
+        for ms, w, h, rgb, count in frames(data):
+            if args.changed_only and count == 0:
+                continue
+            with open("%s%04d.png" % (prefix, i), "wb") as f:
+                f.write(png_encode(w, h, rgb))
+            print("%s%04d.png  t=%8d ms  %3d tiles" % (prefix, i, ms, count))
+            i += 1
+    except (IndexError, struct.error):
+        print("recording ends with an incomplete frame")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())